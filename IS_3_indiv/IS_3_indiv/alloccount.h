@@ -0,0 +1,61 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Build with ALLOC_COUNTING=1 to count heap allocations for the micro
+// benchmarks and the overlay. It replaces the global operator new, so it is
+// off by default and in shipping builds.
+#ifndef ALLOC_COUNTING
+#define ALLOC_COUNTING 0
+#endif
+
+// Heap allocations made through operator new since the program started.
+// Counting needs the replacement operators below, which are compiled in
+// exactly one file by defining ALLOCATION_COUNTER_IMPLEMENTATION before
+// including this header; without them the count stays at zero. Over-aligned
+// allocations are not counted.
+inline std::atomic<unsigned long long>& AllocationCounter() {
+    static std::atomic<unsigned long long> count{ 0 };
+    return count;
+}
+
+inline unsigned long long AllocationCount() {
+    return AllocationCounter().load(std::memory_order_relaxed);
+}
+
+#endif
+
+#if defined(ALLOCATION_COUNTER_IMPLEMENTATION) && ALLOC_COUNTING
+#ifndef ALLOCCOUNT_IMPLEMENTATION_INCLUDED
+#define ALLOCCOUNT_IMPLEMENTATION_INCLUDED
+
+void* operator new(std::size_t size) {
+    AllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    AllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
+#endif
@@ -0,0 +1,448 @@
+#ifndef BATCHSIM_H
+#define BATCHSIM_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "jobsystem.h"
+#include "simulation.h"
+
+// Packages in flight per world. Drops beyond this are ignored; with the six
+// second lifetime that only happens when firing faster than ~10 per second.
+const int BATCH_MAX_PACKAGES = 64;
+const int BATCH_WORLD_GRAIN = 64;
+
+enum BatchButton {
+    BATCH_FORWARD = 1 << 0,
+    BATCH_BACK = 1 << 1,
+    BATCH_LEFT = 1 << 2,
+    BATCH_RIGHT = 1 << 3,
+    BATCH_UP = 1 << 4,
+    BATCH_DOWN = 1 << 5,
+    BATCH_AIM = 1 << 6
+};
+
+// One entry per world, the batched equivalent of SimInput.
+struct BatchAction {
+    float forwardX = 0.0f;
+    float forwardY = 0.0f;
+    float forwardZ = 1.0f;
+    unsigned int buttons = 0;
+    int drops = 0;
+};
+
+// Observation row of one world:
+//   airship x, y, z, score, packages in flight,
+//   then per house: x - airship x, z - airship z, needs delivery (0/1).
+const int BATCH_OBS_HOUSE_OFFSET = 5;
+const int BATCH_OBSERVATION_SIZE = BATCH_OBS_HOUSE_OFFSET + NUM_HOUSES * 3;
+
+// Steps many independent copies of the delivery game in lockstep. Every
+// per-world field lives in its own array with the world index innermost
+// (field[row * worldCount + world]), so the package and house loops run
+// across neighbouring worlds and vectorize. Worlds are split into ranges
+// that run on the job system.
+//
+// A world created with a seed follows the same rules and random sequence as
+// InitGameState/StepSimulation with that seed, in the classic scene
+// (NUM_HOUSES houses, no autofire). --batch-check steps both side by side
+// and compares them every tick; positions may differ in the last bits where
+// the compiler fuses the vectorized arithmetic. Sleds are not simulated;
+// they are decoration and do not affect the game.
+class BatchSimulator {
+public:
+    void Init(int count, unsigned int baseSeed, JobSystem* jobSystem = nullptr) {
+        worldCount = count;
+        jobs = jobSystem;
+        tick = 0;
+
+        size_t n = static_cast<size_t>(count);
+        airshipX.assign(n, 0.0f);
+        airshipY.assign(n, 0.0f);
+        airshipZ.assign(n, 0.0f);
+        score.assign(n, 0);
+        deliveries.assign(n, 0);
+        packageCount.assign(n, 0);
+        nextPackageId.assign(n, 0);
+        rng.assign(n, SimRandom());
+
+        houseX.assign(n * NUM_HOUSES, 0.0f);
+        houseY.assign(n * NUM_HOUSES, 0.0f);
+        houseZ.assign(n * NUM_HOUSES, 0.0f);
+        houseNeeds.assign(n * NUM_HOUSES, 0);
+        houseTimer.assign(n * NUM_HOUSES, 0.0f);
+
+        packageX.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageY.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageZ.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageVelX.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageVelY.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageVelZ.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageLife.assign(n * BATCH_MAX_PACKAGES, 0.0f);
+        packageActive.assign(n * BATCH_MAX_PACKAGES, 0);
+
+        for (int w = 0; w < count; w++) {
+            ResetWorld(w, baseSeed + static_cast<unsigned int>(w));
+        }
+    }
+
+    // Starts a new episode in one world, e.g. when a training run ends it.
+    void ResetWorld(int w, unsigned int seed) {
+        GameState s;
+        InitGameState(s, seed);
+
+        airshipX[w] = s.airshipPos.x;
+        airshipY[w] = s.airshipPos.y;
+        airshipZ[w] = s.airshipPos.z;
+        score[w] = 0;
+        deliveries[w] = 0;
+        packageCount[w] = 0;
+        nextPackageId[w] = 0;
+        rng[w] = s.rng;
+
+        for (int h = 0; h < NUM_HOUSES; h++) {
+            size_t i = Index(h, w);
+            houseX[i] = s.housePositions[h].x;
+            houseY[i] = s.housePositions[h].y;
+            houseZ[i] = s.housePositions[h].z;
+            houseNeeds[i] = s.houseNeedsDelivery[h] ? 1 : 0;
+            houseTimer[i] = s.houseDeliveryTimers[h];
+        }
+        for (int k = 0; k < BATCH_MAX_PACKAGES; k++) {
+            packageActive[Index(k, w)] = 0;
+        }
+    }
+
+    // actions: worldCount entries. rewards (optional): score gained by each
+    // world during this tick.
+    void Step(const BatchAction* actions, float dt, float* rewards = nullptr) {
+        tick++;
+
+        auto body = [this, actions, dt, rewards](int begin, int end) {
+            StepRange(begin, end, actions, dt, rewards);
+        };
+
+        if (jobs) {
+            jobs->ParallelFor(0, worldCount, BATCH_WORLD_GRAIN, body);
+        }
+        else {
+            body(0, worldCount);
+        }
+    }
+
+    // observations: worldCount * BATCH_OBSERVATION_SIZE floats, one row per
+    // world.
+    void Observe(float* observations) const {
+        auto body = [this, observations](int begin, int end) {
+            for (int w = begin; w < end; w++) {
+                float* row = observations + static_cast<size_t>(w) * BATCH_OBSERVATION_SIZE;
+                row[0] = airshipX[w];
+                row[1] = airshipY[w];
+                row[2] = airshipZ[w];
+                row[3] = static_cast<float>(score[w]);
+                row[4] = static_cast<float>(packageCount[w]);
+
+                float* house = row + BATCH_OBS_HOUSE_OFFSET;
+                for (int h = 0; h < NUM_HOUSES; h++) {
+                    size_t i = Index(h, w);
+                    house[h * 3 + 0] = houseX[i] - airshipX[w];
+                    house[h * 3 + 1] = houseZ[i] - airshipZ[w];
+                    house[h * 3 + 2] = houseNeeds[i] ? 1.0f : 0.0f;
+                }
+            }
+        };
+
+        if (jobs) {
+            jobs->ParallelFor(0, worldCount, BATCH_WORLD_GRAIN, body);
+        }
+        else {
+            body(0, worldCount);
+        }
+    }
+
+    // Copies one world back into the regular GameState layout, for rendering
+    // or comparing against StepSimulation. Sleds and house colors are left
+    // untouched.
+    void ExtractWorld(int w, GameState& s) const {
+        s.tick = tick;
+        s.airshipPos = glm::vec3(airshipX[w], airshipY[w], airshipZ[w]);
+        s.score = score[w];
+        s.deliveriesCompleted = deliveries[w];
+        s.nextPackageId = nextPackageId[w];
+        s.rng = rng[w];
+
+        s.housePositions.resize(NUM_HOUSES);
+        s.houseNeedsDelivery.resize(NUM_HOUSES);
+        s.houseDeliveryTimers.resize(NUM_HOUSES);
+        for (int h = 0; h < NUM_HOUSES; h++) {
+            size_t i = Index(h, w);
+            s.housePositions[h] = glm::vec3(houseX[i], houseY[i], houseZ[i]);
+            s.houseNeedsDelivery[h] = houseNeeds[i] != 0;
+            s.houseDeliveryTimers[h] = houseTimer[i];
+        }
+
+        s.packages.clear();
+        for (int k = 0; k < packageCount[w]; k++) {
+            size_t i = Index(k, w);
+            Package p;
+            p.id = 0;
+            p.pos = glm::vec3(packageX[i], packageY[i], packageZ[i]);
+            p.velocity = glm::vec3(packageVelX[i], packageVelY[i], packageVelZ[i]);
+            p.lifeTime = packageLife[i];
+            p.active = true;
+            p.color = glm::vec3(1.0f, 0.9f, 0.3f);
+            s.packages.push_back(p);
+        }
+    }
+
+    int WorldCount() const { return worldCount; }
+    unsigned long long Tick() const { return tick; }
+    int Score(int w) const { return score[w]; }
+    int Deliveries(int w) const { return deliveries[w]; }
+    int PackageCount(int w) const { return packageCount[w]; }
+
+private:
+    size_t Index(int row, int w) const {
+        return static_cast<size_t>(row) * worldCount + w;
+    }
+
+    // Same phases and order as StepSimulation, each one run across all
+    // worlds of the range before the next starts.
+    void StepRange(int begin, int end, const BatchAction* actions, float dt, float* rewards) {
+        const size_t n = static_cast<size_t>(worldCount);
+
+        for (int w = begin; w < end; w++) {
+            if (rewards) rewards[w] = static_cast<float>(score[w]);
+
+            const BatchAction& a = actions[w];
+            bool aim = (a.buttons & BATCH_AIM) != 0;
+            for (int d = 0; d < a.drops && packageCount[w] < BATCH_MAX_PACKAGES; d++) {
+                glm::vec3 shotDir(a.forwardX, a.forwardY, a.forwardZ);
+                if (!aim) shotDir = -shotDir;
+                shotDir = glm::normalize(shotDir);
+
+                size_t i = Index(packageCount[w]++, w);
+                packageX[i] = airshipX[w];
+                packageY[i] = aim ? airshipY[w] + 20.0f : airshipY[w];
+                packageZ[i] = airshipZ[w];
+                packageVelX[i] = shotDir.x * PACKAGE_SPEED;
+                packageVelY[i] = shotDir.y * PACKAGE_SPEED;
+                packageVelZ[i] = shotDir.z * PACKAGE_SPEED;
+                packageLife[i] = PACKAGE_LIFETIME;
+                packageActive[i] = 1;
+                nextPackageId[w]++;
+            }
+        }
+
+        int maxPackages = 0;
+        for (int w = begin; w < end; w++) maxPackages = std::max(maxPackages, packageCount[w]);
+
+        const HeightField& ground = TerrainHeightField();
+        const float halfDtSq = 0.5f * dt * dt;
+        const int rangeSize = end - begin;
+
+        thread_local std::vector<float> fromX, fromY, fromZ, groundHit, sampleX, sampleZ, sampleH;
+        thread_local std::vector<int> marchSteps;
+        fromX.resize(rangeSize);
+        fromY.resize(rangeSize);
+        fromZ.resize(rangeSize);
+        groundHit.resize(rangeSize);
+        sampleX.resize(rangeSize);
+        sampleZ.resize(rangeSize);
+        sampleH.resize(rangeSize);
+        marchSteps.resize(rangeSize);
+
+        for (int k = 0; k < maxPackages; k++) {
+            float* px = &packageX[k * n];
+            float* py = &packageY[k * n];
+            float* pz = &packageZ[k * n];
+            float* vx = &packageVelX[k * n];
+            float* vy = &packageVelY[k * n];
+            float* vz = &packageVelZ[k * n];
+            float* life = &packageLife[k * n];
+            uint8_t* active = &packageActive[k * n];
+
+            // Same arithmetic as IntegratePackage. Inactive slots move too;
+            // they are never read, and skipping the branch keeps the loop
+            // vectorizable.
+            for (int w = begin; w < end; w++) {
+                int l = w - begin;
+                fromX[l] = px[w];
+                fromY[l] = py[w];
+                fromZ[l] = pz[w];
+                groundHit[l] = 2.0f;
+
+                px[w] = (px[w] + vx[w] * dt) + 0.0f * halfDtSq;
+                py[w] = (py[w] + vy[w] * dt) + -PACKAGE_GRAVITY * halfDtSq;
+                pz[w] = (pz[w] + vz[w] * dt) + 0.0f * halfDtSq;
+                vy[w] = vy[w] + -PACKAGE_GRAVITY * dt;
+                life[w] -= dt;
+                active[w] = active[w] && life[w] > 0.0f;
+            }
+
+            // Ray-march the ground: sample j of every world in one batch.
+            int maxSteps = 0;
+            for (int w = begin; w < end; w++) {
+                int l = w - begin;
+                marchSteps[l] = active[w] ? ground.MarchSteps(px[w] - fromX[l], pz[w] - fromZ[l]) : 0;
+                maxSteps = std::max(maxSteps, marchSteps[l]);
+            }
+
+            for (int j = 1; j <= maxSteps; j++) {
+                for (int w = begin; w < end; w++) {
+                    int l = w - begin;
+                    float f = static_cast<float>(j) / static_cast<float>(std::max(marchSteps[l], 1));
+                    sampleX[l] = fromX[l] + (px[w] - fromX[l]) * f;
+                    sampleZ[l] = fromZ[l] + (pz[w] - fromZ[l]) * f;
+                }
+                ground.SampleBatch(sampleX.data(), sampleZ.data(), sampleH.data(), rangeSize);
+
+                for (int w = begin; w < end; w++) {
+                    int l = w - begin;
+                    if (j > marchSteps[l] || groundHit[l] <= 1.0f) continue;
+
+                    float f = static_cast<float>(j) / static_cast<float>(marchSteps[l]);
+                    float y = fromY[l] + (py[w] - fromY[l]) * f;
+                    if (y - PACKAGE_RADIUS <= sampleH[l]) {
+                        float prev = static_cast<float>(j - 1) / static_cast<float>(marchSteps[l]);
+                        groundHit[l] = ground.RefineGroundHit(glm::vec3(fromX[l], fromY[l], fromZ[l]),
+                            glm::vec3(px[w], py[w], pz[w]), PACKAGE_RADIUS, prev, f);
+                    }
+                }
+            }
+
+            // Packages are visited in spawn order within each world, so the
+            // earliest one to reach a house gets it, as in StepSimulation.
+            for (int w = begin; w < end; w++) {
+                if (!active[w]) continue;
+                int l = w - begin;
+
+                glm::vec3 p0(fromX[l], fromY[l], fromZ[l]);
+                glm::vec3 p1(px[w], py[w], pz[w]);
+                int house = -1;
+                float best = std::min(groundHit[l], 1.0f);
+                for (int h = 0; h < NUM_HOUSES; h++) {
+                    size_t i = Index(h, w);
+                    if (!houseNeeds[i]) continue;
+                    float t = SweptHouseHit(p0, p1, glm::vec3(houseX[i], houseY[i], houseZ[i]));
+                    if (t <= best && (house < 0 || t < best)) {
+                        house = h;
+                        best = t;
+                    }
+                }
+
+                if (house >= 0) {
+                    houseNeeds[Index(house, w)] = 0;
+                    active[w] = 0;
+                    score[w] += 10;
+                    deliveries[w]++;
+                }
+                else if (groundHit[l] <= 1.0f) {
+                    active[w] = 0;
+                }
+            }
+        }
+
+        // Keep the live packages packed at the front in spawn order.
+        for (int w = begin; w < end; w++) {
+            int live = 0;
+            for (int k = 0; k < packageCount[w]; k++) {
+                size_t from = Index(k, w);
+                if (!packageActive[from]) continue;
+                if (live != k) {
+                    size_t to = Index(live, w);
+                    packageX[to] = packageX[from];
+                    packageY[to] = packageY[from];
+                    packageZ[to] = packageZ[from];
+                    packageVelX[to] = packageVelX[from];
+                    packageVelY[to] = packageVelY[from];
+                    packageVelZ[to] = packageVelZ[from];
+                    packageLife[to] = packageLife[from];
+                    packageActive[to] = 1;
+                    packageActive[from] = 0;
+                }
+                live++;
+            }
+            packageCount[w] = live;
+        }
+
+        for (int h = 0; h < NUM_HOUSES; h++) {
+            uint8_t* needs = &houseNeeds[h * n];
+            float* timer = &houseTimer[h * n];
+            for (int w = begin; w < end; w++) {
+                if (needs[w]) continue;
+                timer[w] -= dt;
+                if (timer[w] <= 0) {
+                    needs[w] = 1;
+                    timer[w] = static_cast<float>(rng[w].Range(10) + 8);
+                }
+            }
+        }
+
+        float moveSpeed = AIRSHIP_SPEED * dt;
+        for (int w = begin; w < end; w++) {
+            const BatchAction& a = actions[w];
+            glm::vec3 camForward(a.forwardX, a.forwardY, a.forwardZ);
+            if (!(a.buttons & BATCH_AIM)) camForward = -camForward;
+
+            glm::vec3 flatForward = glm::normalize(glm::vec3(camForward.x, 0.0f, camForward.z));
+            glm::vec3 flatRight = glm::normalize(glm::cross(flatForward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+            glm::vec3 pos(airshipX[w], airshipY[w], airshipZ[w]);
+            if (a.buttons & BATCH_FORWARD) pos += flatForward * moveSpeed;
+            if (a.buttons & BATCH_BACK) pos -= flatForward * moveSpeed;
+            if (a.buttons & BATCH_LEFT) pos -= flatRight * moveSpeed;
+            if (a.buttons & BATCH_RIGHT) pos += flatRight * moveSpeed;
+            if (a.buttons & BATCH_UP) pos.y += moveSpeed;
+            if (a.buttons & BATCH_DOWN) pos.y -= moveSpeed;
+
+            airshipX[w] = pos.x;
+            airshipY[w] = std::max(50.0f, std::min(1000.0f, pos.y));
+            airshipZ[w] = pos.z;
+
+            if (rewards) rewards[w] = static_cast<float>(score[w]) - rewards[w];
+        }
+    }
+
+    int worldCount = 0;
+    unsigned long long tick = 0;
+    JobSystem* jobs = nullptr;
+
+    std::vector<float> airshipX, airshipY, airshipZ;
+    std::vector<int> score;
+    std::vector<int> deliveries;
+    std::vector<int> packageCount;
+    std::vector<unsigned int> nextPackageId;
+    std::vector<SimRandom> rng;
+
+    // [house * worldCount + world]
+    std::vector<float> houseX, houseY, houseZ;
+    std::vector<uint8_t> houseNeeds;
+    std::vector<float> houseTimer;
+
+    // [slot * worldCount + world]
+    std::vector<float> packageX, packageY, packageZ;
+    std::vector<float> packageVelX, packageVelY, packageVelZ;
+    std::vector<float> packageLife;
+    std::vector<uint8_t> packageActive;
+};
+
+// Converts a SimInput into its batched form, e.g. to drive one batch world
+// with the same controllers as the single-world simulation.
+inline BatchAction MakeBatchAction(const SimInput& input) {
+    BatchAction a;
+    a.forwardX = input.cameraForward.x;
+    a.forwardY = input.cameraForward.y;
+    a.forwardZ = input.cameraForward.z;
+    a.buttons = (input.forward ? BATCH_FORWARD : 0) | (input.back ? BATCH_BACK : 0) |
+        (input.left ? BATCH_LEFT : 0) | (input.right ? BATCH_RIGHT : 0) |
+        (input.up ? BATCH_UP : 0) | (input.down ? BATCH_DOWN : 0) |
+        (input.aimMode ? BATCH_AIM : 0);
+    a.drops = input.dropRequests;
+    return a;
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "jobsystem.h"
+
+inline double BenchSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline int RunJobSystemBenchmark() {
+    JobSystem jobs;
+    std::cout << "=== JOB SYSTEM BENCHMARK (" << jobs.WorkerCount() << " workers) ===" << std::endl;
+
+    {
+        const int taskCount = 200000;
+        std::atomic<int> counter{ 0 };
+        TaskRef done = jobs.Create(nullptr);
+        std::vector<TaskRef> tasks;
+        tasks.reserve(taskCount);
+
+        double start = BenchSeconds();
+        for (int i = 0; i < taskCount; i++) {
+            TaskRef t = jobs.Create([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+            jobs.AddDependency(done, t);
+            tasks.push_back(t);
+        }
+        for (auto& t : tasks) jobs.Submit(t);
+        jobs.Submit(done);
+        jobs.Wait(done);
+        double elapsed = BenchSeconds() - start;
+
+        std::cout << "Independent tasks: " << taskCount << " in " << elapsed * 1000.0 << " ms ("
+            << taskCount / elapsed / 1e6 << " M tasks/s), counter=" << counter.load() << std::endl;
+    }
+
+    {
+        const int chainLength = 50000;
+        int value = 0;
+        double start = BenchSeconds();
+        TaskRef last = jobs.Run([&value]() { value++; });
+        for (int i = 1; i < chainLength; i++) {
+            last = jobs.Then(last, [&value]() { value++; });
+        }
+        jobs.Wait(last);
+        double elapsed = BenchSeconds() - start;
+
+        std::cout << "Continuation chain: " << chainLength << " in " << elapsed * 1000.0 << " ms ("
+            << chainLength / elapsed / 1e6 << " M tasks/s), value=" << value << std::endl;
+    }
+
+    {
+        const int count = 1 << 23;
+        std::vector<float> data(count);
+        for (int i = 0; i < count; i++) data[i] = static_cast<float>(i) * 0.001f;
+
+        auto kernel = [&data](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                data[i] = std::sqrt(data[i] * data[i] + 1.0f) * 0.5f + std::sin(data[i]) * 0.25f;
+            }
+        };
+
+        double start = BenchSeconds();
+        kernel(0, count);
+        double serial = BenchSeconds() - start;
+
+        start = BenchSeconds();
+        jobs.ParallelFor(0, count, 16384, kernel);
+        double parallel = BenchSeconds() - start;
+
+        std::cout << "parallel_for over " << count << " elements: serial " << serial * 1000.0 << " ms, parallel "
+            << parallel * 1000.0 << " ms, speedup " << serial / parallel << "x" << std::endl;
+    }
+
+    std::cout << "Tasks executed: " << jobs.TasksExecuted() << ", stolen: " << jobs.TasksStolen() << std::endl;
+    return 0;
+}
+
+// Counts failed checks of the job system self-test.
+struct JobTestResult {
+    int checks = 0;
+    int failures = 0;
+
+    void Check(bool ok, const char* what, int workers) {
+        checks++;
+        if (ok) return;
+        failures++;
+        std::cerr << "FAILED (" << workers << " workers): " << what << std::endl;
+    }
+};
+
+// Every index of [begin, end) visited exactly once by ParallelFor, and
+// nothing outside it.
+inline bool ParallelForCovers(JobSystem& jobs, int size, int begin, int end, int grain) {
+    std::vector<std::atomic<int>> hits(size);
+    for (auto& h : hits) h.store(0);
+    jobs.ParallelFor(begin, end, grain, [&hits](int b, int e) {
+        for (int i = b; i < e; i++) hits[i].fetch_add(1, std::memory_order_relaxed);
+    });
+    for (int i = 0; i < size; i++) {
+        int expected = (i >= begin && i < end) ? 1 : 0;
+        if (hits[i].load() != expected) return false;
+    }
+    return true;
+}
+
+inline void TestJobSystem(int workers, JobTestResult& r) {
+    JobSystem jobs(workers);
+
+    {
+        // Fan-out/fan-in: every middle task after the root, the sink last.
+        const int width = 64;
+        for (int round = 0; round < 50; round++) {
+            std::atomic<int> clock{ 0 };
+            int rootTime = -1, sinkTime = -1;
+            std::vector<int> middleTimes(width, -1);
+
+            TaskRef root = jobs.Create([&]() { rootTime = clock.fetch_add(1); });
+            TaskRef sink = jobs.Create([&]() { sinkTime = clock.fetch_add(1); });
+            std::vector<TaskRef> middle;
+            for (int i = 0; i < width; i++) {
+                TaskRef t = jobs.Create([&, i]() { middleTimes[i] = clock.fetch_add(1); });
+                jobs.AddDependency(t, root);
+                jobs.AddDependency(sink, t);
+                middle.push_back(t);
+            }
+            jobs.Submit(sink);
+            for (auto& t : middle) jobs.Submit(t);
+            jobs.Submit(root);
+            jobs.Wait(sink);
+
+            bool ordered = rootTime == 0 && sinkTime == width + 1;
+            for (int t : middleTimes) ordered = ordered && t > rootTime && t < sinkTime;
+            r.Check(ordered, "dependencies run before their dependents", workers);
+        }
+
+        // A dependency that has already finished does not hold a task back.
+        TaskRef done = jobs.Run(nullptr);
+        jobs.Wait(done);
+        bool ran = false;
+        TaskRef after = jobs.Create([&ran]() { ran = true; });
+        jobs.AddDependency(after, done);
+        jobs.Submit(after);
+        jobs.Wait(after);
+        r.Check(ran, "dependency on a finished task", workers);
+    }
+
+    {
+        // Each continuation sees all of its predecessors' work.
+        const int length = 2000;
+        int value = 0;
+        bool inOrder = true;
+        TaskRef last = jobs.Run([&value]() { value = 1; });
+        for (int i = 1; i < length; i++) {
+            last = jobs.Then(last, [&value, &inOrder, i]() {
+                if (value != i) inOrder = false;
+                value = i + 1;
+            });
+        }
+        jobs.Wait(last);
+        r.Check(inOrder && value == length, "continuations run in chain order", workers);
+
+        bool ran = false;
+        TaskRef late = jobs.Then(last, [&ran]() { ran = true; });
+        jobs.Wait(late);
+        r.Check(ran, "continuation of a finished task", workers);
+    }
+
+    {
+        const int size = 10007;
+        const int grains[] = { 1, 7, 1000, size, size + 5 };
+        for (int grain : grains) {
+            r.Check(ParallelForCovers(jobs, size, 0, size, grain), "ParallelFor covers the whole range once", workers);
+            r.Check(ParallelForCovers(jobs, size, 13, size - 29, grain), "ParallelFor stays inside a sub-range", workers);
+        }
+        int calls = 0;
+        jobs.ParallelFor(5, 5, 1, [&calls](int, int) { calls++; });
+        jobs.ParallelFor(5, 2, 1, [&calls](int, int) { calls++; });
+        r.Check(calls == 0, "ParallelFor over an empty range does nothing", workers);
+    }
+
+    {
+        // ParallelFor inside jobs, itself nested inside a ParallelFor.
+        const int outer = 32, inner = 1000;
+        std::atomic<long long> sum{ 0 };
+        std::vector<TaskRef> tasks;
+        for (int t = 0; t < 4; t++) {
+            tasks.push_back(jobs.Run([&]() {
+                jobs.ParallelFor(0, outer, 1, [&](int ob, int oe) {
+                    for (int o = ob; o < oe; o++) {
+                        jobs.ParallelFor(0, inner, 64, [&](int b, int e) {
+                            long long local = 0;
+                            for (int i = b; i < e; i++) local += i;
+                            sum.fetch_add(local, std::memory_order_relaxed);
+                        });
+                    }
+                });
+            }));
+        }
+        for (auto& t : tasks) jobs.Wait(t);
+        long long expected = 4LL * outer * (static_cast<long long>(inner) * (inner - 1) / 2);
+        r.Check(sum.load() == expected, "nested ParallelFor from inside a job", workers);
+    }
+
+    {
+        // A thread outside the system, as the simulation thread is: its work
+        // is queued round-robin and its waits steal from every worker.
+        bool outside = false, chained = false, covered = false;
+        std::thread foreign([&]() {
+            outside = jobs.ThisWorkerIndex() == -1;
+            std::atomic<int> count{ 0 };
+            std::vector<TaskRef> tasks;
+            for (int i = 0; i < 500; i++) {
+                tasks.push_back(jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }));
+            }
+            TaskRef last = jobs.Then(tasks.back(), [&]() { chained = count.load() > 0; });
+            for (auto& t : tasks) jobs.Wait(t);
+            jobs.Wait(last);
+            chained = chained && count.load() == 500;
+            covered = ParallelForCovers(jobs, 4096, 0, 4096, 16);
+        });
+        foreign.join();
+        r.Check(outside, "foreign thread has no worker index", workers);
+        r.Check(chained, "tasks submitted from a foreign thread complete", workers);
+        r.Check(covered, "ParallelFor from a foreign thread", workers);
+    }
+}
+
+// Destroying the system with work still queued joins the workers without
+// running the rest of the queue or touching it afterwards.
+inline void TestJobSystemShutdown(int workers, JobTestResult& r) {
+    std::atomic<int> executed{ 0 };
+    {
+        JobSystem jobs(workers);
+        TaskRef blocker = jobs.Create(nullptr);
+        for (int i = 0; i < 20000; i++) {
+            jobs.Run([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+            TaskRef waiting = jobs.Create([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+            if (i % 100 == 0) {
+                jobs.AddDependency(waiting, blocker);
+                jobs.Submit(waiting);
+            }
+        }
+    }
+    int afterShutdown = executed.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    r.Check(executed.load() == afterShutdown, "no task runs after shutdown", workers);
+    r.Check(afterShutdown <= 20000, "tasks behind an unsubmitted dependency never run", workers);
+}
+
+// Self-test of the job system; exit code 1 if any check fails.
+inline int RunJobSystemTests() {
+    JobTestResult r;
+    const int workerCounts[] = { 1, 2, 8 };
+    for (int workers : workerCounts) {
+        TestJobSystem(workers, r);
+        TestJobSystemShutdown(workers, r);
+    }
+    std::cout << "Job system tests: " << r.checks - r.failures << "/" << r.checks << " checks passed" << std::endl;
+    return r.failures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Triangles per leaf before a node is split.
+const int BVH_LEAF_SIZE = 4;
+
+// Bounding volume hierarchy over a triangle soup for visibility rays.
+// Nodes split at the centroid median of their longest axis and are stored
+// depth first, so a node's left child directly follows it.
+class TriangleBvh {
+public:
+    // `corners` holds three positions per triangle.
+    void Build(const std::vector<glm::vec3>& corners) {
+        triangles.clear();
+        for (size_t i = 0; i + 2 < corners.size(); i += 3) {
+            triangles.push_back({ corners[i], corners[i + 1], corners[i + 2] });
+        }
+        nodes.clear();
+        if (triangles.empty()) return;
+        nodes.reserve(triangles.size() * 2 / BVH_LEAF_SIZE + 1);
+        BuildNode(0, static_cast<int>(triangles.size()));
+    }
+
+    int TriangleCount() const { return static_cast<int>(triangles.size()); }
+
+    // True if anything lies along `dir` (unit length) within (0, maxT).
+    bool Occluded(const glm::vec3& origin, const glm::vec3& dir, float maxT) const {
+        if (nodes.empty()) return false;
+        glm::vec3 inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!HitsBox(node, origin, inv, maxT)) continue;
+            if (node.count > 0) {
+                for (int i = node.first; i < node.first + node.count; i++) {
+                    if (HitsTriangle(triangles[i], origin, dir, maxT)) return true;
+                }
+            }
+            else {
+                stack[top++] = node.first;
+                stack[top++] = static_cast<int>(&node - nodes.data()) + 1;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Triangle {
+        glm::vec3 a, b, c;
+    };
+
+    // Leaves hold `count` triangles from `first`; inner nodes have count 0,
+    // the left child right after them and the right child at `first`.
+    struct Node {
+        glm::vec3 lo, hi;
+        int first;
+        int count;
+    };
+
+    int BuildNode(int begin, int end) {
+        int index = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+        glm::vec3 lo = triangles[begin].a, hi = lo;
+        glm::vec3 clo = Centroid(triangles[begin]), chi = clo;
+        for (int i = begin; i < end; i++) {
+            const Triangle& t = triangles[i];
+            lo = glm::min(lo, glm::min(t.a, glm::min(t.b, t.c)));
+            hi = glm::max(hi, glm::max(t.a, glm::max(t.b, t.c)));
+            clo = glm::min(clo, Centroid(t));
+            chi = glm::max(chi, Centroid(t));
+        }
+        nodes[index].lo = lo;
+        nodes[index].hi = hi;
+
+        glm::vec3 extent = chi - clo;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        if (end - begin <= BVH_LEAF_SIZE || extent[axis] <= 0.0f) {
+            nodes[index].first = begin;
+            nodes[index].count = end - begin;
+            return index;
+        }
+
+        int mid = (begin + end) / 2;
+        std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+            [axis](const Triangle& x, const Triangle& y) { return Centroid(x)[axis] < Centroid(y)[axis]; });
+        BuildNode(begin, mid);
+        int right = BuildNode(mid, end);
+        nodes[index].first = right;
+        nodes[index].count = 0;
+        return index;
+    }
+
+    static glm::vec3 Centroid(const Triangle& t) {
+        return (t.a + t.b + t.c) * (1.0f / 3.0f);
+    }
+
+    static bool HitsBox(const Node& node, const glm::vec3& origin, const glm::vec3& inv, float maxT) {
+        float tmin = 0.0f, tmax = maxT;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (node.lo[axis] - origin[axis]) * inv[axis];
+            float t1 = (node.hi[axis] - origin[axis]) * inv[axis];
+            if (t0 > t1) std::swap(t0, t1);
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
+            if (tmin > tmax) return false;
+        }
+        return true;
+    }
+
+    // Moller-Trumbore, both faces.
+    static bool HitsTriangle(const Triangle& t, const glm::vec3& origin, const glm::vec3& dir, float maxT) {
+        glm::vec3 e1 = t.b - t.a;
+        glm::vec3 e2 = t.c - t.a;
+        glm::vec3 p = glm::cross(dir, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < 1e-8f) return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - t.a;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+        float hit = glm::dot(e2, q) * invDet;
+        return hit > 0.0f && hit < maxT;
+    }
+
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+#endif
@@ -15,6 +15,8 @@ struct Camera {
     bool firstMouse = true;
     float mouseSensitivity = 0.1f;
     bool mouseEnabled = true;
+    float pendingMouseX = 0.0f;
+    float pendingMouseY = 0.0f;
 
     void ProcessMouseMovement(float xpos, float ypos) {
         if (!mouseEnabled || firstMouse) {
@@ -29,6 +31,20 @@ struct Camera {
         lastMouseX = xpos;
         lastMouseY = ypos;
 
+        pendingMouseX += xoffset;
+        pendingMouseY += yoffset;
+    }
+
+    // Offsets gathered by ProcessMouseMovement since the last call. The frame
+    // applies them in one step, so recorded and replayed runs turn alike.
+    void TakeMouseOffset(float& x, float& y) {
+        x = pendingMouseX;
+        y = pendingMouseY;
+        pendingMouseX = 0.0f;
+        pendingMouseY = 0.0f;
+    }
+
+    void ApplyMouseOffset(float xoffset, float yoffset) {
         xoffset *= mouseSensitivity;
         yoffset *= mouseSensitivity;
 
@@ -40,6 +56,14 @@ struct Camera {
         if (pitch < -89.0f) pitch = -89.0f;
     }
 
+    // This camera with the movement not yet taken by a frame applied, for
+    // drawing with input that arrived after the frame started.
+    Camera Latched() const {
+        Camera latched = *this;
+        latched.ApplyMouseOffset(pendingMouseX, pendingMouseY);
+        return latched;
+    }
+
     void SetMousePosition(float x, float y) {
         lastMouseX = x;
         lastMouseY = y;
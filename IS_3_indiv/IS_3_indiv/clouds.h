@@ -0,0 +1,281 @@
+#ifndef CLOUDS_H
+#define CLOUDS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "latency.h"
+#include "profiler.h"
+#include "scenedepth.h"
+#include "shaders.h"
+
+const int CLOUD_LAYERS = 3;
+const float CLOUD_LAYER_HEIGHTS[CLOUD_LAYERS] = { 1400.0f, 1900.0f, 2600.0f };
+
+// Half-size of the square the clouds are spread over, and the range of
+// their half-widths.
+const float CLOUD_FIELD_EXTENT = 9000.0f;
+const float CLOUD_MIN_SIZE = 350.0f;
+const float CLOUD_MAX_SIZE = 900.0f;
+
+// Clouds fade out between these distances and are not drawn beyond.
+const float CLOUD_FADE_START = 6000.0f;
+const float CLOUD_FADE_END = 9000.0f;
+
+// How far a cloud drifts from its base position in the shader.
+const float CLOUD_DRIFT = 300.0f;
+
+// Past the LOD distance only one cloud in CLOUD_LOD_STRIDE is drawn, grown to
+// cover the area of the ones dropped; the rest fade out over the band.
+const float CLOUD_LOD_DISTANCE = 3000.0f;
+const float CLOUD_LOD_BAND = 1000.0f;
+const int CLOUD_LOD_STRIDE = 4;
+const float CLOUD_LOD_SCALE = 2.0f;
+
+// Most clouds drawn per frame; the nearest are kept. Together with the
+// half-resolution target this bounds the cost whatever the cloud count.
+const int CLOUD_MAX_DRAWN = 4096;
+
+// Depth over which a cloud thins out in front of the scene behind it.
+const float CLOUD_SOFTNESS = 150.0f;
+
+struct CloudInstance {
+    glm::vec4 posSize;
+    glm::vec4 params;  // atlas frame, id, LOD scale, LOD fade
+};
+
+// Cloud layer drawn as impostor quads from the cloud texture. The CPU culls,
+// picks LODs and sorts the clouds back to front; one instanced draw renders
+// them into a half-resolution target, which is then upsampled onto the
+// scene against its depth.
+class CloudLayer {
+public:
+    bool Init(int clouds, unsigned int cloudTexture, int w, int h, float nearPlane, float farPlane) {
+        atlas = cloudTexture;
+        lowWidth = (w + 1) / 2;
+        lowHeight = (h + 1) / 2;
+
+        depthProgram = CompileProgram(overdraw_vs_source, cloud_depth_fs_source);
+        drawProgram = CompileProgram(cloud_vs_source, cloud_fs_source);
+        compositeProgram = CompileProgram(overdraw_vs_source, cloud_composite_fs_source);
+        if (depthProgram == 0 || drawProgram == 0 || compositeProgram == 0) return false;
+
+        glUseProgram(depthProgram);
+        glUniform1i(glGetUniformLocation(depthProgram, "sceneDepth"), 0);
+        glUniform2f(glGetUniformLocation(depthProgram, "nearFar"), nearPlane, farPlane);
+
+        glUseProgram(drawProgram);
+        unsigned int block = glGetUniformBlockIndex(drawProgram, "FrameUniforms");
+        if (block != GL_INVALID_INDEX) glUniformBlockBinding(drawProgram, block, FRAME_UNIFORM_BINDING);
+        glUniform1i(glGetUniformLocation(drawProgram, "atlas"), 0);
+        glUniform1i(glGetUniformLocation(drawProgram, "lowDepth"), 1);
+        glUniform2f(glGetUniformLocation(drawProgram, "fade"), CLOUD_FADE_START, CLOUD_FADE_END);
+        glUniform1f(glGetUniformLocation(drawProgram, "softness"), CLOUD_SOFTNESS);
+        timeLoc = glGetUniformLocation(drawProgram, "time");
+        cameraPosLoc = glGetUniformLocation(drawProgram, "cameraPos");
+
+        glUseProgram(compositeProgram);
+        glUniform1i(glGetUniformLocation(compositeProgram, "clouds"), 0);
+        glUniform1i(glGetUniformLocation(compositeProgram, "lowDepth"), 1);
+        glUniform1i(glGetUniformLocation(compositeProgram, "sceneDepth"), 2);
+        glUniform2f(glGetUniformLocation(compositeProgram, "nearFar"), nearPlane, farPlane);
+        lowLastLoc = glGetUniformLocation(compositeProgram, "lowLast");
+
+        std::mt19937 rng(0xC10D5);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        cloudData.resize(clouds);
+        for (int i = 0; i < clouds; i++) {
+            float height = CLOUD_LAYER_HEIGHTS[i % CLOUD_LAYERS] + (unit(rng) - 0.5f) * 200.0f;
+            float size = CLOUD_MIN_SIZE + unit(rng) * (CLOUD_MAX_SIZE - CLOUD_MIN_SIZE);
+            cloudData[i].posSize = glm::vec4((unit(rng) * 2.0f - 1.0f) * CLOUD_FIELD_EXTENT, height,
+                (unit(rng) * 2.0f - 1.0f) * CLOUD_FIELD_EXTENT, size);
+            cloudData[i].params = glm::vec4(static_cast<float>(rng() % 4), static_cast<float>(i), 1.0f, 1.0f);
+        }
+        visible.reserve(std::min(clouds, CLOUD_MAX_DRAWN));
+        frameData.reserve(std::min(clouds, CLOUD_MAX_DRAWN));
+
+        glGenVertexArrays(1, &emptyVao);
+        glGenBuffers(1, &instanceVbo);
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(CloudInstance), nullptr);
+        glVertexAttribDivisor(0, 1);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(CloudInstance), (void*)sizeof(glm::vec4));
+        glVertexAttribDivisor(1, 1);
+        glBindVertexArray(0);
+
+        lowDepth = CreateTexture(GL_R32F, GL_RED, GL_FLOAT);
+        color = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        glGenFramebuffers(1, &lowDepthFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, lowDepthFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lowDepth, 0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glGenFramebuffers(1, &colorFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, colorFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            std::cerr << "Cloud framebuffers are incomplete" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Initialized() const { return colorFbo != 0; }
+    int Drawn() const { return static_cast<int>(frameData.size()); }
+
+    // Draws the clouds over the opaque scene in `target`, which covers its
+    // `renderWidth` x `renderHeight` corner and whose depth is in
+    // `sceneDepth`. Leaves `target` bound, `sceneProgram` in use and the
+    // scene's blend, depth and cull state restored.
+    void Draw(unsigned int target, int renderWidth, int renderHeight, const glm::mat4& view,
+        const SceneDepthCopy& sceneDepth, float time, unsigned int sceneProgram) {
+        glm::mat4 toWorld = glm::inverse(view);
+        glm::vec3 cameraPos(toWorld[3]);
+        glm::vec3 forward = -glm::vec3(toWorld[2]);
+        Select(cameraPos, forward);
+
+        int lowW = std::min(lowWidth, (renderWidth + 1) / 2);
+        int lowH = std::min(lowHeight, (renderHeight + 1) / 2);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, lowDepthFbo);
+        glViewport(0, 0, lowW, lowH);
+        glUseProgram(depthProgram);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth.Texture());
+        glBindVertexArray(emptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, colorFbo);
+        const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, clear);
+        if (!frameData.empty()) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            glUseProgram(drawProgram);
+            glUniform1f(timeLoc, time);
+            glUniform3f(cameraPosLoc, cameraPos.x, cameraPos.y, cameraPos.z);
+            glBindTexture(GL_TEXTURE_2D, atlas);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, lowDepth);
+
+            // Orphaned every frame so the upload never waits on the last draw.
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+            glBufferData(GL_ARRAY_BUFFER, frameData.size() * sizeof(CloudInstance), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, frameData.size() * sizeof(CloudInstance), frameData.data());
+            glBindVertexArray(vao);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<int>(frameData.size()));
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glViewport(0, 0, renderWidth, renderHeight);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glUseProgram(compositeProgram);
+        glUniform2i(lowLastLoc, lowW - 1, lowH - 1);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, color);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, lowDepth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth.Texture());
+        glBindVertexArray(emptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
+
+        glUseProgram(sceneProgram);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    // Culls by distance and direction, applies the LOD and fills frameData
+    // with the nearest CLOUD_MAX_DRAWN clouds, farthest first.
+    void Select(const glm::vec3& cameraPos, const glm::vec3& forward) {
+        PROFILE_SCOPE("Cloud sort");
+        visible.clear();
+        for (int i = 0; i < static_cast<int>(cloudData.size()); i++) {
+            glm::vec3 offset = glm::vec3(cloudData[i].posSize) - cameraPos;
+            float reach = cloudData[i].posSize.w * CLOUD_LOD_SCALE + CLOUD_DRIFT;
+            float depth = glm::dot(offset, forward);
+            if (depth < -reach) continue;
+            float distance = glm::length(offset);
+            if (distance > CLOUD_FADE_END + CLOUD_DRIFT) continue;
+            float lod = std::max(0.0f, std::min(1.0f, (distance - CLOUD_LOD_DISTANCE) / CLOUD_LOD_BAND));
+            if (lod >= 1.0f && i % CLOUD_LOD_STRIDE != 0) continue;
+            visible.push_back({ distance, depth, i, lod });
+        }
+
+        if (static_cast<int>(visible.size()) > CLOUD_MAX_DRAWN) {
+            std::nth_element(visible.begin(), visible.begin() + CLOUD_MAX_DRAWN, visible.end(),
+                [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+            visible.resize(CLOUD_MAX_DRAWN);
+        }
+        std::sort(visible.begin(), visible.end(),
+            [](const Candidate& a, const Candidate& b) { return a.depth > b.depth; });
+
+        frameData.clear();
+        for (const Candidate& c : visible) {
+            CloudInstance instance = cloudData[c.index];
+            if (c.index % CLOUD_LOD_STRIDE == 0) instance.params.z = 1.0f + (CLOUD_LOD_SCALE - 1.0f) * c.lod;
+            else instance.params.w = 1.0f - c.lod;
+            frameData.push_back(instance);
+        }
+    }
+
+    unsigned int CreateTexture(GLenum internalFormat, GLenum format, GLenum type) {
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, lowWidth, lowHeight, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    struct Candidate {
+        float distance;
+        float depth;
+        int index;
+        float lod;
+    };
+
+    int lowWidth = 0;
+    int lowHeight = 0;
+    unsigned int atlas = 0;
+
+    unsigned int depthProgram = 0;
+    unsigned int drawProgram = 0;
+    unsigned int compositeProgram = 0;
+    int timeLoc = -1;
+    int cameraPosLoc = -1;
+    int lowLastLoc = -1;
+
+    std::vector<CloudInstance> cloudData;
+    std::vector<Candidate> visible;
+    std::vector<CloudInstance> frameData;
+    unsigned int emptyVao = 0;
+    unsigned int vao = 0;
+    unsigned int instanceVbo = 0;
+
+    unsigned int lowDepth = 0;
+    unsigned int color = 0;
+    unsigned int lowDepthFbo = 0;
+    unsigned int colorFbo = 0;
+};
+
+#endif
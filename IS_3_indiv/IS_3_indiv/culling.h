@@ -0,0 +1,42 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six planes (xyz = inward normal, w = distance), extracted
+// from a projection * view matrix.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    void FromMatrix(const glm::mat4& m) {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+
+        for (auto& p : planes) {
+            p /= glm::length(glm::vec3(p));
+        }
+    }
+
+    bool ContainsSphere(const glm::vec3& center, float radius) const {
+        for (const auto& p : planes) {
+            if (glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+        }
+        return true;
+    }
+};
+
+struct CullStats {
+    int tested = 0;
+    int visible = 0;
+};
+
+#endif
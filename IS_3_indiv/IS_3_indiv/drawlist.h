@@ -0,0 +1,195 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "jobsystem.h"
+
+const int MAX_DRAW_KEYS = 32;
+
+const unsigned int INSTANCE_MODEL_LOCATION = 6;
+const unsigned int INSTANCE_COLOR_LOCATION = 10;
+const unsigned int INSTANCE_LIGHTMAP_LOCATION = 12;
+
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+    // Lightmap tile of the instance: offset in xy, size in zw. Zero size
+    // means the instance is lit dynamically.
+    glm::vec4 lightmap;
+};
+
+// Sort key of a packet: which mesh and which material it is drawn with.
+inline unsigned int MakeDrawKey(int mesh, int material, int materialCount) {
+    return static_cast<unsigned int>(mesh * materialCount + material);
+}
+
+struct DrawPacket {
+    unsigned int key;
+    InstanceData instance;
+};
+
+struct CommandBuffer {
+    std::vector<DrawPacket> packets;
+    int keyCounts[MAX_DRAW_KEYS];
+    int keyOffsets[MAX_DRAW_KEYS];
+
+    void Add(unsigned int key, const glm::mat4& model, const glm::vec4& color,
+        const glm::vec4& lightmap = glm::vec4(0.0f)) {
+        DrawPacket p;
+        p.key = key;
+        p.instance.model = model;
+        p.instance.color = color;
+        p.instance.lightmap = lightmap;
+        packets.push_back(p);
+    }
+};
+
+struct DrawBatch {
+    unsigned int key;
+    int firstInstance;
+    int instanceCount;
+};
+
+// Draw packets are recorded by worker threads into one command buffer per
+// worker. Finalize() counts packets per key, and Write() then scatters every
+// buffer into its slice of the instance stream in parallel, which leaves the
+// instances grouped by key without a global sort.
+class DrawList {
+public:
+    void Init(int workerCount) {
+        buffers.resize(workerCount + 1);
+    }
+
+    void Reset() {
+        for (auto& b : buffers) b.packets.clear();
+        batches.clear();
+    }
+
+    // Runs fn with the calling worker's buffer. Threads outside the job
+    // system share one extra buffer.
+    template <typename F>
+    void Record(JobSystem& jobs, F fn) {
+        int worker = jobs.ThisWorkerIndex();
+        if (worker >= 0 && worker + 1 < static_cast<int>(buffers.size())) {
+            fn(buffers[worker]);
+        }
+        else {
+            std::lock_guard<std::mutex> lock(externalMutex);
+            fn(buffers.back());
+        }
+    }
+
+    int Finalize() {
+        int keyTotals[MAX_DRAW_KEYS] = {};
+
+        for (auto& b : buffers) {
+            for (int k = 0; k < MAX_DRAW_KEYS; k++) b.keyCounts[k] = 0;
+            for (const auto& p : b.packets) b.keyCounts[p.key]++;
+            for (int k = 0; k < MAX_DRAW_KEYS; k++) keyTotals[k] += b.keyCounts[k];
+        }
+
+        int offset = 0;
+        for (int k = 0; k < MAX_DRAW_KEYS; k++) {
+            if (keyTotals[k] > 0) {
+                batches.push_back({ static_cast<unsigned int>(k), offset, keyTotals[k] });
+            }
+
+            for (auto& b : buffers) {
+                b.keyOffsets[k] = offset;
+                offset += b.keyCounts[k];
+            }
+        }
+
+        instanceCount = offset;
+        return instanceCount;
+    }
+
+    void Write(JobSystem& jobs, InstanceData* out) {
+        if (!out) return;
+
+        jobs.ParallelFor(0, static_cast<int>(buffers.size()), 1, [this, out](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                CommandBuffer& b = buffers[i];
+                for (const auto& p : b.packets) {
+                    out[b.keyOffsets[p.key]++] = p.instance;
+                }
+            }
+        });
+    }
+
+    const std::vector<DrawBatch>& Batches() const { return batches; }
+    int InstanceCount() const { return instanceCount; }
+
+private:
+    std::vector<CommandBuffer> buffers;
+    std::vector<DrawBatch> batches;
+    std::mutex externalMutex;
+    int instanceCount = 0;
+};
+
+// Per-frame instance buffer. The storage is orphaned every frame so the
+// mapping never waits for the GPU to finish with the previous frame.
+class InstanceStream {
+public:
+    void Init() {
+        glGenBuffers(1, &vbo);
+    }
+
+    InstanceData* Map(int count) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (count > capacity) {
+            capacity = std::max(count, std::max(capacity * 2, 1024));
+        }
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+
+        if (count == 0) return nullptr;
+        mapped = true;
+        return static_cast<InstanceData*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    }
+
+    void Unmap() {
+        if (!mapped) return;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = false;
+    }
+
+    // Points the instance attributes of `vao` at the batch starting at
+    // `firstInstance`.
+    void Bind(unsigned int vao, int firstInstance) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+        size_t base = static_cast<size_t>(firstInstance) * sizeof(InstanceData);
+        for (unsigned int c = 0; c < 4; c++) {
+            glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + c);
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                (void*)(base + c * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + c, 1);
+        }
+
+        glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+        glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*)(base + offsetof(InstanceData, color)));
+        glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+
+        glEnableVertexAttribArray(INSTANCE_LIGHTMAP_LOCATION);
+        glVertexAttribPointer(INSTANCE_LIGHTMAP_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*)(base + offsetof(InstanceData, lightmap)));
+        glVertexAttribDivisor(INSTANCE_LIGHTMAP_LOCATION, 1);
+    }
+
+private:
+    unsigned int vbo = 0;
+    int capacity = 0;
+    bool mapped = false;
+};
+
+#endif
@@ -0,0 +1,613 @@
+#ifndef FRAMEBENCH_H
+#define FRAMEBENCH_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "profiler.h"
+#include "scene.h"
+#include "simulation.h"
+
+const int BENCH_WARMUP_FRAMES = 30;
+const float BENCH_FRAME_DT = 1.0f / 60.0f;
+const int GPU_TIMER_RING = 4;
+// Timed pass scopes per frame; the scene opens about 18 with every effect on.
+const int GPU_PASS_MAX = 32;
+
+// ARB_pipeline_statistics_query counters collected per pass in the overdraw
+// analysis mode.
+const int PIPELINE_STAT_COUNT = 6;
+const GLenum PIPELINE_STAT_TARGETS[PIPELINE_STAT_COUNT] = {
+    GL_VERTICES_SUBMITTED_ARB, GL_VERTEX_SHADER_INVOCATIONS_ARB, GL_PRIMITIVES_SUBMITTED_ARB,
+    GL_CLIPPING_INPUT_PRIMITIVES_ARB, GL_CLIPPING_OUTPUT_PRIMITIVES_ARB, GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+};
+const char* const PIPELINE_STAT_NAMES[PIPELINE_STAT_COUNT] = {
+    "vertices", "VS invoc", "prims", "clip in", "clip out", "FS invoc"
+};
+
+struct PipelineCounts {
+    unsigned long long values[PIPELINE_STAT_COUNT] = {};
+};
+
+// Draw calls and triangles submitted during one frame.
+struct RenderCounters {
+    int drawCalls = 0;
+    long long triangles = 0;
+
+    void Reset() {
+        drawCalls = 0;
+        triangles = 0;
+    }
+
+    void Add(int vertexCount, int instances = 1) {
+        drawCalls++;
+        triangles += static_cast<long long>(vertexCount / 3) * instances;
+    }
+};
+
+struct SampleSummary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Nearest-rank percentiles.
+inline SampleSummary Summarize(std::vector<double> samples) {
+    SampleSummary s;
+    if (samples.empty()) return s;
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double v : samples) sum += v;
+
+    auto rank = [&samples](double p) {
+        size_t i = static_cast<size_t>(std::ceil(p * samples.size()));
+        return samples[std::min(samples.size() - 1, i > 0 ? i - 1 : 0)];
+    };
+
+    s.mean = sum / samples.size();
+    s.p50 = rank(0.50);
+    s.p95 = rank(0.95);
+    s.p99 = rank(0.99);
+    s.max = samples.back();
+    return s;
+}
+
+// GL_TIME_ELAPSED queries in a small ring, so results are read a few frames
+// later without stalling the pipeline. A frame whose result is not back when
+// its slot comes round again is dropped, as in GpuPassTimer.
+class GpuFrameTimer {
+public:
+    void Init() {
+        glGenQueries(GPU_TIMER_RING, queries);
+    }
+
+    void Begin() {
+        int slot = frame % GPU_TIMER_RING;
+        if (frame >= GPU_TIMER_RING) Collect(slot, false);
+        frameOfSlot[slot] = frame;
+        glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+    }
+
+    void End() {
+        glEndQuery(GL_TIME_ELAPSED);
+        frame++;
+    }
+
+    // Waits for the queries still in flight.
+    void Flush() {
+        int first = std::max(0, frame - GPU_TIMER_RING);
+        for (int f = first; f < frame; f++) Collect(f % GPU_TIMER_RING, true);
+    }
+
+    // Only frames from `firstFrame` on are sampled.
+    void KeepSamples(int firstFrame) {
+        keepFrom = firstFrame;
+    }
+
+    std::vector<double> samplesMs;
+    // Sampled frames dropped because their result was late.
+    int droppedFrames = 0;
+
+private:
+    void Collect(int slot, bool wait) {
+        if (frameOfSlot[slot] < keepFrom) return;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait) {
+            droppedFrames++;
+            return;
+        }
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &ns);
+        samplesMs.push_back(ns / 1.0e6);
+    }
+
+    unsigned int queries[GPU_TIMER_RING] = {};
+    int frameOfSlot[GPU_TIMER_RING] = {};
+    int frame = 0;
+    int keepFrom = 0;
+};
+
+// GL_TIMESTAMP pairs around each render pass, GPU_TIMER_RING frames deep.
+// Timestamps rather than GL_TIME_ELAPSED, so passes can be timed while the
+// whole-frame query is running. A frame whose results are not back when its
+// slot comes round again is dropped instead of stalling the pipeline.
+class GpuPassTimer {
+public:
+    void Init() {
+        glGenQueries(GPU_TIMER_RING * GPU_PASS_MAX * 2, queries);
+    }
+
+    // Also brackets every pass with pipeline statistics queries.
+    bool EnablePipelineStats(bool enable) {
+        if (enable && !GLEW_ARB_pipeline_statistics_query) {
+            std::cerr << "ARB_pipeline_statistics_query is not supported" << std::endl;
+            return false;
+        }
+        if (enable && statQueries[0] == 0) {
+            glGenQueries(GPU_TIMER_RING * GPU_PASS_MAX * PIPELINE_STAT_COUNT, statQueries);
+        }
+        pipelineStats = enable;
+        return true;
+    }
+
+    void BeginFrame() {
+        slot = frame % GPU_TIMER_RING;
+        if (frame >= GPU_TIMER_RING) Collect(slot, false);
+        passCount[slot] = 0;
+        frameOfSlot[slot] = frame;
+        statsInSlot[slot] = pipelineStats;
+    }
+
+    void EndFrame() {
+        frame++;
+    }
+
+    void Begin(const char* name) {
+        int pass = passCount[slot];
+        if (pass >= GPU_PASS_MAX) {
+            if (overflowPasses++ == 0) {
+                std::cerr << "GPU pass timer: more than " << GPU_PASS_MAX << " passes in a frame, \"" << name
+                    << "\" and later passes are not timed" << std::endl;
+            }
+            return;
+        }
+        names[slot][pass] = name;
+        glQueryCounter(Query(slot, pass, 0), GL_TIMESTAMP);
+        if (statsInSlot[slot]) {
+            for (int i = 0; i < PIPELINE_STAT_COUNT; i++) glBeginQuery(PIPELINE_STAT_TARGETS[i], StatQuery(slot, pass, i));
+        }
+    }
+
+    void End() {
+        int pass = passCount[slot];
+        if (pass >= GPU_PASS_MAX) return;
+        if (statsInSlot[slot]) {
+            for (int i = 0; i < PIPELINE_STAT_COUNT; i++) glEndQuery(PIPELINE_STAT_TARGETS[i]);
+        }
+        glQueryCounter(Query(slot, pass, 1), GL_TIMESTAMP);
+        passCount[slot]++;
+    }
+
+    // Average pipeline counters per frame and pass since the last report,
+    // then starts a new report.
+    void PrintPipelineStats(int pixels) {
+        if (statFrames == 0) return;
+
+        std::cout << "=== PIPELINE STATISTICS (per frame, " << statFrames << " frames) ===" << std::endl;
+        std::cout << std::left << std::setw(16) << "Pass" << std::right;
+        for (int i = 0; i < PIPELINE_STAT_COUNT; i++) std::cout << std::setw(12) << PIPELINE_STAT_NAMES[i];
+        std::cout << std::setw(12) << "FS/pixel" << std::endl;
+
+        PipelineCounts total;
+        for (const auto& pass : statTotals) {
+            PrintPipelineRow(pass.first, pass.second, pixels);
+            for (int i = 0; i < PIPELINE_STAT_COUNT; i++) total.values[i] += pass.second.values[i];
+        }
+        PrintPipelineRow("Total", total, pixels);
+
+        double fsPerPixel = static_cast<double>(total.values[PIPELINE_STAT_COUNT - 1]) / statFrames / pixels;
+        std::cout << "Fragment shader invocations per pixel: " << fsPerPixel << std::endl;
+
+        statTotals.clear();
+        statFrames = 0;
+    }
+
+    // Waits for the frames still in flight.
+    void Flush() {
+        int first = std::max(0, frame - GPU_TIMER_RING);
+        for (int f = first; f < frame; f++) Collect(f % GPU_TIMER_RING, true);
+    }
+
+    // Frames from `firstFrame` on also keep their per-pass totals, for the
+    // benchmark report.
+    void KeepSamples(int firstFrame) {
+        keepFrom = firstFrame;
+    }
+
+    // Per-pass milliseconds of every kept frame, in order of first use.
+    std::vector<std::pair<std::string, std::vector<double>>> samplesMs;
+    // Frames whose results were not back in time and were dropped; with
+    // KeepSamples, only those from its first frame on. The per-pass samples
+    // have this many fewer entries than frames measured.
+    int droppedFrames = 0;
+    // Pass scopes opened after a frame already had GPU_PASS_MAX, untimed.
+    int overflowPasses = 0;
+
+private:
+    unsigned int Query(int s, int pass, int end) const {
+        return queries[(s * GPU_PASS_MAX + pass) * 2 + end];
+    }
+
+    unsigned int StatQuery(int s, int pass, int stat) const {
+        return statQueries[(s * GPU_PASS_MAX + pass) * PIPELINE_STAT_COUNT + stat];
+    }
+
+    void PrintPipelineRow(const std::string& name, const PipelineCounts& counts, int pixels) const {
+        std::cout << std::left << std::setw(16) << name << std::right;
+        for (int i = 0; i < PIPELINE_STAT_COUNT; i++) std::cout << std::setw(12) << counts.values[i] / statFrames;
+        std::cout << std::setw(12) << std::setprecision(3)
+            << static_cast<double>(counts.values[PIPELINE_STAT_COUNT - 1]) / statFrames / pixels << std::setprecision(6) << std::endl;
+    }
+
+    void Collect(int s, bool wait) {
+        int count = passCount[s];
+        if (count == 0) return;
+
+        GLint available = 0;
+        glGetQueryObjectiv(Query(s, count - 1, 1), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait) {
+            if (keepFrom < 0 || frameOfSlot[s] >= keepFrom) droppedFrames++;
+            passCount[s] = 0;
+            return;
+        }
+
+        bool keep = keepFrom >= 0 && frameOfSlot[s] >= keepFrom;
+        size_t firstSample = 0;
+        if (keep) {
+            for (auto& pass : samplesMs) firstSample = std::max(firstSample, pass.second.size());
+        }
+
+        for (int p = 0; p < count; p++) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(Query(s, p, 0), GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(Query(s, p, 1), GL_QUERY_RESULT, &end);
+            double ms = (end - begin) / 1.0e6;
+            PROFILE_GPU(names[s][p], ms);
+
+            if (keep) {
+                std::vector<double>& series = Series(names[s][p]);
+                series.resize(firstSample + 1, 0.0);
+                series[firstSample] += ms;
+            }
+
+            if (statsInSlot[s]) {
+                PipelineCounts& counts = StatTotals(names[s][p]);
+                for (int i = 0; i < PIPELINE_STAT_COUNT; i++) {
+                    GLuint64 value = 0;
+                    glGetQueryObjectui64v(StatQuery(s, p, i), GL_QUERY_RESULT, &value);
+                    counts.values[i] += value;
+                }
+            }
+        }
+        if (statsInSlot[s]) statFrames++;
+        passCount[s] = 0;
+    }
+
+    PipelineCounts& StatTotals(const char* name) {
+        for (auto& pass : statTotals) {
+            if (pass.first == name) return pass.second;
+        }
+        statTotals.emplace_back(name, PipelineCounts());
+        return statTotals.back().second;
+    }
+
+    std::vector<double>& Series(const char* name) {
+        for (auto& pass : samplesMs) {
+            if (pass.first == name) return pass.second;
+        }
+        samplesMs.emplace_back(name, std::vector<double>());
+        return samplesMs.back().second;
+    }
+
+    unsigned int queries[GPU_TIMER_RING * GPU_PASS_MAX * 2] = {};
+    const char* names[GPU_TIMER_RING][GPU_PASS_MAX] = {};
+    int passCount[GPU_TIMER_RING] = {};
+    int frameOfSlot[GPU_TIMER_RING] = {};
+    int slot = 0;
+    int frame = 0;
+    int keepFrom = -1;
+
+    bool pipelineStats = false;
+    bool statsInSlot[GPU_TIMER_RING] = {};
+    unsigned int statQueries[GPU_TIMER_RING * GPU_PASS_MAX * PIPELINE_STAT_COUNT] = {};
+    std::vector<std::pair<std::string, PipelineCounts>> statTotals;
+    int statFrames = 0;
+};
+
+class GpuPassScope {
+public:
+    GpuPassScope(GpuPassTimer& timer, const char* name) : timer(timer) { timer.Begin(name); }
+    ~GpuPassScope() { timer.End(); }
+
+private:
+    GpuPassTimer& timer;
+};
+
+// Times the rest of the scope as a render pass on the GPU and as a CPU zone.
+#define PROFILE_PASS(timer, name) PROFILE_SCOPE(name); GpuPassScope PROFILE_CONCAT(gpuPass, __LINE__)(timer, name)
+
+// Render target for runs without a visible window.
+class OffscreenTarget {
+public:
+    bool Init(int width, int height) {
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &depth);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    unsigned int Framebuffer() const { return fbo; }
+
+private:
+    unsigned int fbo = 0;
+    unsigned int color = 0;
+    unsigned int depth = 0;
+};
+
+// Window hints for the offscreen context. "egl" asks for a surfaceless EGL
+// context on GLFW's null platform where available, "osmesa" for a software
+// OSMesa context; both run on llvmpipe without a display.
+inline bool ApplyOffscreenHints(const std::string& api) {
+    if (api.empty() || api == "none") return true;
+
+    if (api != "egl" && api != "osmesa") {
+        std::cerr << "Unknown offscreen API: " << api << std::endl;
+        return false;
+    }
+
+#ifdef GLFW_PLATFORM_NULL
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    return true;
+}
+
+inline void ApplyOffscreenWindowHints(const std::string& api) {
+    if (api.empty() || api == "none") return;
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, api == "osmesa" ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+}
+
+// Scripted flight for benchmark runs: the first half circles the village in
+// overview mode, the second half flies in aim mode and drops a package every
+// half second. Depends only on the frame index.
+inline void BenchmarkCameraPath(int frame, int frameCount, Camera& camera, bool& aimMode, SimInput& input) {
+    int half = std::max(1, frameCount / 2);
+    float t = static_cast<float>(frame % half) / static_cast<float>(half);
+
+    input = SimInput();
+    input.forward = true;
+    aimMode = frame >= half;
+
+    if (!aimMode) {
+        camera.pitch = 25.0f + 15.0f * sin(t * 2.0f * M_PI);
+        camera.yaw = 180.0f + t * 360.0f;
+        input.up = t < 0.25f;
+        input.down = t > 0.75f;
+    }
+    else {
+        camera.pitch = -10.0f - 10.0f * sin(t * 4.0f * M_PI);
+        camera.yaw = t * 540.0f;
+        input.down = t < 0.5f;
+        input.dropRequests = frame % 30 == 0 ? 1 : 0;
+    }
+
+    input.aimMode = aimMode;
+    input.cameraForward = camera.GetForward();
+}
+
+struct BenchmarkResult {
+    unsigned int seed = 0;
+    int frames = 0;
+    int width = 0;
+    int height = 0;
+    std::string offscreen;
+    SceneConfig scene;
+    std::string replay;
+    // Snowflakes and clouds actually drawn; 0 when off or failed to start.
+    int snow = 0;
+    int clouds = 0;
+
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs;
+    std::vector<double> drawCalls;
+    std::vector<double> triangles;
+    std::vector<std::pair<std::string, std::vector<double>>> gpuPassMs;
+    // Measured frames missing from gpuMs and gpuPassMs because their
+    // queries were late.
+    int gpuDroppedFrames = 0;
+    int gpuPassDroppedFrames = 0;
+    // Pass scopes left untimed because a frame had more than GPU_PASS_MAX.
+    int gpuPassOverflows = 0;
+};
+
+// "Christmas tree" -> "gpu_pass_christmas_tree", the JSON and baseline name.
+inline std::string GpuPassMetric(const std::string& pass) {
+    std::string metric = "gpu_pass_";
+    for (char c : pass) {
+        metric += (c == ' ' || c == '-') ? '_' : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return metric;
+}
+
+inline void WriteSummaryJson(std::ostream& out, const char* name, const SampleSummary& s, bool last = false) {
+    out << "  \"" << name << "\": { \"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+        << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << " }" << (last ? "\n" : ",\n");
+}
+
+inline bool WriteBenchmarkJson(const std::string& path, const BenchmarkResult& r) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Failed to write benchmark results: " << path << std::endl;
+        return false;
+    }
+
+    out << "{\n";
+    out << "  \"seed\": " << r.seed << ",\n";
+    out << "  \"frames\": " << r.frames << ",\n";
+    out << "  \"warmup_frames\": " << BENCH_WARMUP_FRAMES << ",\n";
+    out << "  \"gpu_dropped_frames\": " << r.gpuDroppedFrames << ",\n";
+    out << "  \"gpu_pass_dropped_frames\": " << r.gpuPassDroppedFrames << ",\n";
+    out << "  \"gpu_pass_overflows\": " << r.gpuPassOverflows << ",\n";
+    out << "  \"resolution\": [" << r.width << ", " << r.height << "],\n";
+    out << "  \"offscreen\": \"" << (r.offscreen.empty() ? "none" : r.offscreen) << "\",\n";
+    std::string input = r.replay.empty() ? "scripted" : r.replay;
+    std::replace(input.begin(), input.end(), '\\', '/');
+    out << "  \"input\": \"" << input << "\",\n";
+    out << "  \"scene\": { \"layout\": \"" << SceneLayoutName(r.scene.layout) << "\", \"houses\": " << r.scene.houses
+        << ", \"trees\": " << r.scene.trees << ", \"lanterns\": " << r.scene.lanterns << ", \"sleds\": " << r.scene.sleds
+        << ", \"autofire\": " << r.scene.autofire << " },\n";
+    out << "  \"effects\": { \"snow\": " << r.snow << ", \"clouds\": " << r.clouds << " },\n";
+    WriteSummaryJson(out, "cpu_ms", Summarize(r.cpuMs));
+    WriteSummaryJson(out, "gpu_ms", Summarize(r.gpuMs));
+    WriteSummaryJson(out, "draw_calls", Summarize(r.drawCalls));
+    WriteSummaryJson(out, "triangles", Summarize(r.triangles), r.gpuPassMs.empty());
+    for (size_t i = 0; i < r.gpuPassMs.size(); i++) {
+        std::string key = GpuPassMetric(r.gpuPassMs[i].first) + "_ms";
+        WriteSummaryJson(out, key.c_str(), Summarize(r.gpuPassMs[i].second), i + 1 == r.gpuPassMs.size());
+    }
+    out << "}\n";
+    return true;
+}
+
+// Budget file: a flat JSON object of limits, e.g.
+//   { "cpu_p95_ms": 16.0, "gpu_p99_ms": 20.0, "draw_calls_max": 40 }
+// Keys are <metric>_<statistic>[_ms] for cpu/gpu/draw_calls/triangles or a
+// pass (gpu_pass_terrain, ...) and mean/p50/p95/p99/max. Returns the number of budgets exceeded, or -1 if the
+// file cannot be read.
+inline int CheckBenchmarkBaseline(const std::string& path, const BenchmarkResult& r) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open benchmark baseline: " << path << std::endl;
+        return -1;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    for (char& c : text) {
+        if (c == '{' || c == '}' || c == ',' || c == ':' || c == '"') c = ' ';
+    }
+
+    std::vector<std::string> metrics = { "cpu", "gpu", "draw_calls", "triangles" };
+    std::vector<SampleSummary> summaries = { Summarize(r.cpuMs), Summarize(r.gpuMs), Summarize(r.drawCalls), Summarize(r.triangles) };
+    for (const auto& pass : r.gpuPassMs) {
+        metrics.push_back(GpuPassMetric(pass.first));
+        summaries.push_back(Summarize(pass.second));
+    }
+
+    int exceeded = 0;
+    std::stringstream ss(text);
+    std::string key;
+    double limit = 0.0;
+    while (ss >> key >> limit) {
+        std::string name = key;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "_ms") == 0) name.resize(name.size() - 3);
+
+        size_t split = name.rfind('_');
+        if (split == std::string::npos) {
+            std::cerr << "Unknown baseline key: " << key << std::endl;
+            continue;
+        }
+        std::string metric = name.substr(0, split);
+        std::string stat = name.substr(split + 1);
+
+        int m = -1;
+        for (size_t i = 0; i < metrics.size(); i++) {
+            if (metric == metrics[i]) m = static_cast<int>(i);
+        }
+
+        if (m < 0) {
+            std::cerr << "Unknown baseline key: " << key << std::endl;
+            continue;
+        }
+
+        const SampleSummary& s = summaries[m];
+        double value = 0.0;
+        if (stat == "mean") value = s.mean;
+        else if (stat == "p50") value = s.p50;
+        else if (stat == "p95") value = s.p95;
+        else if (stat == "p99") value = s.p99;
+        else if (stat == "max") value = s.max;
+        else {
+            std::cerr << "Unknown baseline key: " << key << std::endl;
+            continue;
+        }
+
+        if (value > limit) {
+            std::cerr << "Budget exceeded: " << key << " = " << value << " (limit " << limit << ")" << std::endl;
+            exceeded++;
+        }
+    }
+    return exceeded;
+}
+
+inline void PrintBenchmarkSummary(const BenchmarkResult& r) {
+    SampleSummary cpu = Summarize(r.cpuMs);
+    SampleSummary gpu = Summarize(r.gpuMs);
+    SampleSummary draws = Summarize(r.drawCalls);
+    SampleSummary tris = Summarize(r.triangles);
+
+    std::cout << "=== FRAME BENCHMARK ===" << std::endl;
+    std::cout << "Frames: " << r.frames << " (seed " << r.seed << ", " << r.width << "x" << r.height << ")" << std::endl;
+    std::cout << "CPU ms: mean " << cpu.mean << ", p50 " << cpu.p50 << ", p95 " << cpu.p95 << ", p99 " << cpu.p99 << std::endl;
+    std::cout << "GPU ms: mean " << gpu.mean << ", p50 " << gpu.p50 << ", p95 " << gpu.p95 << ", p99 " << gpu.p99
+        << " (" << r.gpuDroppedFrames << " frames dropped, results not ready in time)" << std::endl;
+    std::cout << "Draw calls: mean " << draws.mean << ", max " << draws.max << "; triangles: mean " << tris.mean
+        << ", max " << tris.max << std::endl;
+    if (!r.gpuPassMs.empty()) {
+        std::cout << "GPU passes: timed in " << r.frames - r.gpuPassDroppedFrames << " of " << r.frames << " frames ("
+            << r.gpuPassDroppedFrames << " dropped, results not ready in time)" << std::endl;
+    }
+    if (r.gpuPassOverflows > 0) {
+        std::cout << "GPU passes: " << r.gpuPassOverflows << " pass scopes untimed, over the limit of " << GPU_PASS_MAX
+            << " per frame" << std::endl;
+    }
+    for (const auto& pass : r.gpuPassMs) {
+        SampleSummary s = Summarize(pass.second);
+        std::cout << "  GPU " << pass.first << ": mean " << s.mean << " ms, p95 " << s.p95 << " ms" << std::endl;
+    }
+}
+
+#endif
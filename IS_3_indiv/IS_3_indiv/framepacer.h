@@ -0,0 +1,228 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+#include "benchmarks.h"
+#include "framebench.h"
+#include "profiler.h"
+
+enum PaceMode {
+    PACE_OFF,       // as fast as possible
+    PACE_VSYNC,     // swap interval 1
+    PACE_ADAPTIVE,  // swap interval -1: tear instead of waiting a whole refresh when late
+    PACE_CAP        // fixed rate, timed by the CPU
+};
+
+const char* const PACE_MODE_NAMES[] = { "off", "vsync", "adaptive", "cap" };
+
+// Frames whose raw delta is averaged, and the largest delta a frame may see
+// (a stall such as dragging the window must not turn into one huge step).
+const int PACE_SMOOTH_FRAMES = 4;
+const float PACE_MAX_DELTA = 0.1f;
+
+// Share of the accumulated difference between smoothed and real time paid
+// back per frame, so game time cannot drift from the wall clock.
+const float PACE_DRIFT_GAIN = 0.25f;
+
+// Sleeps are requested in these steps while more than the expected
+// oversleep remains; the rest of the wait is spun.
+const double PACE_SLEEP_STEP = 0.001;
+
+inline bool ParsePaceMode(const std::string& name, int& mode) {
+    for (int m = PACE_OFF; m <= PACE_CAP; m++) {
+        if (name == PACE_MODE_NAMES[m]) {
+            mode = m;
+            return true;
+        }
+    }
+    std::cerr << "Unknown pacing mode: " << name << std::endl;
+    return false;
+}
+
+// Keeps the loop from running faster than it needs to. Vsync and adaptive
+// sync leave the waiting to the swap; the cap and power saving wait before
+// the frame starts, sleeping while the OS timer is safely coarse enough and
+// spinning the last stretch. While the window is unfocused or iconified the
+// rate drops to idleFps in every mode.
+class FramePacer {
+public:
+    void Init(int paceMode, double fps, double idle) {
+        mode = paceMode;
+        capPeriod = fps > 0.0 ? 1.0 / fps : 0.0;
+        idlePeriod = idle > 0.0 ? 1.0 / idle : 0.0;
+
+        if (mode == PACE_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+            && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+            std::cout << "Adaptive sync is not supported, using vsync" << std::endl;
+            mode = PACE_VSYNC;
+        }
+        glfwSwapInterval(mode == PACE_VSYNC ? 1 : mode == PACE_ADAPTIVE ? -1 : 0);
+
+#ifdef _WIN32
+        timeBeginPeriod(1);
+        timerPeriodSet = true;
+#endif
+    }
+
+    ~FramePacer() {
+#ifdef _WIN32
+        if (timerPeriodSet) timeEndPeriod(1);
+#endif
+    }
+
+    // Whether SwapBuffers itself blocks until the next refresh.
+    bool SwapWaits() const { return mode == PACE_VSYNC || mode == PACE_ADAPTIVE; }
+
+    // Before each frame. Returns the time the frame starts at.
+    double Wait(GLFWwindow* window) {
+        bool idle = idlePeriod > 0.0 && (!glfwGetWindowAttrib(window, GLFW_FOCUSED) || glfwGetWindowAttrib(window, GLFW_ICONIFIED));
+        double period = idle ? idlePeriod : mode == PACE_CAP ? capPeriod : 0.0;
+
+        double now = BenchSeconds();
+        if (period > 0.0 && lastStart > 0.0) {
+            // Deadlines follow a fixed grid so one late frame does not push
+            // every later one back; after a long stall the grid restarts.
+            deadline = std::max(deadline + period, now - period);
+            if (deadline > now) {
+                PROFILE_SCOPE("Frame pacing");
+                SleepUntil(deadline);
+                now = BenchSeconds();
+            }
+        }
+        else {
+            deadline = now;
+        }
+
+        if (lastStart > 0.0) {
+            double interval = now - lastStart;
+            PROFILE_COUNTER("Frame interval ms", interval * 1000.0);
+            if (!idle) {
+                intervals.push_back(interval * 1000.0);
+                if (period > 0.0) targets.push_back(period * 1000.0);
+            }
+            else {
+                idleFrames++;
+            }
+        }
+        lastStart = now;
+        return now;
+    }
+
+    // Averages the last few frame deltas and feeds back whatever the average
+    // lost or gained, so the simulation sees steady steps that still add up
+    // to real time.
+    float SmoothDelta(float raw) {
+        raw = std::min(std::max(raw, 0.0f), PACE_MAX_DELTA);
+        history[historyNext] = raw;
+        historyNext = (historyNext + 1) % PACE_SMOOTH_FRAMES;
+        historyCount = std::min(historyCount + 1, PACE_SMOOTH_FRAMES);
+
+        float average = 0.0f;
+        for (int i = 0; i < historyCount; i++) average += history[i];
+        average /= historyCount;
+
+        float smoothed = std::max(0.0f, average + drift * PACE_DRIFT_GAIN);
+        drift += raw - smoothed;
+        return smoothed;
+    }
+
+    void PrintReport() const {
+        if (idleFrames > 0) std::cout << "Power-save frames (unfocused or iconified): " << idleFrames << std::endl;
+        std::cout << "Frame pacing (" << PACE_MODE_NAMES[mode] << "): ";
+        if (intervals.size() < 2) {
+            std::cout << "not enough focused frames" << std::endl;
+            return;
+        }
+
+        // Jitter is the change between consecutive intervals: a steady 40 ms
+        // is smooth, alternating 10 and 30 ms is not.
+        std::vector<double> jitter;
+        double mean = 0.0;
+        for (size_t i = 0; i < intervals.size(); i++) {
+            mean += intervals[i];
+            if (i > 0) jitter.push_back(std::fabs(intervals[i] - intervals[i - 1]));
+        }
+        mean /= intervals.size();
+        double variance = 0.0;
+        for (double v : intervals) variance += (v - mean) * (v - mean);
+        double stddev = std::sqrt(variance / intervals.size());
+
+        SampleSummary s = Summarize(intervals);
+        SampleSummary j = Summarize(jitter);
+        std::cout << intervals.size() << " frames, interval mean " << s.mean << " ms, stddev " << stddev << " ms, p99 "
+            << s.p99 << " ms, max " << s.max << " ms; jitter p50 " << j.p50 << " ms, p95 " << j.p95 << " ms, p99 "
+            << j.p99 << " ms" << std::endl;
+
+        if (!targets.empty()) {
+            int late = 0;
+            for (size_t i = 0; i < targets.size() && i < intervals.size(); i++) {
+                if (intervals[i] > targets[i] * 1.5) late++;
+            }
+            std::cout << "Frames over 1.5x the target interval: " << late << std::endl;
+        }
+    }
+
+private:
+    // The OS may oversleep; the expected oversleep is tracked from past
+    // sleeps (mean plus one standard deviation) and sleeping stops once less
+    // than that remains.
+    void SleepUntil(double target) {
+        for (;;) {
+            double remaining = target - BenchSeconds();
+            if (remaining <= sleepEstimate) break;
+
+            double start = BenchSeconds();
+            std::this_thread::sleep_for(std::chrono::duration<double>(PACE_SLEEP_STEP));
+            double slept = BenchSeconds() - start;
+
+            sleepCount++;
+            double delta = slept - sleepMean;
+            sleepMean += delta / sleepCount;
+            sleepM2 += delta * (slept - sleepMean);
+            sleepEstimate = sleepMean + std::sqrt(sleepM2 / sleepCount);
+        }
+        while (BenchSeconds() < target) std::this_thread::yield();
+    }
+
+    int mode = PACE_OFF;
+    double capPeriod = 0.0;
+    double idlePeriod = 0.0;
+    double deadline = 0.0;
+    double lastStart = 0.0;
+#ifdef _WIN32
+    bool timerPeriodSet = false;
+#endif
+
+    double sleepEstimate = 0.005;
+    double sleepMean = 0.0;
+    double sleepM2 = 0.0;
+    long long sleepCount = 0;
+
+    float history[PACE_SMOOTH_FRAMES] = {};
+    int historyNext = 0;
+    int historyCount = 0;
+    float drift = 0.0f;
+
+    std::vector<double> intervals;
+    std::vector<double> targets;
+    int idleFrames = 0;
+};
+
+#endif
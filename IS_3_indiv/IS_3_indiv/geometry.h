@@ -0,0 +1,515 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "heightfield.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846f
+#endif
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec2 texCoords;
+    glm::vec3 normal;
+    glm::vec3 tangent;
+    float type;
+    // Position in the mesh's lightmap tile, [0, 1] on both axes. Only meshes
+    // with baked lighting (lightmap.h) fill it in.
+    glm::vec2 lightmapUv = glm::vec2(0.0f);
+};
+
+inline void computeTangents(std::vector<Vertex>& out) {
+    for (size_t i = 0; i < out.size(); i += 3) {
+        if (i + 2 >= out.size()) break;
+        glm::vec3& v0 = out[i].position;
+        glm::vec3& v1 = out[i + 1].position;
+        glm::vec3& v2 = out[i + 2].position;
+        glm::vec2& uv0 = out[i].texCoords;
+        glm::vec2& uv1 = out[i + 1].texCoords;
+        glm::vec2& uv2 = out[i + 2].texCoords;
+
+        glm::vec3 edge1 = v1 - v0;
+        glm::vec3 edge2 = v2 - v0;
+        glm::vec2 deltaUV1 = uv1 - uv0;
+        glm::vec2 deltaUV2 = uv2 - uv0;
+
+        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+        glm::vec3 tangent;
+        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+
+        tangent = glm::normalize(tangent);
+        out[i].tangent = out[i + 1].tangent = out[i + 2].tangent = tangent;
+    }
+}
+
+inline void load_obj(const std::string& path, std::vector<Vertex>& out) {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texcoords;
+    std::vector<glm::vec3> normals;
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to load OBJ file: " << path << ". Using fallback cube." << std::endl;
+        float s = 1.0f;
+        positions = {
+            {-s,-s,-s}, {s,-s,-s}, {s,s,-s}, {-s,s,-s},
+            {-s,-s,s}, {s,-s,s}, {s,s,s}, {-s,s,s}
+        };
+
+        int indices[] = {
+            0,1,2, 0,2,3, 4,5,6, 4,6,7,
+            0,1,5, 0,5,4, 1,2,6, 1,6,5,
+            2,3,7, 2,7,6, 3,0,4, 3,4,7
+        };
+
+        for (int i = 0; i < 36; i++) {
+            Vertex v;
+            v.position = positions[indices[i]];
+            v.texCoords = glm::vec2(0.0f, 0.0f);
+            v.normal = glm::normalize(v.position);
+            v.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+            v.type = 0.0f;
+            out.push_back(v);
+        }
+        computeTangents(out);
+        return;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string type;
+        ss >> type;
+
+        if (type == "v") {
+            glm::vec3 pos;
+            ss >> pos.x >> pos.y >> pos.z;
+            positions.push_back(pos);
+        }
+        else if (type == "vt") {
+            glm::vec2 uv;
+            ss >> uv.x >> uv.y;
+            uv.y = 1.0f - uv.y;
+            texcoords.push_back(uv);
+        }
+        else if (type == "vn") {
+            glm::vec3 normal;
+            ss >> normal.x >> normal.y >> normal.z;
+            normals.push_back(normal);
+        }
+        else if (type == "f") {
+            std::string v1, v2, v3;
+            ss >> v1 >> v2 >> v3;
+
+            auto parseFace = [&](const std::string& vertex) {
+                std::stringstream vss(vertex);
+                std::string indices[3];
+                for (int i = 0; i < 3; i++) {
+                    std::getline(vss, indices[i], '/');
+                }
+
+                int posIdx = std::stoi(indices[0]) - 1;
+                int texIdx = indices[1].empty() ? 0 : std::stoi(indices[1]) - 1;
+                int normIdx = indices[2].empty() ? 0 : std::stoi(indices[2]) - 1;
+
+                Vertex v;
+                v.position = positions[posIdx];
+                v.texCoords = texIdx < texcoords.size() ? texcoords[texIdx] : glm::vec2(0.0f);
+                v.normal = normIdx < normals.size() ? normals[normIdx] : glm::vec3(0.0f, 1.0f, 0.0f);
+                v.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+                v.type = 0.0f;
+
+                return v;
+                };
+
+            out.push_back(parseFace(v1));
+            out.push_back(parseFace(v2));
+            out.push_back(parseFace(v3));
+        }
+    }
+
+    file.close();
+    std::cout << "Loaded OBJ file: " << path << " with " << out.size() << " vertices" << std::endl;
+    computeTangents(out);
+}
+
+// Planar lightmap coordinates of a point over a terrain of side `size`
+// centered on the origin.
+inline glm::vec2 TerrainLightmapUv(const glm::vec3& position, float size) {
+    return glm::vec2(position.x / size + 0.5f, position.z / size + 0.5f);
+}
+
+// Lightmap layout for meshes made of quads split into triangle pairs: pair k
+// gets cell k of a `cells` x `cells` grid, its first triangle the lower right
+// half and its second the upper left. Cells are inset by `margin` of a cell
+// so filtering does not bleed between them.
+inline void PackLightmapCells(std::vector<Vertex>& out, size_t first, int cells, float margin) {
+    const glm::vec2 corners[2][3] = {
+        { {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f} },
+        { {0.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} }
+    };
+    float cell = 1.0f / static_cast<float>(cells);
+    for (size_t i = first; i + 2 < out.size(); i += 3) {
+        size_t triangle = (i - first) / 3;
+        int pair = static_cast<int>(triangle / 2);
+        glm::vec2 origin(static_cast<float>(pair % cells), static_cast<float>(pair / cells));
+        for (int k = 0; k < 3; k++) {
+            glm::vec2 c = corners[triangle % 2][k] * (1.0f - 2.0f * margin) + glm::vec2(margin);
+            out[i + k].lightmapUv = (origin + c) * cell;
+        }
+    }
+}
+
+// Triangle mesh of a height field centered on the origin.
+inline void BuildTerrainMesh(const HeightField& field, std::vector<Vertex>& out) {
+    int width = field.width, height = field.height;
+    float size = field.cellSize * static_cast<float>(width);
+
+    std::vector<std::vector<glm::vec3>> posMap(height, std::vector<glm::vec3>(width));
+
+    for (int z = 0; z < height; z++) {
+        for (int x = 0; x < width; x++) {
+            posMap[z][x] = glm::vec3(
+                (static_cast<float>(x) / static_cast<float>(width) - 0.5f) * size,
+                field.At(x, z),
+                (static_cast<float>(z) / static_cast<float>(height) - 0.5f) * size
+            );
+        }
+    }
+
+    for (int z = 0; z < height - 1; z++) {
+        for (int x = 0; x < width - 1; x++) {
+            glm::vec2 uv0(static_cast<float>(x) / static_cast<float>(width), static_cast<float>(z) / static_cast<float>(height));
+            glm::vec2 uv1(static_cast<float>(x) / static_cast<float>(width), static_cast<float>(z + 1) / static_cast<float>(height));
+            glm::vec2 uv2(static_cast<float>(x + 1) / static_cast<float>(width), static_cast<float>(z) / static_cast<float>(height));
+            glm::vec2 uv3(static_cast<float>(x + 1) / static_cast<float>(width), static_cast<float>(z + 1) / static_cast<float>(height));
+
+            out.push_back({ posMap[z][x], uv0 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
+            out.push_back({ posMap[z + 1][x], uv1 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
+            out.push_back({ posMap[z][x + 1], uv2 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
+
+            out.push_back({ posMap[z][x + 1], uv2 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
+            out.push_back({ posMap[z + 1][x], uv1 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
+            out.push_back({ posMap[z + 1][x + 1], uv3 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
+        }
+    }
+    computeTangents(out);
+    for (auto& v : out) v.lightmapUv = TerrainLightmapUv(v.position, size);
+}
+
+inline void generateTerrain(std::vector<Vertex>& out) {
+    BuildTerrainMesh(TerrainHeightField(), out);
+}
+
+inline void generateSphere(std::vector<Vertex>& out, float radius, int sectors, int stacks, float type) {
+    std::vector<Vertex> raw;
+    for (int i = 0; i <= stacks; ++i) {
+        float stackAngle = M_PI / 2.0f - static_cast<float>(i) / static_cast<float>(stacks) * M_PI;
+        float xy = radius * cosf(stackAngle);
+        float z = radius * sinf(stackAngle);
+        for (int j = 0; j <= sectors; ++j) {
+            float sectorAngle = static_cast<float>(j) / static_cast<float>(sectors) * 2.0f * M_PI;
+            glm::vec3 pos(xy * cosf(sectorAngle), z, xy * sinf(sectorAngle));
+            raw.push_back({ pos,
+                           glm::vec2(static_cast<float>(j) / static_cast<float>(sectors),
+                                     static_cast<float>(i) / static_cast<float>(stacks)),
+                           glm::normalize(pos),
+                           {0.0f,0.0f,0.0f},
+                           type });
+        }
+    }
+
+    std::vector<Vertex> tris;
+    for (int i = 0; i < stacks; ++i) {
+        int k1 = i * (sectors + 1);
+        int k2 = k1 + sectors + 1;
+        for (int j = 0; j < sectors; ++j, ++k1, ++k2) {
+            if (i != 0) {
+                tris.push_back(raw[k1]);
+                tris.push_back(raw[k2]);
+                tris.push_back(raw[k1 + 1]);
+            }
+            if (i != (stacks - 1)) {
+                tris.push_back(raw[k1 + 1]);
+                tris.push_back(raw[k2]);
+                tris.push_back(raw[k2 + 1]);
+            }
+        }
+    }
+    computeTangents(tris);
+    out.insert(out.end(), tris.begin(), tris.end());
+}
+
+// Six box faces and a roof of four triangles (paired up for the lightmap).
+const int HOUSE_LIGHTMAP_CELLS = 3;
+
+inline void generateHouse(std::vector<Vertex>& out) {
+    float w = 0.5f, h = 0.5f, d = 0.5f;
+    size_t first = out.size();
+
+    glm::vec3 vertices[] = {
+        {-w, -h,  d}, { w, -h,  d}, { w,  h,  d}, {-w,  h,  d},
+        {-w, -h, -d}, { w, -h, -d}, { w,  h, -d}, {-w,  h, -d}
+    };
+
+    int indices[] = {
+        0,1,2, 0,2,3,
+        5,4,7, 5,7,6,
+        1,5,6, 1,6,2,
+        4,0,3, 4,3,7,
+        3,2,6, 3,6,7,
+        4,5,1, 4,1,0
+    };
+
+    for (int i = 0; i < 36; i += 3) {
+        int idx1 = indices[i], idx2 = indices[i + 1], idx3 = indices[i + 2];
+
+        Vertex v1, v2, v3;
+        v1.position = vertices[idx1];
+        v2.position = vertices[idx2];
+        v3.position = vertices[idx3];
+
+        v1.texCoords = glm::vec2(0.0f, 0.0f);
+        v2.texCoords = glm::vec2(1.0f, 0.0f);
+        v3.texCoords = glm::vec2(0.5f, 1.0f);
+
+        glm::vec3 edge1 = v2.position - v1.position;
+        glm::vec3 edge2 = v3.position - v1.position;
+        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
+
+        v1.normal = v2.normal = v3.normal = normal;
+        v1.type = v2.type = v3.type = 0.0f;
+        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+
+        out.push_back(v1);
+        out.push_back(v2);
+        out.push_back(v3);
+    }
+
+    glm::vec3 roofVertices[] = {
+        {-w * 1.3f, h, -d * 1.3f},
+        { w * 1.3f, h, -d * 1.3f},
+        { w * 1.3f, h,  d * 1.3f},
+        {-w * 1.3f, h,  d * 1.3f},
+        {0.0f, h + 0.6f, 0.0f}
+    };
+
+    int roofIndices[] = {
+        0,1,4, 1,2,4, 2,3,4, 3,0,4
+    };
+
+    for (int i = 0; i < 12; i += 3) {
+        int idx1 = roofIndices[i], idx2 = roofIndices[i + 1], idx3 = roofIndices[i + 2];
+
+        Vertex v1, v2, v3;
+        v1.position = roofVertices[idx1];
+        v2.position = roofVertices[idx2];
+        v3.position = roofVertices[idx3];
+
+        v1.texCoords = glm::vec2(0.0f, 0.0f);
+        v2.texCoords = glm::vec2(1.0f, 0.0f);
+        v3.texCoords = glm::vec2(0.5f, 1.0f);
+
+        glm::vec3 edge1 = v2.position - v1.position;
+        glm::vec3 edge2 = v3.position - v1.position;
+        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
+
+        v1.normal = v2.normal = v3.normal = normal;
+        v1.type = v2.type = v3.type = 0.0f;
+        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+
+        out.push_back(v1);
+        out.push_back(v2);
+        out.push_back(v3);
+    }
+
+    computeTangents(out);
+    PackLightmapCells(out, first, HOUSE_LIGHTMAP_CELLS, 0.1f);
+}
+
+inline void generateTree(std::vector<Vertex>& out) {
+    float trunkHeight = 1.2f;
+    float trunkRadius = 0.1f;
+    int segments = 8;
+
+    for (int i = 0; i < segments; i++) {
+        float a1 = 2.0f * M_PI * i / segments;
+        float a2 = 2.0f * M_PI * (i + 1) / segments;
+
+        glm::vec3 p1(cos(a1) * trunkRadius, -0.5f, sin(a1) * trunkRadius);
+        glm::vec3 p2(cos(a2) * trunkRadius, -0.5f, sin(a2) * trunkRadius);
+        glm::vec3 p3(cos(a1) * trunkRadius, trunkHeight, sin(a1) * trunkRadius);
+        glm::vec3 p4(cos(a2) * trunkRadius, trunkHeight, sin(a2) * trunkRadius);
+
+        out.push_back({ p1, {0.0f, 0.0f}, glm::normalize(glm::vec3(p1.x, 0.0f, p1.z)), {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ p2, {1.0f, 0.0f}, glm::normalize(glm::vec3(p2.x, 0.0f, p2.z)), {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ p3, {0.0f, 1.0f}, glm::normalize(glm::vec3(p1.x, 0.0f, p1.z)), {0.0f,0.0f,0.0f}, 0.0f });
+
+        out.push_back({ p2, {1.0f, 0.0f}, glm::normalize(glm::vec3(p2.x, 0.0f, p2.z)), {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ p4, {1.0f, 1.0f}, glm::normalize(glm::vec3(p2.x, 0.0f, p2.z)), {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ p3, {0.0f, 1.0f}, glm::normalize(glm::vec3(p1.x, 0.0f, p1.z)), {0.0f,0.0f,0.0f}, 0.0f });
+    }
+
+    std::vector<Vertex> crown1, crown2;
+    generateSphere(crown1, 0.5f, 8, 6, 1.0f);
+    generateSphere(crown2, 0.3f, 8, 6, 1.0f);
+
+    for (auto& v : crown1) { v.position.y += trunkHeight - 0.1f; out.push_back(v); }
+    for (auto& v : crown2) { v.position.y += trunkHeight + 0.3f; out.push_back(v); }
+
+    computeTangents(out);
+}
+
+inline void generateLantern(std::vector<Vertex>& out) {
+    float r = 2.0f, h = 40.0f;
+
+    for (int i = 0; i < 12; i++) {
+        float a = 2.0f * M_PI * i / 12.0f;
+        float na = 2.0f * M_PI * (i + 1) / 12.0f;
+
+        glm::vec3 n(cos(a), 0.0f, sin(a));
+
+        out.push_back({ {cos(a) * r, 0.0f, sin(a) * r}, {0.0f,0.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ {cos(na) * r, 0.0f, sin(na) * r}, {1.0f,0.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ {cos(a) * r, h, sin(a) * r}, {0.0f,1.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
+
+        out.push_back({ {cos(na) * r, 0.0f, sin(na) * r}, {1.0f,0.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ {cos(na) * r, h, sin(na) * r}, {1.0f,1.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
+        out.push_back({ {cos(a) * r, h, sin(a) * r}, {0.0f,1.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
+    }
+
+    computeTangents(out);
+
+    std::vector<Vertex> bulb;
+    generateSphere(bulb, 4.0f, 10, 10, 1.0f);
+    for (auto& v : bulb) {
+        v.position.y += h;
+        out.push_back(v);
+    }
+}
+
+inline void generateSled(std::vector<Vertex>& out) {
+    float length = 1.0f;
+    float width = 0.3f;
+    float height = 0.15f;
+
+    glm::vec3 vertices[] = {
+        {-length / 2, height / 2, -width / 2},
+        { length / 2, height / 2, -width / 2},
+        { length / 2, height / 2,  width / 2},
+        {-length / 2, height / 2,  width / 2},
+
+        {-length / 2, height, -width / 2},
+        { length / 2, height, -width / 2},
+        { length / 2, height,  width / 2},
+        {-length / 2, height,  width / 2},
+
+        {-length / 2 * 0.7f, 0.0f, -width / 2},
+        { length / 2 * 0.7f, 0.0f, -width / 2},
+        { length / 2 * 0.7f, 0.0f,  width / 2},
+        {-length / 2 * 0.7f, 0.0f,  width / 2},
+
+        {0.0f, height * 0.5f, -width / 2},
+        {0.0f, height * 0.5f, width / 2}
+    };
+
+    int indices[] = {
+        0,1,2, 0,2,3,
+
+        0,4,5, 0,5,1,
+        1,5,6, 1,6,2,
+        2,6,7, 2,7,3,
+        3,7,4, 3,4,0,
+
+        4,5,6, 4,6,7,
+
+        8,9,10, 8,10,11,
+
+        0,8,11, 0,11,3,
+        1,9,8, 1,8,0,
+        2,10,9, 2,9,1,
+        3,11,10, 3,10,2,
+
+        8,12,9, 11,13,10
+    };
+
+    for (int i = 0; i < 36; i += 3) {
+        int idx1 = indices[i], idx2 = indices[i + 1], idx3 = indices[i + 2];
+
+        Vertex v1, v2, v3;
+        v1.position = vertices[idx1];
+        v2.position = vertices[idx2];
+        v3.position = vertices[idx3];
+
+        v1.texCoords = glm::vec2(0.0f, 0.0f);
+        v2.texCoords = glm::vec2(1.0f, 0.0f);
+        v3.texCoords = glm::vec2(0.5f, 1.0f);
+
+        glm::vec3 edge1 = v2.position - v1.position;
+        glm::vec3 edge2 = v3.position - v1.position;
+        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
+
+        v1.normal = v2.normal = v3.normal = normal;
+        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+        v1.type = v2.type = v3.type = 0.0f;
+
+        out.push_back(v1);
+        out.push_back(v2);
+        out.push_back(v3);
+    }
+
+    computeTangents(out);
+}
+
+inline void generateSnowCircle(std::vector<Vertex>& out) {
+    float radius = 200.0f;
+    int segments = 32;
+    float centerY = 0.0f;
+
+    glm::vec3 center(0.0f, centerY, 200.0f);
+
+    for (int i = 0; i < segments; i++) {
+        float angle1 = 2.0f * M_PI * i / segments;
+        float angle2 = 2.0f * M_PI * (i + 1) / segments;
+
+        glm::vec3 p1 = center + glm::vec3(sin(angle1) * radius, 0.0f, cos(angle1) * radius);
+        glm::vec3 p2 = center + glm::vec3(sin(angle2) * radius, 0.0f, cos(angle2) * radius);
+        glm::vec3 p3 = center;
+
+        p3.y = centerY + 5.0f;
+
+        Vertex v1, v2, v3;
+        v1.position = p1;
+        v2.position = p2;
+        v3.position = p3;
+
+        v1.texCoords = glm::vec2((sin(angle1) + 1.0f) * 0.5f, (cos(angle1) + 1.0f) * 0.5f);
+        v2.texCoords = glm::vec2((sin(angle2) + 1.0f) * 0.5f, (cos(angle2) + 1.0f) * 0.5f);
+        v3.texCoords = glm::vec2(0.5f, 0.5f);
+
+        v1.normal = v2.normal = v3.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+        v1.type = v2.type = v3.type = 0.0f;
+
+        out.push_back(v1);
+        out.push_back(v2);
+        out.push_back(v3);
+    }
+
+    computeTangents(out);
+    // Lies on the terrain, so it reads the terrain's lightmap.
+    for (auto& v : out) v.lightmapUv = TerrainLightmapUv(v.position, TERRAIN_SIZE);
+}
+
+#endif
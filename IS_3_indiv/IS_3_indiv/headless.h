@@ -0,0 +1,452 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "batchsim.h"
+#include "camera.h"
+#include "jobsystem.h"
+#include "log.h"
+#include "options.h"
+#include "simulation.h"
+
+// Called once per tick before stepping. It sees the current state and fills
+// in the input for the next tick; camera yaw/pitch drive the airship heading
+// exactly as the mouse does in the windowed game.
+typedef std::function<void(const GameState&, Camera&, SimInput&)> SimController;
+
+struct HeadlessStats {
+    long long ticks = 0;
+    double wallSeconds = 0.0;
+    double simSeconds = 0.0;
+};
+
+inline HeadlessStats RunHeadlessSimulation(GameState& state, long long ticks, float dt,
+    const SimController& controller, JobSystem* jobs) {
+    HeadlessStats stats;
+    Camera camera;
+    SimInput input;
+
+    long long reportEvery = std::max(1LL, ticks / 10);
+    auto start = std::chrono::steady_clock::now();
+
+    for (long long t = 0; t < ticks; t++) {
+        input.dropRequests = 0;
+        if (controller) controller(state, camera, input);
+        input.cameraForward = camera.GetForward();
+
+        StepSimulation(state, input, dt, jobs);
+
+        if ((t + 1) % reportEvery == 0 && t + 1 < ticks) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  " << (t + 1) * 100 / ticks << "%: tick " << t + 1 << ", score " << state.score
+                << ", " << (elapsed > 0.0 ? (t + 1) / elapsed : 0.0) << " ticks/s" << std::endl;
+        }
+    }
+
+    stats.ticks = ticks;
+    stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.simSeconds = state.gameTime;
+    return stats;
+}
+
+// Timed input script. One command per line, "#" starts a comment:
+//   <seconds> press|release forward|back|left|right|up|down
+//   <seconds> aim on|off
+//   <seconds> look <yaw> <pitch>
+//   <seconds> drop
+class InputScript {
+public:
+    bool Load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open input script: " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            size_t comment = line.find('#');
+            if (comment != std::string::npos) line = line.substr(0, comment);
+
+            std::stringstream ss(line);
+            Event e;
+            if (!(ss >> e.time)) continue;
+            if (!(ss >> e.command)) {
+                std::cerr << "Script line " << lineNumber << ": missing command" << std::endl;
+                return false;
+            }
+            ss >> e.arg;
+            if (e.command == "look") {
+                std::stringstream args(e.arg);
+                args >> e.x;
+                ss >> e.y;
+            }
+            events.push_back(e);
+        }
+
+        std::stable_sort(events.begin(), events.end(),
+            [](const Event& a, const Event& b) { return a.time < b.time; });
+        std::cout << "Loaded " << events.size() << " script events from " << path << std::endl;
+        return true;
+    }
+
+    void Apply(double gameTime, Camera& camera, SimInput& input) {
+        while (next < events.size() && events[next].time <= gameTime) {
+            const Event& e = events[next++];
+            bool pressed = e.command == "press";
+
+            if (e.command == "press" || e.command == "release") {
+                if (e.arg == "forward") input.forward = pressed;
+                else if (e.arg == "back") input.back = pressed;
+                else if (e.arg == "left") input.left = pressed;
+                else if (e.arg == "right") input.right = pressed;
+                else if (e.arg == "up") input.up = pressed;
+                else if (e.arg == "down") input.down = pressed;
+            }
+            else if (e.command == "aim") {
+                input.aimMode = e.arg == "on";
+            }
+            else if (e.command == "look") {
+                camera.yaw = e.x;
+                camera.pitch = std::max(-89.0f, std::min(89.0f, e.y));
+            }
+            else if (e.command == "drop") {
+                input.dropRequests++;
+            }
+        }
+    }
+
+private:
+    struct Event {
+        float time = 0.0f;
+        std::string command;
+        std::string arg;
+        float x = 0.0f;
+        float y = 0.0f;
+    };
+
+    std::vector<Event> events;
+    size_t next = 0;
+};
+
+// Flies low towards the nearest house that wants a delivery and fires at it
+// in aim mode once it is in range.
+struct SeekBot {
+    float dt = 1.0f / 120.0f;
+    float dropCooldown = 0.0f;
+
+    void operator()(const GameState& s, Camera& camera, SimInput& input) {
+        dropCooldown -= dt;
+        input = SimInput();
+        input.aimMode = true;
+
+        int target = -1;
+        float best = 0.0f;
+        for (int i = 0; i < s.HouseCount(); i++) {
+            if (!s.houseNeedsDelivery[i]) continue;
+            glm::vec2 d(s.housePositions[i].x - s.airshipPos.x, s.housePositions[i].z - s.airshipPos.z);
+            float dist = glm::length(d);
+            if (target < 0 || dist < best) {
+                target = i;
+                best = dist;
+            }
+        }
+        if (target < 0) return;
+
+        glm::vec3 muzzle = s.airshipPos + glm::vec3(0.0f, 20.0f, 0.0f);
+        glm::vec3 aimPoint = s.housePositions[target] + glm::vec3(0.0f, 25.0f, 0.0f);
+        float flightTime = glm::length(aimPoint - muzzle) / PACKAGE_SPEED;
+        aimPoint.y += 0.5f * PACKAGE_GRAVITY * flightTime * flightTime;
+        glm::vec3 dir = glm::normalize(aimPoint - muzzle);
+
+        camera.yaw = glm::degrees(std::atan2(dir.x, dir.z));
+        camera.pitch = std::max(-89.0f, std::min(89.0f, glm::degrees(std::asin(dir.y))));
+
+        input.forward = best > 300.0f;
+        input.down = s.airshipPos.y > 60.0f;
+
+        if (best < 500.0f && dropCooldown <= 0.0f) {
+            input.dropRequests = 1;
+            dropCooldown = 0.5f;
+        }
+    }
+};
+
+// SeekBot for the batched simulator: reads observation rows and writes one
+// action per world.
+struct BatchSeekPolicy {
+    float dt = 1.0f / 120.0f;
+    std::vector<float> dropCooldown;
+
+    void operator()(const float* observations, BatchAction* actions, int worldCount) {
+        dropCooldown.resize(worldCount, 0.0f);
+
+        for (int w = 0; w < worldCount; w++) {
+            const float* row = observations + static_cast<size_t>(w) * BATCH_OBSERVATION_SIZE;
+            const float* house = row + BATCH_OBS_HOUSE_OFFSET;
+            BatchAction& a = actions[w];
+            a = BatchAction();
+            a.buttons = BATCH_AIM;
+            dropCooldown[w] -= dt;
+
+            int target = -1;
+            float best = 0.0f;
+            for (int h = 0; h < NUM_HOUSES; h++) {
+                if (house[h * 3 + 2] == 0.0f) continue;
+                float dist = std::sqrt(house[h * 3] * house[h * 3] + house[h * 3 + 1] * house[h * 3 + 1]);
+                if (target < 0 || dist < best) {
+                    target = h;
+                    best = dist;
+                }
+            }
+            if (target < 0) continue;
+
+            glm::vec3 offset(house[target * 3], 15.0f + 25.0f - (row[1] + 20.0f), house[target * 3 + 1]);
+            float flightTime = glm::length(offset) / PACKAGE_SPEED;
+            offset.y += 0.5f * PACKAGE_GRAVITY * flightTime * flightTime;
+            glm::vec3 dir = glm::normalize(offset);
+            a.forwardX = dir.x;
+            a.forwardY = dir.y;
+            a.forwardZ = dir.z;
+
+            if (best > 300.0f) a.buttons |= BATCH_FORWARD;
+            if (row[1] > 60.0f) a.buttons |= BATCH_DOWN;
+
+            if (best < 500.0f && dropCooldown[w] <= 0.0f) {
+                a.drops = 1;
+                dropCooldown[w] = 0.5f;
+            }
+        }
+    }
+};
+
+// Largest difference in a position, velocity or lifetime that --batch-check
+// accepts; the vectorized loops may round differently from StepSimulation.
+const float BATCH_CHECK_TOLERANCE = 1e-3f;
+
+// First difference between a batch world and its StepSimulation twin, or an
+// empty string. `deviation` grows to the largest float difference seen.
+inline std::string CompareBatchWorld(const GameState& ref, const GameState& batch, float& deviation) {
+    auto near = [&deviation](const glm::vec3& a, const glm::vec3& b) {
+        glm::vec3 d = glm::abs(a - b);
+        float m = std::max(d.x, std::max(d.y, d.z));
+        deviation = std::max(deviation, m);
+        return m <= BATCH_CHECK_TOLERANCE;
+    };
+
+    if (ref.score != batch.score) return "score";
+    if (ref.deliveriesCompleted != batch.deliveriesCompleted) return "deliveries";
+    if (ref.nextPackageId != batch.nextPackageId) return "packages dropped";
+    if (ref.packages.size() != batch.packages.size()) return "packages in flight";
+    for (int h = 0; h < NUM_HOUSES; h++) {
+        if ((ref.houseNeedsDelivery[h] != 0) != batch.houseNeedsDelivery[h]) return "house needs delivery";
+        if (ref.houseDeliveryTimers[h] != batch.houseDeliveryTimers[h]) return "house delivery timer";
+    }
+    if (!near(ref.airshipPos, batch.airshipPos)) return "airship position";
+    for (size_t k = 0; k < ref.packages.size(); k++) {
+        const Package& a = ref.packages[k];
+        const Package& b = batch.packages[k];
+        if (!near(a.pos, b.pos)) return "package position";
+        if (!near(a.velocity, b.velocity)) return "package velocity";
+        if (std::fabs(a.lifeTime - b.lifeTime) > BATCH_CHECK_TOLERANCE) return "package lifetime";
+    }
+    return std::string();
+}
+
+// Steps every batch world next to a GameState run through StepSimulation
+// from the same seed, both flown by the seek bot with the same input, and
+// compares them after every tick. Exit code 1 if any world diverges.
+inline int RunBatchCheck(const Options& opt, unsigned int seed, long long ticks, float dt) {
+    int count = opt.batch;
+    JobSystem jobs;
+    BatchSimulator batch;
+    batch.Init(count, seed, &jobs);
+
+    std::vector<GameState> reference(count);
+    std::vector<Camera> cameras(count);
+    std::vector<SeekBot> bots(count);
+    for (int w = 0; w < count; w++) {
+        InitGameState(reference[w], seed + static_cast<unsigned int>(w));
+        bots[w].dt = dt;
+    }
+
+    std::cout << "=== BATCH CHECK ===" << std::endl;
+    std::cout << "Worlds: " << count << " (seeds " << seed << ".." << seed + count - 1 << "), ticks: " << ticks
+        << " at " << opt.tickRate << " Hz, seek bot" << std::endl;
+
+    std::vector<BatchAction> actions(count);
+    std::vector<std::string> mismatch(count);
+    std::vector<long long> mismatchTick(count, -1);
+    std::vector<float> deviation(count, 0.0f);
+    long long drops = 0;
+
+    for (long long t = 0; t < ticks; t++) {
+        jobs.ParallelFor(0, count, 16, [&](int begin, int end) {
+            for (int w = begin; w < end; w++) {
+                SimInput input;
+                bots[w](reference[w], cameras[w], input);
+                input.cameraForward = cameras[w].GetForward();
+                actions[w] = MakeBatchAction(input);
+                StepSimulation(reference[w], input, dt);
+            }
+        });
+        for (const auto& a : actions) drops += a.drops;
+
+        batch.Step(actions.data(), dt);
+
+        jobs.ParallelFor(0, count, 16, [&](int begin, int end) {
+            GameState extracted;
+            for (int w = begin; w < end; w++) {
+                if (mismatchTick[w] >= 0) continue;
+                batch.ExtractWorld(w, extracted);
+                std::string what = CompareBatchWorld(reference[w], extracted, deviation[w]);
+                if (!what.empty()) {
+                    mismatch[w] = what;
+                    mismatchTick[w] = t + 1;
+                }
+            }
+        });
+    }
+
+    int diverged = 0;
+    float largest = 0.0f;
+    long long deliveries = 0;
+    for (int w = 0; w < count; w++) {
+        largest = std::max(largest, deviation[w]);
+        deliveries += reference[w].deliveriesCompleted;
+        if (mismatchTick[w] < 0) continue;
+        if (diverged < 10) {
+            std::cerr << "World " << w << " (seed " << seed + w << ") diverged at tick " << mismatchTick[w]
+                << ": " << mismatch[w] << std::endl;
+        }
+        diverged++;
+    }
+
+    std::cout << "Drops: " << drops << ", deliveries: " << deliveries << ", largest float difference: " << largest << std::endl;
+    std::cout << (diverged == 0 ? "PASS" : "FAIL") << ": " << count - diverged << "/" << count
+        << " worlds match StepSimulation" << std::endl;
+    return diverged == 0 ? 0 : 1;
+}
+
+inline int RunBatchHeadless(const Options& opt, unsigned int seed, long long ticks, float dt) {
+    if (!opt.script.empty()) {
+        std::cerr << "--script is not supported with --batch" << std::endl;
+        return -1;
+    }
+    SceneConfig classic;
+    if (opt.scene.layout != classic.layout || opt.scene.houses != classic.houses || opt.scene.trees != classic.trees ||
+        opt.scene.lanterns != classic.lanterns || opt.scene.sleds != classic.sleds || opt.scene.autofire != classic.autofire) {
+        std::cerr << "Scene options are not supported with --batch; batch worlds are the classic scene" << std::endl;
+        return -1;
+    }
+    if (!opt.bot.empty() && opt.bot != "idle" && opt.bot != "seek") {
+        std::cerr << "Unknown bot: " << opt.bot << std::endl;
+        return -1;
+    }
+    bool seek = opt.bot == "seek";
+    if (opt.batchCheck) return RunBatchCheck(opt, seed, ticks, dt);
+
+    JobSystem jobs;
+    BatchSimulator batch;
+    batch.Init(opt.batch, seed, &jobs);
+
+    std::vector<float> observations(static_cast<size_t>(opt.batch) * BATCH_OBSERVATION_SIZE);
+    std::vector<BatchAction> actions(opt.batch);
+    std::vector<float> rewards(opt.batch);
+    BatchSeekPolicy policy;
+    policy.dt = dt;
+
+    std::cout << "=== BATCHED HEADLESS SIMULATION ===" << std::endl;
+    std::cout << "Worlds: " << opt.batch << " (seeds " << seed << ".." << seed + opt.batch - 1 << "), ticks: " << ticks
+        << " at " << opt.tickRate << " Hz, workers: " << jobs.WorkerCount() << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for (long long t = 0; t < ticks; t++) {
+        if (seek) {
+            batch.Observe(observations.data());
+            policy(observations.data(), actions.data(), opt.batch);
+        }
+        batch.Step(actions.data(), dt, rewards.data());
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long totalScore = 0;
+    int bestScore = 0;
+    for (int w = 0; w < opt.batch; w++) {
+        totalScore += batch.Score(w);
+        bestScore = std::max(bestScore, batch.Score(w));
+    }
+
+    double worldTicks = static_cast<double>(ticks) * opt.batch;
+    std::cout << "World ticks: " << worldTicks << " in " << wallSeconds << " s wall time" << std::endl;
+    std::cout << "Throughput: " << (wallSeconds > 0.0 ? worldTicks / wallSeconds : 0.0) << " world ticks/s" << std::endl;
+    std::cout << "Mean score: " << static_cast<double>(totalScore) / opt.batch << ", best: " << bestScore << std::endl;
+    return 0;
+}
+
+inline int RunHeadless(const Options& opt) {
+    unsigned int seed = opt.seedSet ? opt.seed : 1u;
+    float dt = 1.0f / opt.tickRate;
+
+    long long ticks = opt.ticks;
+    if (opt.simSeconds > 0.0) ticks = static_cast<long long>(std::llround(opt.simSeconds * opt.tickRate));
+    if (ticks <= 0) ticks = static_cast<long long>(60.0f * opt.tickRate);
+
+    SimEventLogging() = opt.verbose;
+
+    if (opt.batch > 0) return RunBatchHeadless(opt, seed, ticks, dt);
+
+    InputScript script;
+    if (!opt.script.empty() && !script.Load(opt.script)) return -1;
+
+    SeekBot seekBot;
+    seekBot.dt = dt;
+
+    SimController controller;
+    if (opt.bot == "seek") {
+        controller = [&seekBot](const GameState& s, Camera& camera, SimInput& input) { seekBot(s, camera, input); };
+    }
+    else if (!opt.bot.empty() && opt.bot != "idle") {
+        std::cerr << "Unknown bot: " << opt.bot << std::endl;
+        return -1;
+    }
+    else if (!opt.script.empty()) {
+        controller = [&script](const GameState& s, Camera& camera, SimInput& input) { script.Apply(s.gameTime, camera, input); };
+    }
+
+    JobSystem jobs;
+    GameState state;
+    SceneDecor decor;
+    BuildScene(opt.scene, seed, state, decor);
+
+    std::cout << "=== HEADLESS SIMULATION ===" << std::endl;
+    PrintSceneSummary(opt.scene);
+    std::cout << "Seed: " << seed << ", ticks: " << ticks << " at " << opt.tickRate << " Hz ("
+        << ticks / opt.tickRate << " s of game time), workers: " << jobs.WorkerCount() << std::endl;
+
+    HeadlessStats stats = RunHeadlessSimulation(state, ticks, dt, controller, &jobs);
+    Logger::Get().Flush();
+
+    double tps = stats.wallSeconds > 0.0 ? stats.ticks / stats.wallSeconds : 0.0;
+    std::cout << "Ticks: " << stats.ticks << " in " << stats.wallSeconds << " s wall time" << std::endl;
+    std::cout << "Throughput: " << tps << " ticks/s, " << (stats.wallSeconds > 0.0 ? stats.simSeconds / stats.wallSeconds : 0.0)
+        << "x real time" << std::endl;
+    std::cout << "Final score: " << state.score << ", deliveries: " << state.deliveriesCompleted
+        << ", active packages: " << state.packages.size() << std::endl;
+    std::cout << "Airship position: (" << state.airshipPos.x << ", " << state.airshipPos.y << ", " << state.airshipPos.z << ")" << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEIGHTFIELD_SSE2 1
+#endif
+
+const int TERRAIN_GRID = 50;
+const float TERRAIN_SIZE = 5000.0f;
+const float TERRAIN_MAX_HEIGHT = 100.0f;
+
+// Bisection steps when a ray-march step has crossed the ground.
+const int GROUND_REFINE_STEPS = 6;
+
+// CPU copy of the terrain heights. generateTerrain builds the mesh from this
+// grid, so the simulation collides with exactly what is drawn.
+struct HeightField {
+    int width = 0;
+    int height = 0;
+    float originX = 0.0f;
+    float originZ = 0.0f;
+    float cellSize = 1.0f;
+    std::vector<float> heights;
+
+    float At(int x, int z) const { return heights[z * width + x]; }
+
+    // Height at a world position, clamped to the edge of the grid. Each cell
+    // is split along the same diagonal as the terrain mesh, from (x+1, z) to
+    // (x, z+1), and the height is interpolated on the triangle containing
+    // the point. Does exactly the same arithmetic as one lane of SampleBatch.
+    float Sample(float x, float z) const {
+        float invCell = 1.0f / cellSize;
+        float maxX = static_cast<float>(width - 1) - 0.001f;
+        float maxZ = static_cast<float>(height - 1) - 0.001f;
+
+        float gx = std::min(std::max((x - originX) * invCell, 0.0f), maxX);
+        float gz = std::min(std::max((z - originZ) * invCell, 0.0f), maxZ);
+        int ix = static_cast<int>(gx);
+        int iz = static_cast<int>(gz);
+        float fx = gx - static_cast<float>(ix);
+        float fz = gz - static_cast<float>(iz);
+
+        const float* row0 = &heights[iz * width + ix];
+        const float* row1 = row0 + width;
+        float h00 = row0[0], h10 = row0[1], h01 = row1[0], h11 = row1[1];
+        if (fx + fz <= 1.0f) return (h00 + (h10 - h00) * fx) + (h01 - h00) * fz;
+        return (h11 + (h01 - h11) * (1.0f - fx)) + (h10 - h11) * (1.0f - fz);
+    }
+
+    // Samples `count` points at once. Index and weight math runs four lanes
+    // wide; the corner loads are scalar since SSE2 has no gather.
+    void SampleBatch(const float* x, const float* z, float* out, int count) const {
+        int i = 0;
+#ifdef HEIGHTFIELD_SSE2
+        const __m128 invCell = _mm_set1_ps(1.0f / cellSize);
+        const __m128 origin4X = _mm_set1_ps(originX);
+        const __m128 origin4Z = _mm_set1_ps(originZ);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 maxX = _mm_set1_ps(static_cast<float>(width - 1) - 0.001f);
+        const __m128 maxZ = _mm_set1_ps(static_cast<float>(height - 1) - 0.001f);
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 gx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), origin4X), invCell), zero), maxX);
+            __m128 gz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(z + i), origin4Z), invCell), zero), maxZ);
+            __m128i ix = _mm_cvttps_epi32(gx);
+            __m128i iz = _mm_cvttps_epi32(gz);
+            __m128 fx = _mm_sub_ps(gx, _mm_cvtepi32_ps(ix));
+            __m128 fz = _mm_sub_ps(gz, _mm_cvtepi32_ps(iz));
+
+            alignas(16) int xs[4];
+            alignas(16) int zs[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(xs), ix);
+            _mm_store_si128(reinterpret_cast<__m128i*>(zs), iz);
+
+            alignas(16) float h00[4], h10[4], h01[4], h11[4];
+            for (int l = 0; l < 4; l++) {
+                const float* row0 = &heights[zs[l] * width + xs[l]];
+                const float* row1 = row0 + width;
+                h00[l] = row0[0];
+                h10[l] = row0[1];
+                h01[l] = row1[0];
+                h11[l] = row1[1];
+            }
+
+            __m128 a = _mm_load_ps(h00);
+            __m128 b = _mm_load_ps(h10);
+            __m128 c = _mm_load_ps(h01);
+            __m128 d = _mm_load_ps(h11);
+            __m128 lower = _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx)), _mm_mul_ps(_mm_sub_ps(c, a), fz));
+            __m128 upper = _mm_add_ps(_mm_add_ps(d, _mm_mul_ps(_mm_sub_ps(c, d), _mm_sub_ps(one, fx))),
+                _mm_mul_ps(_mm_sub_ps(b, d), _mm_sub_ps(one, fz)));
+            __m128 inLower = _mm_cmple_ps(_mm_add_ps(fx, fz), one);
+            _mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(inLower, lower), _mm_andnot_ps(inLower, upper)));
+        }
+#endif
+        for (; i < count; i++) {
+            out[i] = Sample(x[i], z[i]);
+        }
+    }
+
+    // Number of ray-march samples for a step covering (dx, dz): at least two
+    // per grid cell, so no bump between samples is missed.
+    int MarchSteps(float dx, float dz) const {
+        float length = std::sqrt(dx * dx + dz * dz);
+        return std::max(1, static_cast<int>(std::ceil(length / (cellSize * 0.5f))));
+    }
+
+    // The sphere is above the ground at fLo and touches it at fHi; narrows
+    // the contact down by bisection and returns the fraction of p0 -> p1.
+    float RefineGroundHit(const glm::vec3& p0, const glm::vec3& p1, float radius, float fLo, float fHi) const {
+        for (int i = 0; i < GROUND_REFINE_STEPS; i++) {
+            float f = (fLo + fHi) * 0.5f;
+            glm::vec3 p = p0 + (p1 - p0) * f;
+            if (p.y - radius <= Sample(p.x, p.z)) fHi = f;
+            else fLo = f;
+        }
+        return fHi;
+    }
+};
+
+inline void BuildTerrainHeightField(HeightField& field) {
+    field.width = TERRAIN_GRID;
+    field.height = TERRAIN_GRID;
+    field.originX = -0.5f * TERRAIN_SIZE;
+    field.originZ = -0.5f * TERRAIN_SIZE;
+    field.cellSize = TERRAIN_SIZE / static_cast<float>(TERRAIN_GRID);
+    field.heights.resize(field.width * field.height);
+
+    for (int z = 0; z < field.height; z++) {
+        for (int x = 0; x < field.width; x++) {
+            float nx = static_cast<float>(x) / static_cast<float>(field.width) * 4.0f;
+            float nz = static_cast<float>(z) / static_cast<float>(field.height) * 4.0f;
+            float h = 0.5f + 0.3f * sin(nx) * cos(nz);
+            field.heights[z * field.width + x] = h * TERRAIN_MAX_HEIGHT * 0.3f;
+        }
+    }
+}
+
+// Shared by the terrain mesh and the simulation.
+inline const HeightField& TerrainHeightField() {
+    static const HeightField field = []() {
+        HeightField f;
+        BuildTerrainHeightField(f);
+        return f;
+    }();
+    return field;
+}
+
+#endif
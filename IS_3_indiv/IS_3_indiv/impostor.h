@@ -0,0 +1,307 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "culling.h"
+#include "geometry.h"
+#include "jobsystem.h"
+#include "latency.h"
+#include "probes.h"
+#include "shaders.h"
+#include "shadows.h"
+
+// Views baked per atlas side, and the pixel size of each view.
+const int IMPOSTOR_GRID = 8;
+const int IMPOSTOR_FRAME_SIZE = 128;
+
+// Share of the switch distance, centred on it, over which mesh and impostor
+// are dithered into each other.
+const float IMPOSTOR_BAND = 0.2f;
+
+const int IMPOSTOR_GRAIN = 1024;
+
+// Direction for a point of the octahedral map, y up: the upper hemisphere
+// fills the inner diamond, the lower one is folded into the corners.
+inline glm::vec3 OctahedralDecode(float u, float v) {
+    float x = u * 2.0f - 1.0f;
+    float z = v * 2.0f - 1.0f;
+    float y = 1.0f - std::fabs(x) - std::fabs(z);
+    if (y < 0.0f) {
+        float fx = (1.0f - std::fabs(z)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fz = (1.0f - std::fabs(x)) * (z >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        z = fz;
+    }
+    return glm::normalize(glm::vec3(x, y, z));
+}
+
+// Distant trees drawn as one quad each. The tree mesh is rendered once from
+// IMPOSTOR_GRID^2 directions spread over an octahedral map into an atlas of
+// colour and of normal plus depth; a quad shows the view nearest to the
+// direction it is seen from, lit with the baked normals and pushed to the
+// baked depth. Trees nearer than the switch distance keep the mesh.
+class TreeImpostors {
+public:
+    // `distance` 0 keeps every tree a mesh.
+    bool Init(unsigned int meshVao, const std::vector<Vertex>& vertices, const glm::vec3& color, float distance) {
+        glGenBuffers(1, &nearVbo);
+        glGenBuffers(1, &farVbo);
+        if (vertices.empty()) return false;
+
+        glm::vec3 lo = vertices[0].position;
+        glm::vec3 hi = lo;
+        for (const Vertex& v : vertices) {
+            lo = glm::min(lo, v.position);
+            hi = glm::max(hi, v.position);
+        }
+        center = (lo + hi) * 0.5f;
+        radius = 0.0f;
+        for (const Vertex& v : vertices) radius = std::max(radius, glm::length(v.position - center));
+        if (distance <= 0.0f) return false;
+
+        unsigned int bakeProgram = CompileProgram(impostor_bake_vs_source, impostor_bake_fs_source);
+        program = CompileProgram(impostor_vs_source, impostor_fs_source);
+        if (bakeProgram == 0 || program == 0) return false;
+        if (!Bake(bakeProgram, meshVao, static_cast<int>(vertices.size()), color)) {
+            std::cerr << "Impostor atlas framebuffer is incomplete" << std::endl;
+            return false;
+        }
+        glDeleteProgram(bakeProgram);
+
+        glUseProgram(program);
+        unsigned int block = glGetUniformBlockIndex(program, "FrameUniforms");
+        if (block != GL_INVALID_INDEX) glUniformBlockBinding(program, block, FRAME_UNIFORM_BINDING);
+        glUniform1i(glGetUniformLocation(program, "albedo"), 0);
+        glUniform1i(glGetUniformLocation(program, "normalDepth"), 1);
+        glUniform3f(glGetUniformLocation(program, "center"), center.x, center.y, center.z);
+        glUniform1f(glGetUniformLocation(program, "radius"), radius);
+        glUniform1f(glGetUniformLocation(program, "grid"), static_cast<float>(IMPOSTOR_GRID));
+        cameraPosLoc = glGetUniformLocation(program, "cameraPos");
+        lightDirLoc = glGetUniformLocation(program, "lightDir");
+        overdrawLoc = glGetUniformLocation(program, "overdraw");
+        // The units the scene program reads them from; set even when unused,
+        // as for the scene program.
+        glUniform1i(glGetUniformLocation(program, "probes"), 3);
+        glUniform1i(glGetUniformLocation(program, "shadowMap"), SHADOW_TEXTURE_UNIT);
+        glUniform1fv(glGetUniformLocation(program, "cascadeFar"), SHADOW_CASCADES, SHADOW_SPLITS);
+        useShadowsLoc = glGetUniformLocation(program, "useShadows");
+        cascadeMatrixLoc = glGetUniformLocation(program, "cascadeMatrix");
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, farVbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), nullptr);
+        glVertexAttribDivisor(0, 1);
+        glBindVertexArray(0);
+
+        switchDistance = distance;
+        return true;
+    }
+
+    bool Initialized() const { return program != 0 && switchDistance > 0.0f; }
+
+    // Splits the trees inside `frustum` into meshes and impostors, with the
+    // share of each in xyz + w. Trees in the band go into both lists.
+    void Select(JobSystem& jobs, const std::vector<glm::vec3>& positions, const Frustum& frustum, const glm::vec3& cameraPos) {
+        int count = static_cast<int>(positions.size());
+        meshShare.resize(count);
+        float bandStart = switchDistance * (1.0f - IMPOSTOR_BAND * 0.5f);
+        float bandLength = switchDistance * IMPOSTOR_BAND;
+        bool impostors = Initialized();
+
+        jobs.ParallelFor(0, count, IMPOSTOR_GRAIN, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                glm::vec3 c = positions[i] + center;
+                if (!frustum.ContainsSphere(c, radius)) {
+                    meshShare[i] = -1.0f;
+                    continue;
+                }
+                float share = 1.0f;
+                if (impostors) {
+                    share = 1.0f - std::max(0.0f, std::min(1.0f, (glm::length(c - cameraPos) - bandStart) / bandLength));
+                }
+                meshShare[i] = share;
+            }
+        });
+
+        nearInstances.clear();
+        farInstances.clear();
+        for (int i = 0; i < count; i++) {
+            float share = meshShare[i];
+            if (share > 0.0f) nearInstances.push_back(glm::vec4(positions[i], share));
+            if (share >= 0.0f && share < 1.0f) farInstances.push_back(glm::vec4(positions[i], 1.0f - share));
+        }
+    }
+
+    int NearCount() const { return static_cast<int>(nearInstances.size()); }
+    int FarCount() const { return static_cast<int>(farInstances.size()); }
+
+    // Uploads this frame's mesh instances and points the instance position
+    // attribute of the tree mesh `meshVao` at them.
+    void BindNear(unsigned int meshVao) {
+        glBindVertexArray(meshVao);
+        Upload(nearVbo, nearInstances);
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), nullptr);
+        glVertexAttribDivisor(5, 1);
+    }
+
+    // Lights the impostors from the probe grid, as the tree meshes are.
+    // The grid's texture must be bound to unit 3 when they are drawn.
+    void UseProbes(const LightProbeGrid& probes) {
+        if (program == 0) return;
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "useProbes"), 1);
+        glUniform3fv(glGetUniformLocation(program, "probeOrigin"), 1, glm::value_ptr(probes.Origin()));
+        glUniform3fv(glGetUniformLocation(program, "probeSpacing"), 1, glm::value_ptr(probes.Spacing()));
+        glUniform3fv(glGetUniformLocation(program, "probeCount"), 1, glm::value_ptr(probes.Count()));
+    }
+
+    // Draws this frame's impostors, shadowed by `shadows` once its Bind()
+    // has run this frame. Leaves `sceneProgram` in use.
+    void Draw(const glm::vec3& cameraPos, const glm::vec3& lightDir, const ShadowCascades& shadows, bool overdraw,
+        unsigned int sceneProgram) {
+        if (farInstances.empty()) return;
+        glUseProgram(program);
+        glUniform3f(cameraPosLoc, cameraPos.x, cameraPos.y, cameraPos.z);
+        glUniform3f(lightDirLoc, lightDir.x, lightDir.y, lightDir.z);
+        glUniform1i(overdrawLoc, overdraw ? 1 : 0);
+        glUniform1i(useShadowsLoc, shadows.Initialized() ? 1 : 0);
+        if (shadows.Initialized()) {
+            glm::mat4 lookups[SHADOW_CASCADES];
+            shadows.Lookups(lookups);
+            glUniformMatrix4fv(cascadeMatrixLoc, SHADOW_CASCADES, GL_FALSE, glm::value_ptr(lookups[0]));
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedo);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normalDepth);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(vao);
+        Upload(farVbo, farInstances);
+        glDisable(GL_CULL_FACE);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, FarCount());
+        glEnable(GL_CULL_FACE);
+        glUseProgram(sceneProgram);
+    }
+
+private:
+    // Orphaned every frame so the upload never waits on the last draw.
+    void Upload(unsigned int vbo, const std::vector<glm::vec4>& instances) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+        if (!instances.empty()) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(glm::vec4), instances.data());
+        }
+    }
+
+    bool Bake(unsigned int bakeProgram, unsigned int meshVao, int vertexCount, const glm::vec3& color) {
+        int size = IMPOSTOR_GRID * IMPOSTOR_FRAME_SIZE;
+        albedo = CreateAtlasTexture(size);
+        normalDepth = CreateAtlasTexture(size);
+        unsigned int depth = 0;
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+
+        unsigned int fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepth, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        if (complete) {
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glClearBufferfv(GL_COLOR, 0, clear);
+            glClearBufferfv(GL_COLOR, 1, clear);
+            glDisable(GL_BLEND);
+
+            glUseProgram(bakeProgram);
+            int viewProjLoc = glGetUniformLocation(bakeProgram, "viewProj");
+            int viewDirLoc = glGetUniformLocation(bakeProgram, "viewDir");
+            glUniform3f(glGetUniformLocation(bakeProgram, "baseColor"), color.x, color.y, color.z);
+            glUniform3f(glGetUniformLocation(bakeProgram, "center"), center.x, center.y, center.z);
+            glUniform1f(glGetUniformLocation(bakeProgram, "radius"), radius);
+            glBindVertexArray(meshVao);
+
+            glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+            for (int fy = 0; fy < IMPOSTOR_GRID; fy++) {
+                for (int fx = 0; fx < IMPOSTOR_GRID; fx++) {
+                    glm::vec3 dir = OctahedralDecode((fx + 0.5f) / IMPOSTOR_GRID, (fy + 0.5f) / IMPOSTOR_GRID);
+                    glm::vec3 up = std::fabs(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    glm::mat4 viewProj = projection * glm::lookAt(center + dir * radius, center, up);
+
+                    glViewport(fx * IMPOSTOR_FRAME_SIZE, fy * IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                    glUniformMatrix4fv(viewProjLoc, 1, GL_FALSE, glm::value_ptr(viewProj));
+                    glUniform3f(viewDirLoc, dir.x, dir.y, dir.z);
+                    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+                }
+            }
+
+            glEnable(GL_BLEND);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            glBindTexture(GL_TEXTURE_2D, albedo);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, normalDepth);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &depth);
+        return complete;
+    }
+
+    // Mipmaps stop before a level's texels span several views.
+    unsigned int CreateAtlasTexture(int size) {
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+        return texture;
+    }
+
+    float switchDistance = 0.0f;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    unsigned int program = 0;
+    int cameraPosLoc = -1;
+    int lightDirLoc = -1;
+    int overdrawLoc = -1;
+    int useShadowsLoc = -1;
+    int cascadeMatrixLoc = -1;
+    unsigned int albedo = 0;
+    unsigned int normalDepth = 0;
+
+    std::vector<float> meshShare;
+    std::vector<glm::vec4> nearInstances;
+    std::vector<glm::vec4> farInstances;
+    unsigned int nearVbo = 0;
+    unsigned int farVbo = 0;
+    unsigned int vao = 0;
+};
+
+#endif
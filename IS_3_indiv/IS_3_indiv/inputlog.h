@@ -0,0 +1,200 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+const char INPUT_LOG_MAGIC[4] = { 'I', 'S', '3', 'I' };
+const unsigned int INPUT_LOG_VERSION = 1;
+
+// Keys that reach the game; bit i of InputFrame::keys is INPUT_LOG_KEYS[i].
+// Debug keys (F2, F3, F9, Escape) are left out so a replay can still use them.
+const int INPUT_LOG_KEYS[] = {
+    GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE, GLFW_KEY_LEFT_SHIFT,
+    GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT,
+    GLFW_KEY_C, GLFW_KEY_F, GLFW_KEY_ENTER, GLFW_KEY_M
+};
+const int INPUT_LOG_KEY_COUNT = sizeof(INPUT_LOG_KEYS) / sizeof(INPUT_LOG_KEYS[0]);
+
+enum InputFrameFlags {
+    INPUT_MOUSE_CAPTURED = 1,
+    INPUT_HAS_MOUSE = 2
+};
+
+// Everything main() reads from the window in one frame.
+struct InputFrame {
+    float dt = 0.0f;
+    unsigned short keys = 0;
+    bool mouseCaptured = false;
+    float mouseX = 0.0f;
+    float mouseY = 0.0f;
+
+    bool Held(int key) const {
+        for (int i = 0; i < INPUT_LOG_KEY_COUNT; i++) {
+            if (INPUT_LOG_KEYS[i] == key) return (keys >> i) & 1;
+        }
+        return false;
+    }
+};
+
+inline unsigned short PollInputKeys(GLFWwindow* window) {
+    unsigned short keys = 0;
+    for (int i = 0; i < INPUT_LOG_KEY_COUNT; i++) {
+        if (glfwGetKey(window, INPUT_LOG_KEYS[i]) == GLFW_PRESS) keys |= static_cast<unsigned short>(1 << i);
+    }
+    return keys;
+}
+
+// What a replay needs besides the frames to rebuild the same world.
+struct InputLogHeader {
+    unsigned int seed = 0;
+    float tickRate = 120.0f;
+    SceneConfig scene;
+};
+
+// File layout, native byte order: magic, version, header fields, then one
+// record per frame: dt (float), keys (uint16), flags (uint8) and, only when
+// the mouse moved, x and y offsets (float each). Most frames take 7 bytes.
+class InputRecorder {
+public:
+    bool Open(const std::string& path, const InputLogHeader& header) {
+        out.open(path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Failed to open input log for writing: " << path << std::endl;
+            return false;
+        }
+        out.write(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC));
+        Put(INPUT_LOG_VERSION);
+        Put(header.seed);
+        Put(header.tickRate);
+        Put(header.scene.layout);
+        Put(header.scene.houses);
+        Put(header.scene.trees);
+        Put(header.scene.lanterns);
+        Put(header.scene.sleds);
+        Put(header.scene.autofire);
+        return true;
+    }
+
+    bool Active() const { return out.is_open(); }
+
+    void Write(const InputFrame& frame) {
+        bool mouse = frame.mouseX != 0.0f || frame.mouseY != 0.0f;
+        unsigned char flags = (frame.mouseCaptured ? INPUT_MOUSE_CAPTURED : 0) | (mouse ? INPUT_HAS_MOUSE : 0);
+        Put(frame.dt);
+        Put(frame.keys);
+        Put(flags);
+        if (mouse) {
+            Put(frame.mouseX);
+            Put(frame.mouseY);
+        }
+        frames++;
+    }
+
+    void Close() {
+        if (!out.is_open()) return;
+        out.close();
+        std::cout << "Recorded " << frames << " input frames" << std::endl;
+    }
+
+private:
+    template <typename T>
+    void Put(const T& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+    std::ofstream out;
+    int frames = 0;
+};
+
+// Loads a whole log up front so playback never touches the disk.
+class InputReplay {
+public:
+    bool Load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Failed to open input log: " << path << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+        char magic[4] = {};
+        unsigned int version = 0;
+        if (!Get(magic) || std::memcmp(magic, INPUT_LOG_MAGIC, sizeof(magic)) != 0 || !Get(version)) {
+            std::cerr << "Not an input log: " << path << std::endl;
+            return false;
+        }
+        if (version != INPUT_LOG_VERSION) {
+            std::cerr << "Unsupported input log version " << version << ": " << path << std::endl;
+            return false;
+        }
+
+        bool ok = Get(header.seed) && Get(header.tickRate) && Get(header.scene.layout) && Get(header.scene.houses)
+            && Get(header.scene.trees) && Get(header.scene.lanterns) && Get(header.scene.sleds) && Get(header.scene.autofire);
+        if (!ok) {
+            std::cerr << "Truncated input log header: " << path << std::endl;
+            return false;
+        }
+
+        InputFrame frame;
+        while (Read(frame)) {
+            frames.push_back(frame);
+            totalSeconds += frame.dt;
+        }
+        std::cout << "Loaded " << frames.size() << " input frames (" << totalSeconds << " s) from " << path << std::endl;
+        data.clear();
+        data.shrink_to_fit();
+        loaded = true;
+        return true;
+    }
+
+    bool Active() const { return loaded; }
+    const InputLogHeader& Header() const { return header; }
+    int Frames() const { return static_cast<int>(frames.size()); }
+
+    // Recorded time of the frames handed out so far.
+    double Seconds() const { return elapsedSeconds; }
+
+    bool Next(InputFrame& frame) {
+        if (next >= frames.size()) return false;
+        frame = frames[next++];
+        elapsedSeconds += frame.dt;
+        return true;
+    }
+
+private:
+    template <typename T>
+    bool Get(T& value) {
+        if (cursor + sizeof(T) > data.size()) return false;
+        std::memcpy(&value, data.data() + cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+
+    // A record cut short by a crash while recording ends the log.
+    bool Read(InputFrame& frame) {
+        unsigned char flags = 0;
+        if (!Get(frame.dt) || !Get(frame.keys) || !Get(flags)) return false;
+        frame.mouseCaptured = (flags & INPUT_MOUSE_CAPTURED) != 0;
+        frame.mouseX = frame.mouseY = 0.0f;
+        if (flags & INPUT_HAS_MOUSE) return Get(frame.mouseX) && Get(frame.mouseY);
+        return true;
+    }
+
+    std::vector<char> data;
+    size_t cursor = 0;
+
+    InputLogHeader header;
+    std::vector<InputFrame> frames;
+    size_t next = 0;
+    double totalSeconds = 0.0;
+    double elapsedSeconds = 0.0;
+    bool loaded = false;
+};
+
+#endif
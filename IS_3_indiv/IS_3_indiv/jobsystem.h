@@ -0,0 +1,293 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "profiler.h"
+
+struct Task;
+typedef std::shared_ptr<Task> TaskRef;
+
+struct Task {
+    std::function<void()> fn;
+
+    // Starts at 1 so a task never runs before Submit, even if all of its
+    // dependencies have already finished.
+    std::atomic<int> pendingDependencies{ 1 };
+    std::atomic<bool> finished{ false };
+
+    std::mutex continuationMutex;
+    std::vector<TaskRef> continuations;
+};
+
+// Work-stealing scheduler. Every worker owns a deque: it pushes and pops its
+// own work at the back and steals from the front of other workers' deques.
+// The thread that constructs the JobSystem becomes worker 0 and executes
+// tasks whenever it waits. Other threads may submit and wait as well; their
+// work is spread over the workers round-robin.
+class JobSystem {
+public:
+    explicit JobSystem(int threadCount = 0) {
+        if (threadCount <= 0) {
+            threadCount = static_cast<int>(std::thread::hardware_concurrency());
+        }
+        threadCount = std::max(1, threadCount);
+
+        queues.resize(threadCount);
+        for (auto& q : queues) q.reset(new WorkQueue());
+
+        CurrentWorker() = 0;
+        CurrentSystem() = this;
+
+        for (int i = 1; i < threadCount; i++) {
+            threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        sleepCondition.notify_all();
+        for (auto& t : threads) t.join();
+
+        if (CurrentSystem() == this) {
+            CurrentSystem() = nullptr;
+            CurrentWorker() = -1;
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    int WorkerCount() const { return static_cast<int>(queues.size()); }
+
+    // Index of the calling worker, or -1 for threads outside this system.
+    int ThisWorkerIndex() const { return LocalIndex(); }
+
+    TaskRef Create(std::function<void()> fn) {
+        TaskRef task = std::make_shared<Task>();
+        task->fn = std::move(fn);
+        return task;
+    }
+
+    // `task` will not start before `dependency` has finished.
+    void AddDependency(const TaskRef& task, const TaskRef& dependency) {
+        std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+        if (dependency->finished.load(std::memory_order_acquire)) return;
+        task->pendingDependencies.fetch_add(1, std::memory_order_relaxed);
+        dependency->continuations.push_back(task);
+    }
+
+    void Submit(const TaskRef& task) {
+        Release(task);
+    }
+
+    TaskRef Run(std::function<void()> fn) {
+        TaskRef task = Create(std::move(fn));
+        Submit(task);
+        return task;
+    }
+
+    // Schedules `fn` to run once `task` has finished.
+    TaskRef Then(const TaskRef& task, std::function<void()> fn) {
+        TaskRef next = Create(std::move(fn));
+        AddDependency(next, task);
+        Submit(next);
+        return next;
+    }
+
+    // Blocks until `task` has finished, executing other work meanwhile.
+    void Wait(const TaskRef& task) {
+        while (!task->finished.load(std::memory_order_acquire)) {
+            if (!RunOne()) std::this_thread::yield();
+        }
+    }
+
+    // Calls body(begin, end) over consecutive sub-ranges of [begin, end) in
+    // parallel and returns when all of them have completed.
+    void ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+        if (end <= begin) return;
+        grain = std::max(1, grain);
+
+        int count = end - begin;
+        if (count <= grain || queues.size() == 1) {
+            body(begin, end);
+            return;
+        }
+
+        int chunks = (count + grain - 1) / grain;
+        std::atomic<int> remaining{ chunks - 1 };
+
+        for (int c = 1; c < chunks; c++) {
+            int chunkBegin = begin + c * grain;
+            int chunkEnd = std::min(end, chunkBegin + grain);
+            Run([&body, &remaining, chunkBegin, chunkEnd]() {
+                body(chunkBegin, chunkEnd);
+                remaining.fetch_sub(1, std::memory_order_acq_rel);
+            });
+        }
+
+        body(begin, std::min(end, begin + grain));
+
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!RunOne()) std::this_thread::yield();
+        }
+    }
+
+    unsigned long long TasksExecuted() const { return tasksExecuted.load(std::memory_order_relaxed); }
+    unsigned long long TasksStolen() const { return tasksStolen.load(std::memory_order_relaxed); }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<TaskRef> tasks;
+    };
+
+    static int& CurrentWorker() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    static JobSystem*& CurrentSystem() {
+        thread_local JobSystem* system = nullptr;
+        return system;
+    }
+
+    int LocalIndex() const {
+        return CurrentSystem() == this ? CurrentWorker() : -1;
+    }
+
+    void Release(const TaskRef& task) {
+        if (task->pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Enqueue(task);
+        }
+    }
+
+    void Enqueue(const TaskRef& task) {
+        int index = LocalIndex();
+        if (index < 0) {
+            index = static_cast<int>(nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(task);
+        }
+        queuedTasks.fetch_add(1, std::memory_order_release);
+
+        if (sleepingWorkers.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCondition.notify_one();
+        }
+    }
+
+    TaskRef Pop(int index) {
+        WorkQueue& q = *queues[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return nullptr;
+        TaskRef task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return task;
+    }
+
+    TaskRef Steal(int thief) {
+        int n = static_cast<int>(queues.size());
+        int start = static_cast<int>(stealSeed.fetch_add(1, std::memory_order_relaxed) % n);
+        for (int i = 0; i < n; i++) {
+            int victim = (start + i) % n;
+            if (victim == thief) continue;
+
+            WorkQueue& q = *queues[victim];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            TaskRef task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            tasksStolen.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+        return nullptr;
+    }
+
+    bool RunOne() {
+        if (queuedTasks.load(std::memory_order_acquire) == 0) return false;
+
+        int index = LocalIndex();
+        TaskRef task = index >= 0 ? Pop(index) : nullptr;
+        if (!task) task = Steal(index);
+        if (!task) return false;
+
+        queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+        Execute(task);
+        return true;
+    }
+
+    void Execute(const TaskRef& task) {
+        if (task->fn) {
+            PROFILE_SCOPE("Task");
+            task->fn();
+        }
+        tasksExecuted.fetch_add(1, std::memory_order_relaxed);
+
+        std::vector<TaskRef> next;
+        {
+            std::lock_guard<std::mutex> lock(task->continuationMutex);
+            task->finished.store(true, std::memory_order_release);
+            next.swap(task->continuations);
+        }
+        for (auto& c : next) Release(c);
+    }
+
+    void WorkerLoop(int index) {
+        PROFILE_THREAD("Job worker");
+        CurrentWorker() = index;
+        CurrentSystem() = this;
+
+        int idleSpins = 0;
+        while (running.load(std::memory_order_acquire)) {
+            if (RunOne()) {
+                idleSpins = 0;
+                continue;
+            }
+
+            if (++idleSpins < 64) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1, std::memory_order_acq_rel);
+            sleepCondition.wait_for(lock, std::chrono::milliseconds(2), [this]() {
+                return !running.load(std::memory_order_acquire) || queuedTasks.load(std::memory_order_acquire) > 0;
+            });
+            sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+            idleSpins = 0;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::atomic<bool> running{ true };
+    std::atomic<int> queuedTasks{ 0 };
+    std::atomic<int> sleepingWorkers{ 0 };
+    std::atomic<unsigned int> nextQueue{ 0 };
+    std::atomic<unsigned int> stealSeed{ 0 };
+    std::atomic<unsigned long long> tasksExecuted{ 0 };
+    std::atomic<unsigned long long> tasksStolen{ 0 };
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+};
+
+#endif
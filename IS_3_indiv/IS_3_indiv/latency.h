@@ -0,0 +1,199 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+#include "benchmarks.h"
+#include "framebench.h"
+#include "profiler.h"
+
+// Uniform block binding of the per-frame camera block in the scene shader.
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+const int FRAME_UNIFORM_RING = 64;
+
+// Extra field of view for culling, so a view that turns a little between
+// culling and the late latch still finds everything it can see.
+const float LATE_LATCH_CULL_MARGIN_DEGREES = 10.0f;
+
+// Frames whose completion is tracked; also the largest frame queue limit.
+const int LATENCY_FENCE_RING = 8;
+
+enum InputEventKind {
+    INPUT_EVENT_KEY,
+    INPUT_EVENT_MOUSE,
+    INPUT_EVENT_KINDS
+};
+
+// std140 layout of the FrameUniforms block.
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+// Per-frame camera block, written once the view is final. Each frame gets
+// its own slot so no write waits for a draw still reading an older one; the
+// storage is orphaned when the ring wraps.
+class FrameUniformBuffer {
+public:
+    void Init(unsigned int program) {
+        int alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (static_cast<int>(sizeof(FrameUniforms)) + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, stride * FRAME_UNIFORM_RING, nullptr, GL_STREAM_DRAW);
+
+        unsigned int block = glGetUniformBlockIndex(program, "FrameUniforms");
+        if (block == GL_INVALID_INDEX) std::cerr << "Warning: FrameUniforms block not found" << std::endl;
+        else glUniformBlockBinding(program, block, FRAME_UNIFORM_BINDING);
+    }
+
+    void Write(const glm::mat4& view, const glm::mat4& projection) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        if (slot == FRAME_UNIFORM_RING) {
+            glBufferData(GL_UNIFORM_BUFFER, stride * FRAME_UNIFORM_RING, nullptr, GL_STREAM_DRAW);
+            slot = 0;
+        }
+
+        FrameUniforms uniforms = { view, projection };
+        void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, slot * stride, sizeof(FrameUniforms),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst != nullptr) {
+            std::memcpy(dst, &uniforms, sizeof(uniforms));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, ubo, slot * stride, sizeof(FrameUniforms));
+        slot++;
+    }
+
+private:
+    unsigned int ubo = 0;
+    int stride = 0;
+    int slot = 0;
+};
+
+// Input-to-photon latency, measured up to the GPU finishing the frame that
+// first shows an input; scan-out is not visible to GL and is not included.
+// Events are timestamped when GLFW delivers them, which is as early as the
+// program can see them. A fence after every swap tells when that frame is
+// done, and a GL_TIMESTAMP query beside it when exactly, mapped to the CPU
+// clock, so the time until the fence is polled does not count. With a queue
+// limit the same fences keep the CPU at most that many frames ahead of the
+// GPU.
+class FrameLatency {
+public:
+    void Init(int maxFramesInFlight) {
+        queueLimit = std::min(maxFramesInFlight, LATENCY_FENCE_RING);
+    }
+
+    // From GLFW callbacks. Only the oldest event waiting for a frame
+    // matters: it has the longest way to the screen.
+    void OnInput(int kind) {
+        if (pending[kind] < 0.0) pending[kind] = BenchSeconds();
+    }
+
+    // The frame being built now reads the input of `kind` that arrived so far.
+    void Latch(int kind) {
+        if (pending[kind] < 0.0) return;
+        if (latched[kind] < 0.0 || pending[kind] < latched[kind]) latched[kind] = pending[kind];
+        pending[kind] = -1.0;
+    }
+
+    // Right after SwapBuffers.
+    void EndFrame() {
+        Harvest(false);
+
+        // GPU clock to CPU clock, re-read every frame so the two cannot drift.
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuToCpu = BenchSeconds() - gpuNow * 1.0e-9;
+
+        InFlight frame;
+        if (spareQueries.empty()) {
+            unsigned int query = 0;
+            glGenQueries(1, &query);
+            spareQueries.push_back(query);
+        }
+        frame.query = spareQueries.back();
+        spareQueries.pop_back();
+        glQueryCounter(frame.query, GL_TIMESTAMP);
+        frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        for (int k = 0; k < INPUT_EVENT_KINDS; k++) {
+            frame.input[k] = latched[k];
+            latched[k] = -1.0;
+        }
+        inFlight.push_back(frame);
+
+        if (queueLimit > 0 && static_cast<int>(inFlight.size()) > queueLimit) {
+            PROFILE_SCOPE("Frame queue wait");
+            while (static_cast<int>(inFlight.size()) > queueLimit) Retire(true);
+        }
+        while (static_cast<int>(inFlight.size()) > LATENCY_FENCE_RING) Retire(true);
+    }
+
+    void Finish() {
+        Harvest(true);
+    }
+
+    void PrintReport() const {
+        for (int k = 0; k < INPUT_EVENT_KINDS; k++) {
+            if (samples[k].empty()) continue;
+            SampleSummary s = Summarize(samples[k]);
+            std::cout << "Input latency (" << (k == INPUT_EVENT_KEY ? "keys" : "mouse") << ", to GPU completion): "
+                << samples[k].size() << " frames, mean " << s.mean << " ms, p50 " << s.p50 << " ms, p95 " << s.p95
+                << " ms, p99 " << s.p99 << " ms, max " << s.max << " ms" << std::endl;
+        }
+        if (queueLimit > 0) std::cout << "Frame queue limit: " << queueLimit << " frames in flight" << std::endl;
+    }
+
+private:
+    struct InFlight {
+        GLsync fence = nullptr;
+        unsigned int query = 0;
+        double input[INPUT_EVENT_KINDS] = { -1.0, -1.0 };
+    };
+
+    // Retires finished frames from the front; with `wait`, all of them.
+    void Harvest(bool wait) {
+        while (!inFlight.empty() && Retire(wait)) {}
+    }
+
+    bool Retire(bool wait) {
+        InFlight& frame = inFlight.front();
+        GLenum status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ULL : 0);
+        if (status == GL_TIMEOUT_EXPIRED) return false;
+
+        // The timestamp was written before the fence signalled.
+        GLuint64 gpuDone = 0;
+        glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpuDone);
+        spareQueries.push_back(frame.query);
+        double done = std::min(BenchSeconds(), gpuToCpu + gpuDone * 1.0e-9);
+        for (int k = 0; k < INPUT_EVENT_KINDS; k++) {
+            if (frame.input[k] >= 0.0) {
+                samples[k].push_back((done - frame.input[k]) * 1000.0);
+                PROFILE_COUNTER(k == INPUT_EVENT_KEY ? "Key latency ms" : "Mouse latency ms", samples[k].back());
+            }
+        }
+        glDeleteSync(frame.fence);
+        inFlight.pop_front();
+        return true;
+    }
+
+    int queueLimit = 0;
+    double pending[INPUT_EVENT_KINDS] = { -1.0, -1.0 };
+    double latched[INPUT_EVENT_KINDS] = { -1.0, -1.0 };
+    std::deque<InFlight> inFlight;
+    std::vector<unsigned int> spareQueries;
+    double gpuToCpu = 0.0;
+    std::vector<double> samples[INPUT_EVENT_KINDS];
+};
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "geometry.h"
+#include "heightfield.h"
+#include "jobsystem.h"
+#include "profiler.h"
+#include "simulation.h"
+
+const char LIGHTMAP_MAGIC[4] = { 'I', 'S', '3', 'L' };
+const unsigned int LIGHTMAP_VERSION = 2;
+
+// Atlas layout: the terrain's map in the lower left corner, house tiles in
+// the rest, row by row. Houses past the last tile are lit dynamically.
+const int LIGHTMAP_SIZE = 1024;
+const int LIGHTMAP_TERRAIN_SIZE = 512;
+const int LIGHTMAP_TILE = 32;
+const int LIGHTMAP_TILES_PER_ROW = LIGHTMAP_SIZE / LIGHTMAP_TILE;
+const int LIGHTMAP_TERRAIN_TILES = LIGHTMAP_TERRAIN_SIZE / LIGHTMAP_TILE;
+const int LIGHTMAP_HOUSE_TILES = LIGHTMAP_TILES_PER_ROW * LIGHTMAP_TILES_PER_ROW
+    - LIGHTMAP_TERRAIN_TILES * LIGHTMAP_TERRAIN_TILES;
+
+// Sky visibility rays per texel and how far they look for occluders.
+const int LIGHTMAP_SKY_RAYS = 16;
+const float LIGHTMAP_SKY_DISTANCE = 200.0f;
+// Ray origins are pushed off the surface by this much.
+const float LIGHTMAP_RAY_BIAS = 0.5f;
+// Lanterns adding less than this to a texel are skipped with their rays.
+const float LIGHTMAP_MIN_CONTRIBUTION = 0.02f;
+// Baked values are stored as value * scale in 16 bits.
+const float LIGHTMAP_QUANTIZE = 4096.0f;
+const int LIGHTMAP_DILATE_STEPS = 2;
+const int LIGHTMAP_ROW_GRAIN = 8;
+
+// Terms of the static lights, the same ones fs_source evaluates per pixel.
+// The sun is not one of them: the shaders add it with its cascaded shadows.
+const glm::vec3 LIGHT_AMBIENT(0.3f, 0.3f, 0.4f);
+const glm::vec3 LANTERN_LIGHT_COLOR(1.0f, 0.85f, 0.6f);
+const float LANTERN_LIGHT_HEIGHT = 60.0f;
+const float LANTERN_LIGHT_STRENGTH = 3.0f;
+
+inline float LanternAttenuation(float dist) {
+    return 1.0f / (1.0f + 0.0006f * dist + 0.00002f * dist * dist);
+}
+
+// Distance past which a lantern adds less than LIGHTMAP_MIN_CONTRIBUTION
+// even to a surface facing it.
+inline float LanternReach() {
+    float c = 1.0f - LANTERN_LIGHT_STRENGTH / LIGHTMAP_MIN_CONTRIBUTION;
+    return (-0.0006f + std::sqrt(0.0006f * 0.0006f - 4.0f * 0.00002f * c)) / (2.0f * 0.00002f);
+}
+
+// Lights and occluders that never change while the game runs.
+struct StaticLights {
+    std::vector<glm::vec3> lanterns;
+    TriangleBvh occluders;
+};
+
+// Shadow casters are the terrain and the houses; the lanterns' posts are too
+// thin to matter and everything else moves.
+inline void BuildStaticLights(const std::vector<glm::vec3>& lanterns, const std::vector<glm::vec3>& houses,
+    StaticLights& lights) {
+    PROFILE_SCOPE("Build static lights");
+    lights.lanterns = lanterns;
+
+    std::vector<Vertex> terrainMesh, houseMesh;
+    BuildTerrainMesh(TerrainHeightField(), terrainMesh);
+    generateHouse(houseMesh);
+    std::vector<glm::vec3> corners;
+    corners.reserve(terrainMesh.size() + houseMesh.size() * houses.size());
+    for (const auto& v : terrainMesh) corners.push_back(v.position);
+    for (const auto& house : houses) {
+        for (const auto& v : houseMesh) corners.push_back(house + v.position * HOUSE_SCALE);
+    }
+    lights.occluders.Build(corners);
+}
+
+// Light reaching `p` on a surface facing `n`: sky light scaled by how much of
+// the sky is open and every lantern in reach with a shadow ray. `seed` rotates the sky ray pattern so
+// neighbouring texels trade banding for noise.
+inline glm::vec3 EvaluateStaticLight(const StaticLights& lights, const glm::vec3& p, const glm::vec3& n, unsigned int seed) {
+    glm::vec3 origin = p + n * LIGHTMAP_RAY_BIAS;
+
+    glm::vec3 t = std::fabs(n.y) < 0.9f ? glm::normalize(glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), n))
+                                       : glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), n));
+    glm::vec3 b = glm::cross(n, t);
+    float rotation = static_cast<float>((seed * 2654435761u) >> 8) / 16777216.0f;
+
+    int open = 0;
+    for (int i = 0; i < LIGHTMAP_SKY_RAYS; i++) {
+        // Cosine-weighted Hammersley points.
+        float u = (static_cast<float>(i) + 0.5f) / static_cast<float>(LIGHTMAP_SKY_RAYS);
+        unsigned int bits = static_cast<unsigned int>(i);
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        float v = std::fmod(static_cast<float>(bits) / 4294967296.0f + rotation, 1.0f);
+        float r = std::sqrt(u);
+        float phi = 2.0f * M_PI * v;
+        glm::vec3 dir = t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - u));
+        if (!lights.occluders.Occluded(origin, dir, LIGHTMAP_SKY_DISTANCE)) open++;
+    }
+    glm::vec3 light = LIGHT_AMBIENT * (static_cast<float>(open) / static_cast<float>(LIGHTMAP_SKY_RAYS));
+
+    for (const auto& lantern : lights.lanterns) {
+        glm::vec3 toLight = lantern + glm::vec3(0.0f, LANTERN_LIGHT_HEIGHT, 0.0f) - p;
+        float dist = glm::length(toLight);
+        if (dist <= LIGHTMAP_RAY_BIAS) continue;
+        glm::vec3 dir = toLight / dist;
+        float strength = std::max(glm::dot(n, dir), 0.0f) * LanternAttenuation(dist) * LANTERN_LIGHT_STRENGTH;
+        if (strength < LIGHTMAP_MIN_CONTRIBUTION) continue;
+        if (lights.occluders.Occluded(origin, dir, dist - LIGHTMAP_RAY_BIAS)) continue;
+        light += LANTERN_LIGHT_COLOR * strength;
+    }
+    return light;
+}
+
+// Baked light of the terrain and the houses in one RGB16F atlas, bound to
+// texture unit 2. Bakes take seconds, so each result is cached on disk under
+// a hash of everything it depends on and reused by the next run with the
+// same world.
+class StaticLightmaps {
+public:
+    // `houses` are the ones `lights` was built with.
+    bool Build(JobSystem& jobs, const StaticLights& lights, const std::vector<glm::vec3>& houses) {
+        housePositions = houses;
+        houseTiles = std::min(static_cast<int>(houses.size()), LIGHTMAP_HOUSE_TILES);
+
+        std::string path = CachePath(lights.lanterns);
+        if (!Load(path)) {
+            auto start = std::chrono::steady_clock::now();
+            Bake(jobs, lights);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Baked lightmaps in " << seconds << " s" << std::endl;
+            Save(path);
+        }
+        else {
+            std::cout << "Loaded lightmaps from " << path << std::endl;
+        }
+
+        std::vector<float> texels(texels16.size());
+        for (size_t i = 0; i < texels16.size(); i++) {
+            texels[i] = static_cast<float>(texels16[i]) / LIGHTMAP_QUANTIZE;
+        }
+        texels16.clear();
+        texels16.shrink_to_fit();
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, LIGHTMAP_SIZE, LIGHTMAP_SIZE, 0, GL_RGB, GL_FLOAT, texels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return true;
+    }
+
+    bool Initialized() const { return texture != 0; }
+    unsigned int Texture() const { return texture; }
+
+    // Where a mesh's lightmap coordinates land in the atlas: offset in xy,
+    // size in zw. Zero when the mesh has no baked light.
+    glm::vec4 TerrainRect() const {
+        if (!Initialized()) return glm::vec4(0.0f);
+        float size = static_cast<float>(LIGHTMAP_TERRAIN_SIZE) / static_cast<float>(LIGHTMAP_SIZE);
+        return glm::vec4(0.0f, 0.0f, size, size);
+    }
+
+    glm::vec4 HouseRect(int house) const {
+        if (!Initialized() || house >= houseTiles) return glm::vec4(0.0f);
+        int x, y;
+        TileOrigin(house, x, y);
+        float inv = 1.0f / static_cast<float>(LIGHTMAP_SIZE);
+        float size = static_cast<float>(LIGHTMAP_TILE) * inv;
+        return glm::vec4(static_cast<float>(x) * inv, static_cast<float>(y) * inv, size, size);
+    }
+
+private:
+    // Texel origin of house tile `index`, skipping the terrain's corner.
+    static void TileOrigin(int index, int& x, int& y) {
+        int besideTerrain = LIGHTMAP_TERRAIN_TILES * (LIGHTMAP_TILES_PER_ROW - LIGHTMAP_TERRAIN_TILES);
+        int column, row;
+        if (index < besideTerrain) {
+            int width = LIGHTMAP_TILES_PER_ROW - LIGHTMAP_TERRAIN_TILES;
+            column = LIGHTMAP_TERRAIN_TILES + index % width;
+            row = index / width;
+        }
+        else {
+            index -= besideTerrain;
+            column = index % LIGHTMAP_TILES_PER_ROW;
+            row = LIGHTMAP_TERRAIN_TILES + index / LIGHTMAP_TILES_PER_ROW;
+        }
+        x = column * LIGHTMAP_TILE;
+        y = row * LIGHTMAP_TILE;
+    }
+
+    void Bake(JobSystem& jobs, const StaticLights& lights) {
+        PROFILE_SCOPE("Bake lightmaps");
+        const HeightField& field = TerrainHeightField();
+        std::vector<Vertex> houseMesh;
+        generateHouse(houseMesh);
+
+        std::vector<glm::vec3> texels(static_cast<size_t>(LIGHTMAP_SIZE) * LIGHTMAP_SIZE, glm::vec3(0.0f));
+        std::vector<char> covered(texels.size(), 0);
+
+        // Terrain: texel centers back to world space through the planar
+        // mapping, on the ground the mesh draws. The mesh's normals all face
+        // up, so the bake uses that too.
+        const glm::vec3 up(0.0f, 1.0f, 0.0f);
+        jobs.ParallelFor(0, LIGHTMAP_TERRAIN_SIZE, LIGHTMAP_ROW_GRAIN, [&](int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                for (int x = 0; x < LIGHTMAP_TERRAIN_SIZE; x++) {
+                    float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(LIGHTMAP_TERRAIN_SIZE);
+                    float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(LIGHTMAP_TERRAIN_SIZE);
+                    glm::vec3 p((u - 0.5f) * TERRAIN_SIZE, 0.0f, (v - 0.5f) * TERRAIN_SIZE);
+                    p.y = field.Sample(p.x, p.z);
+                    size_t index = static_cast<size_t>(y) * LIGHTMAP_SIZE + x;
+                    texels[index] = EvaluateStaticLight(lights, p, up, static_cast<unsigned int>(index));
+                    covered[index] = 1;
+                }
+            }
+        });
+
+        // Houses: every house shares the mesh and only moves, so which
+        // triangle covers each tile texel is worked out once.
+        struct TexelSample {
+            glm::vec3 position;
+            glm::vec3 normal;
+            int texel;
+        };
+        std::vector<TexelSample> samples;
+        for (int ty = 0; ty < LIGHTMAP_TILE; ty++) {
+            for (int tx = 0; tx < LIGHTMAP_TILE; tx++) {
+                glm::vec2 uv((static_cast<float>(tx) + 0.5f) / static_cast<float>(LIGHTMAP_TILE),
+                    (static_cast<float>(ty) + 0.5f) / static_cast<float>(LIGHTMAP_TILE));
+                for (size_t i = 0; i + 2 < houseMesh.size(); i += 3) {
+                    glm::vec3 w;
+                    if (!Barycentric(uv, houseMesh[i].lightmapUv, houseMesh[i + 1].lightmapUv, houseMesh[i + 2].lightmapUv, w)) continue;
+                    glm::vec3 p = houseMesh[i].position * w.x + houseMesh[i + 1].position * w.y + houseMesh[i + 2].position * w.z;
+                    samples.push_back({ p * HOUSE_SCALE, houseMesh[i].normal, ty * LIGHTMAP_SIZE + tx });
+                    break;
+                }
+            }
+        }
+
+        jobs.ParallelFor(0, houseTiles, 1, [&](int begin, int end) {
+            for (int h = begin; h < end; h++) {
+                int ox, oy;
+                TileOrigin(h, ox, oy);
+                size_t base = static_cast<size_t>(oy) * LIGHTMAP_SIZE + ox;
+                for (const auto& s : samples) {
+                    size_t index = base + s.texel;
+                    texels[index] = EvaluateStaticLight(lights, housePositions[h] + s.position, s.normal,
+                        static_cast<unsigned int>(index));
+                    covered[index] = 1;
+                }
+            }
+        });
+
+        // Texels no triangle covers take the average of covered neighbours,
+        // so bilinear lookups along triangle edges do not pull in black.
+        for (int step = 0; step < LIGHTMAP_DILATE_STEPS; step++) {
+            std::vector<char> next = covered;
+            jobs.ParallelFor(0, LIGHTMAP_SIZE, LIGHTMAP_ROW_GRAIN, [&](int begin, int end) {
+                for (int y = begin; y < end; y++) {
+                    for (int x = 0; x < LIGHTMAP_SIZE; x++) {
+                        size_t index = static_cast<size_t>(y) * LIGHTMAP_SIZE + x;
+                        if (covered[index]) continue;
+                        glm::vec3 sum(0.0f);
+                        int count = 0;
+                        for (int dy = -1; dy <= 1; dy++) {
+                            for (int dx = -1; dx <= 1; dx++) {
+                                int nx = x + dx, ny = y + dy;
+                                if (nx < 0 || ny < 0 || nx >= LIGHTMAP_SIZE || ny >= LIGHTMAP_SIZE) continue;
+                                size_t neighbour = static_cast<size_t>(ny) * LIGHTMAP_SIZE + nx;
+                                if (!covered[neighbour]) continue;
+                                sum += texels[neighbour];
+                                count++;
+                            }
+                        }
+                        if (count == 0) continue;
+                        texels[index] = sum / static_cast<float>(count);
+                        next[index] = 1;
+                    }
+                }
+            });
+            covered.swap(next);
+        }
+
+        texels16.resize(texels.size() * 3);
+        for (size_t i = 0; i < texels.size(); i++) {
+            for (int c = 0; c < 3; c++) {
+                float q = std::min(std::max(texels[i][c] * LIGHTMAP_QUANTIZE + 0.5f, 0.0f), 65535.0f);
+                texels16[i * 3 + c] = static_cast<uint16_t>(q);
+            }
+        }
+    }
+
+    // Weights of `p` in triangle (a, b, c), false if it lies outside.
+    static bool Barycentric(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, glm::vec3& w) {
+        glm::vec2 e0 = b - a, e1 = c - a, d = p - a;
+        float det = e0.x * e1.y - e1.x * e0.y;
+        if (std::fabs(det) < 1e-12f) return false;
+        float v = (d.x * e1.y - e1.x * d.y) / det;
+        float u = (e0.x * d.y - d.x * e0.y) / det;
+        const float eps = 1e-5f;
+        if (v < -eps || u < -eps || u + v > 1.0f + eps) return false;
+        w = glm::vec3(1.0f - u - v, v, u);
+        return true;
+    }
+
+    // FNV-1a over every input of the bake.
+    std::string CachePath(const std::vector<glm::vec3>& lanterns) const {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, size_t size) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        };
+        const float params[] = {
+            static_cast<float>(LIGHTMAP_VERSION), static_cast<float>(LIGHTMAP_SIZE),
+            static_cast<float>(LIGHTMAP_TERRAIN_SIZE), static_cast<float>(LIGHTMAP_TILE),
+            static_cast<float>(LIGHTMAP_SKY_RAYS), LIGHTMAP_SKY_DISTANCE, LIGHTMAP_RAY_BIAS,
+            LIGHTMAP_MIN_CONTRIBUTION, static_cast<float>(TERRAIN_GRID), TERRAIN_SIZE, TERRAIN_MAX_HEIGHT, HOUSE_SCALE
+        };
+        mix(params, sizeof(params));
+        if (!lanterns.empty()) mix(lanterns.data(), lanterns.size() * sizeof(glm::vec3));
+        if (!housePositions.empty()) mix(housePositions.data(), housePositions.size() * sizeof(glm::vec3));
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "lightmap_%016llx.bin", static_cast<unsigned long long>(hash));
+        return name;
+    }
+
+    // File layout: magic, version, then the atlas as 16-bit RGB texels.
+    bool Load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+        char magic[4] = {};
+        unsigned int version = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if (!in || std::memcmp(magic, LIGHTMAP_MAGIC, sizeof(magic)) != 0 || version != LIGHTMAP_VERSION) {
+            std::cerr << "Ignoring stale lightmap cache: " << path << std::endl;
+            return false;
+        }
+        texels16.resize(static_cast<size_t>(LIGHTMAP_SIZE) * LIGHTMAP_SIZE * 3);
+        in.read(reinterpret_cast<char*>(texels16.data()), texels16.size() * sizeof(uint16_t));
+        if (!in) {
+            std::cerr << "Truncated lightmap cache: " << path << std::endl;
+            texels16.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void Save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Failed to write lightmap cache: " << path << std::endl;
+            return;
+        }
+        out.write(LIGHTMAP_MAGIC, sizeof(LIGHTMAP_MAGIC));
+        out.write(reinterpret_cast<const char*>(&LIGHTMAP_VERSION), sizeof(LIGHTMAP_VERSION));
+        out.write(reinterpret_cast<const char*>(texels16.data()), texels16.size() * sizeof(uint16_t));
+    }
+
+    std::vector<glm::vec3> housePositions;
+    int houseTiles = 0;
+    std::vector<uint16_t> texels16;
+    unsigned int texture = 0;
+};
+
+#endif
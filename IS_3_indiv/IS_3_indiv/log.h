@@ -0,0 +1,320 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+
+// Levels below this are compiled out entirely, arguments included.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+const int LOG_MESSAGE_SIZE = 480;
+const int LOG_QUEUE_SIZE = 1024;
+
+// Messages per call site per second; the rest are counted and reported with
+// the next message that gets through.
+const int LOG_RATE_LIMIT = 20;
+
+struct LogEntry {
+    unsigned long long sequence;
+    long long time;
+    int level;
+    int thread;
+    char text[LOG_MESSAGE_SIZE];
+};
+
+// Single producer (the owning thread), single consumer (whoever drains while
+// holding the drain lock). A full queue drops the message instead of waiting.
+struct LogQueue {
+    int thread = 0;
+    std::vector<LogEntry> entries;
+    std::atomic<unsigned long long> head{ 0 };
+    std::atomic<unsigned long long> tail{ 0 };
+
+    LogEntry* Reserve() {
+        unsigned long long h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= LOG_QUEUE_SIZE) return nullptr;
+        return &entries[h & (LOG_QUEUE_SIZE - 1)];
+    }
+
+    void Publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+// Formats straight into a queue entry; anything past the end is cut off.
+class LogStreamBuffer : public std::streambuf {
+public:
+    void Reset(char* begin, size_t size) { setp(begin, begin + size - 1); }
+    size_t Length() const { return static_cast<size_t>(pptr() - pbase()); }
+
+protected:
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+};
+
+// Per call site rate limit over one-second windows.
+struct LogSite {
+    std::atomic<long long> windowStart{ 0 };
+    std::atomic<int> count{ 0 };
+    std::atomic<int> suppressed{ 0 };
+
+    bool Allow(long long now, int& suppressedBefore) {
+        long long start = windowStart.load(std::memory_order_relaxed);
+        if (now - start >= 1000000000LL && windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        if (count.fetch_add(1, std::memory_order_relaxed) >= LOG_RATE_LIMIT) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressedBefore = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+inline const char* LogLevelName(int level) {
+    switch (level) {
+    case LOG_LEVEL_TRACE: return "trace";
+    case LOG_LEVEL_DEBUG: return "debug";
+    case LOG_LEVEL_INFO: return "info";
+    case LOG_LEVEL_WARN: return "warn";
+    default: return "error";
+    }
+}
+
+inline bool ParseLogLevel(const std::string& name, int& level) {
+    for (int l = LOG_LEVEL_TRACE; l <= LOG_LEVEL_ERROR; l++) {
+        if (name == LogLevelName(l)) {
+            level = l;
+            return true;
+        }
+    }
+    std::cerr << "Unknown log level: " << name << std::endl;
+    return false;
+}
+
+// Call sites format into their thread's queue; a background thread drains
+// all queues in order to the console and, optionally, a file.
+class Logger {
+public:
+    static Logger& Get() {
+        static Logger logger;
+        return logger;
+    }
+
+    static long long Now() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool Enabled(int level) const { return level >= minLevel.load(std::memory_order_relaxed); }
+    void SetLevel(int level) { minLevel.store(level, std::memory_order_relaxed); }
+
+    void SetConsole(bool enabled) {
+        std::lock_guard<std::mutex> lock(drainMutex);
+        console = enabled;
+    }
+
+    bool OpenFile(const std::string& path) {
+        std::lock_guard<std::mutex> lock(drainMutex);
+        file.open(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open log file: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Starts a message; returns null if this thread's queue is full.
+    std::ostream* Begin(int level) {
+        ThreadState& state = CurrentThread();
+        LogEntry* entry = state.queue->Reserve();
+        if (entry == nullptr) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        entry->level = level;
+        state.entry = entry;
+        state.buffer.Reset(entry->text, LOG_MESSAGE_SIZE);
+        return &state.stream;
+    }
+
+    void Commit(int suppressed) {
+        ThreadState& state = CurrentThread();
+        if (suppressed > 0) state.stream << " (" << suppressed << " similar messages suppressed)";
+
+        LogEntry* entry = state.entry;
+        entry->text[state.buffer.Length()] = '\0';
+        entry->time = Now();
+        entry->thread = state.queue->thread;
+        entry->sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+        state.queue->Publish();
+    }
+
+    // Writes out everything queued so far before returning, so direct
+    // std::cout output that follows stays in order.
+    void Flush() {
+        std::lock_guard<std::mutex> lock(drainMutex);
+        Drain();
+    }
+
+    ~Logger() {
+        running = false;
+        if (worker.joinable()) worker.join();
+        Flush();
+    }
+
+private:
+    struct ThreadState {
+        LogQueue* queue = nullptr;
+        LogEntry* entry = nullptr;
+        LogStreamBuffer buffer;
+        std::ostream stream{ &buffer };
+    };
+
+    Logger() : epoch(Now()) {
+        worker = std::thread([this]() {
+            while (running) {
+                bool wrote = false;
+                {
+                    std::lock_guard<std::mutex> lock(drainMutex);
+                    wrote = Drain();
+                }
+                if (!wrote) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+    }
+
+    ThreadState& CurrentThread() {
+        thread_local ThreadState state;
+        if (state.queue == nullptr) {
+            std::lock_guard<std::mutex> lock(queuesMutex);
+            queues.emplace_back(new LogQueue());
+            state.queue = queues.back().get();
+            state.queue->thread = static_cast<int>(queues.size());
+            state.queue->entries.resize(LOG_QUEUE_SIZE);
+        }
+        return state;
+    }
+
+    // Caller holds drainMutex. Returns true if anything was written.
+    bool Drain() {
+        std::vector<LogQueue*> current;
+        {
+            std::lock_guard<std::mutex> lock(queuesMutex);
+            for (auto& q : queues) current.push_back(q.get());
+        }
+
+        pending.clear();
+        for (LogQueue* q : current) {
+            unsigned long long head = q->head.load(std::memory_order_acquire);
+            unsigned long long tail = q->tail.load(std::memory_order_relaxed);
+            for (; tail < head; tail++) pending.push_back(q->entries[tail & (LOG_QUEUE_SIZE - 1)]);
+            q->tail.store(tail, std::memory_order_release);
+        }
+
+        int lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (pending.empty() && lost == 0) return false;
+
+        std::sort(pending.begin(), pending.end(),
+            [](const LogEntry& a, const LogEntry& b) { return a.sequence < b.sequence; });
+
+        for (const LogEntry& e : pending) Write(e.level, e.thread, e.time, e.text);
+        if (lost > 0) {
+            std::string note = std::to_string(lost) + " log messages dropped, queue full";
+            Write(LOG_LEVEL_WARN, 0, Now(), note.c_str());
+        }
+
+        if (console) {
+            std::cout.flush();
+            std::cerr.flush();
+        }
+        if (file.is_open()) file.flush();
+        return true;
+    }
+
+    void Write(int level, int thread, long long time, const char* text) {
+        if (console) {
+            if (level >= LOG_LEVEL_WARN) std::cerr << "[" << LogLevelName(level) << "] " << text << '\n';
+            else std::cout << text << '\n';
+        }
+        if (file.is_open()) {
+            file << std::fixed << std::setprecision(3) << std::setw(10) << (time - epoch) / 1.0e9 << " "
+                << std::left << std::setw(5) << LogLevelName(level) << std::right << " [" << thread << "] " << text << '\n';
+        }
+    }
+
+    long long epoch;
+    std::atomic<int> minLevel{ LOG_MIN_LEVEL };
+    std::atomic<unsigned long long> sequence{ 0 };
+    std::atomic<int> dropped{ 0 };
+
+    std::mutex queuesMutex;
+    std::vector<std::unique_ptr<LogQueue>> queues;
+
+    std::mutex drainMutex;
+    std::vector<LogEntry> pending;
+    bool console = true;
+    std::ofstream file;
+
+    std::atomic<bool> running{ true };
+    std::thread worker;
+};
+
+#define LOG_AT(level, message) do { \
+        static LogSite logSite; \
+        int logSuppressed = 0; \
+        if (Logger::Get().Enabled(level) && logSite.Allow(Logger::Now(), logSuppressed)) { \
+            if (std::ostream* logStream = Logger::Get().Begin(level)) { \
+                *logStream << message; \
+                Logger::Get().Commit(logSuppressed); \
+            } \
+        } \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(message) LOG_AT(LOG_LEVEL_TRACE, message)
+#else
+#define LOG_TRACE(message) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(message) LOG_AT(LOG_LEVEL_DEBUG, message)
+#else
+#define LOG_DEBUG(message) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(message) LOG_AT(LOG_LEVEL_INFO, message)
+#else
+#define LOG_INFO(message) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(message) LOG_AT(LOG_LEVEL_WARN, message)
+#else
+#define LOG_WARN(message) ((void)0)
+#endif
+
+#define LOG_ERROR(message) LOG_AT(LOG_LEVEL_ERROR, message)
+
+#endif
@@ -10,9 +10,41 @@
 #include <sstream>
 #include <ctime>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include "alloccount.h"
 #include "camera.h"
 #include "shaders.h"
+#include "geometry.h"
+#include "heightfield.h"
+#include "simulation.h"
+#include "simthread.h"
+#include "jobsystem.h"
+#include "culling.h"
+#include "drawlist.h"
+#include "benchmarks.h"
+#include "microbench.h"
+#include "framebench.h"
+#include "scene.h"
+#include "options.h"
+#include "headless.h"
+#include "profiler.h"
+#include "log.h"
+#include "overdraw.h"
+#include "overlay.h"
+#include "inputlog.h"
+#include "latency.h"
+#include "framepacer.h"
+#include "upscale.h"
+#include "snow.h"
+#include "clouds.h"
+#include "impostor.h"
+#include "lightmap.h"
+#include "probes.h"
+#include "shadows.h"
+#include "textures.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -21,65 +53,41 @@
 #define M_PI 3.14159265358979323846f
 #endif
 
-const int NUM_LANTERNS = 10;
-const int NUM_HOUSES = 8;
-const int NUM_TREES = 20;
-const int NUM_SLEDS = 3;  
-
-glm::vec3 lanternPositions[NUM_LANTERNS] = {
-    {400.0f, 15.0f, 400.0f}, {-400.0f, 15.0f, 400.0f}, {400.0f, 15.0f, -400.0f}, {-400.0f, 15.0f, -400.0f},
-    {1200.0f, 15.0f, 0.0f}, {-1200.0f, 15.0f, 0.0f}, {0.0f, 15.0f, 1200.0f}, {0.0f, 15.0f, -1200.0f},
-    {1800.0f, 15.0f, 1800.0f}, {-1800.0f, 15.0f, -1800.0f}
+const float HOUSE_CULL_RADIUS = 45.0f;
+const float SLED_CULL_RADIUS = 4.0f;
+const float PACKAGE_CULL_RADIUS = 6.0f;
+const float AIRSHIP_SHADOW_RADIUS = 60.0f;
+const int CULL_GRAIN = 1024;
+
+enum MeshId {
+    MESH_HOUSE,
+    MESH_PACKAGE,
+    MESH_SLED,
+    MESH_COUNT
 };
 
-glm::vec3 housePositions[NUM_HOUSES];
-glm::vec3 houseColors[NUM_HOUSES];
-bool houseNeedsDelivery[NUM_HOUSES];
-float houseDeliveryTimers[NUM_HOUSES];
-int deliveriesCompleted = 0;
-
-glm::vec3 treePositions[NUM_TREES];
-
-struct Vertex {
-    glm::vec3 position;
-    glm::vec2 texCoords;
-    glm::vec3 normal;
-    glm::vec3 tangent;
-    float type;
+enum MaterialId {
+    MATERIAL_COLOR,
+    MATERIAL_COUNT
 };
 
 struct GameObject {
     unsigned int vao;
-    unsigned int texture;
-    unsigned int normalMap;
+    // Indices into the TextureArray, -1 for none.
+    int texture;
+    int normalMap;
     int vertexCount;
 };
 
-struct Sled {
-    glm::vec3 position;
-    float angle;
-    float speed;
-    float radius;
-    float bobOffset;  
-};
-
-struct Package {
-    glm::vec3 pos;
-    glm::vec3 dir;
-    float lifeTime;
-    bool active;
-    glm::vec3 color;
-};
-std::vector<Package> packages;
-
-Sled sleds[NUM_SLEDS];
-
 bool mouseCaptured = false;
+bool inputReplaying = false;
 double lastMouseX = 640.0;
 double lastMouseY = 360.0;
+FrameLatency frameLatency;
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    if (!mouseCaptured) return;
+    if (!mouseCaptured || inputReplaying) return;
+    frameLatency.OnInput(INPUT_EVENT_MOUSE);
 
     Camera* camera = static_cast<Camera*>(glfwGetWindowUserPointer(window));
     if (camera) {
@@ -87,7 +95,13 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     }
 }
 
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (inputReplaying || action == GLFW_REPEAT) return;
+    frameLatency.OnInput(INPUT_EVENT_KEY);
+}
+
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    if (inputReplaying) return;
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
         mouseCaptured = !mouseCaptured;
 
@@ -100,17 +114,18 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                 double xpos, ypos;
                 glfwGetCursorPos(window, &xpos, &ypos);
                 camera->SetMousePosition(static_cast<float>(xpos), static_cast<float>(ypos));
-                std::cout << "Mouse control ENABLED. Move mouse to look around." << std::endl;
+                LOG_INFO("Mouse control ENABLED. Move mouse to look around.");
             }
             else {
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-                std::cout << "Mouse control DISABLED." << std::endl;
+                LOG_INFO("Mouse control DISABLED.");
             }
         }
     }
 }
 
 unsigned int load_texture(const char* path) {
+    PROFILE_SCOPE("load_texture");
     unsigned int id;
     glGenTextures(1, &id);
     int w, h, ch;
@@ -136,459 +151,9 @@ unsigned int load_texture(const char* path) {
     return id;
 }
 
-void computeTangents(std::vector<Vertex>& out) {
-    for (size_t i = 0; i < out.size(); i += 3) {
-        if (i + 2 >= out.size()) break;
-        glm::vec3& v0 = out[i].position;
-        glm::vec3& v1 = out[i + 1].position;
-        glm::vec3& v2 = out[i + 2].position;
-        glm::vec2& uv0 = out[i].texCoords;
-        glm::vec2& uv1 = out[i + 1].texCoords;
-        glm::vec2& uv2 = out[i + 2].texCoords;
-
-        glm::vec3 edge1 = v1 - v0;
-        glm::vec3 edge2 = v2 - v0;
-        glm::vec2 deltaUV1 = uv1 - uv0;
-        glm::vec2 deltaUV2 = uv2 - uv0;
-
-        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        glm::vec3 tangent;
-        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-        tangent = glm::normalize(tangent);
-        out[i].tangent = out[i + 1].tangent = out[i + 2].tangent = tangent;
-    }
-}
-
-void load_obj(const std::string& path, std::vector<Vertex>& out) {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec2> texcoords;
-    std::vector<glm::vec3> normals;
-
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Failed to load OBJ file: " << path << ". Using fallback cube." << std::endl;
-        float s = 1.0f;
-        positions = {
-            {-s,-s,-s}, {s,-s,-s}, {s,s,-s}, {-s,s,-s},
-            {-s,-s,s}, {s,-s,s}, {s,s,s}, {-s,s,s}
-        };
-
-        int indices[] = {
-            0,1,2, 0,2,3, 4,5,6, 4,6,7,
-            0,1,5, 0,5,4, 1,2,6, 1,6,5,
-            2,3,7, 2,7,6, 3,0,4, 3,4,7
-        };
-
-        for (int i = 0; i < 36; i++) {
-            Vertex v;
-            v.position = positions[indices[i]];
-            v.texCoords = glm::vec2(0.0f, 0.0f);
-            v.normal = glm::normalize(v.position);
-            v.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-            v.type = 0.0f;
-            out.push_back(v);
-        }
-        computeTangents(out);
-        return;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string type;
-        ss >> type;
-
-        if (type == "v") {
-            glm::vec3 pos;
-            ss >> pos.x >> pos.y >> pos.z;
-            positions.push_back(pos);
-        }
-        else if (type == "vt") {
-            glm::vec2 uv;
-            ss >> uv.x >> uv.y;
-            uv.y = 1.0f - uv.y;
-            texcoords.push_back(uv);
-        }
-        else if (type == "vn") {
-            glm::vec3 normal;
-            ss >> normal.x >> normal.y >> normal.z;
-            normals.push_back(normal);
-        }
-        else if (type == "f") {
-            std::string v1, v2, v3;
-            ss >> v1 >> v2 >> v3;
-
-            auto parseFace = [&](const std::string& vertex) {
-                std::stringstream vss(vertex);
-                std::string indices[3];
-                for (int i = 0; i < 3; i++) {
-                    std::getline(vss, indices[i], '/');
-                }
-
-                int posIdx = std::stoi(indices[0]) - 1;
-                int texIdx = indices[1].empty() ? 0 : std::stoi(indices[1]) - 1;
-                int normIdx = indices[2].empty() ? 0 : std::stoi(indices[2]) - 1;
-
-                Vertex v;
-                v.position = positions[posIdx];
-                v.texCoords = texIdx < texcoords.size() ? texcoords[texIdx] : glm::vec2(0.0f);
-                v.normal = normIdx < normals.size() ? normals[normIdx] : glm::vec3(0.0f, 1.0f, 0.0f);
-                v.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-                v.type = 0.0f;
-
-                return v;
-                };
-
-            out.push_back(parseFace(v1));
-            out.push_back(parseFace(v2));
-            out.push_back(parseFace(v3));
-        }
-    }
-
-    file.close();
-    std::cout << "Loaded OBJ file: " << path << " with " << out.size() << " vertices" << std::endl;
-    computeTangents(out);
-}
-
-void generateTerrain(std::vector<Vertex>& out) {
-    int width = 50, height = 50;
-    float size = 5000.0f;
-    float maxHeight = 100.0f;
-
-    std::vector<std::vector<glm::vec3>> posMap(height, std::vector<glm::vec3>(width));
-
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            float nx = static_cast<float>(x) / static_cast<float>(width) * 4.0f;
-            float nz = static_cast<float>(z) / static_cast<float>(height) * 4.0f;
-            float h = 0.5f + 0.3f * sin(nx) * cos(nz);
-
-            posMap[z][x] = glm::vec3(
-                (static_cast<float>(x) / static_cast<float>(width) - 0.5f) * size,
-                h * maxHeight * 0.3f,
-                (static_cast<float>(z) / static_cast<float>(height) - 0.5f) * size
-            );
-        }
-    }
-
-    for (int z = 0; z < height - 1; z++) {
-        for (int x = 0; x < width - 1; x++) {
-            glm::vec2 uv0(static_cast<float>(x) / static_cast<float>(width), static_cast<float>(z) / static_cast<float>(height));
-            glm::vec2 uv1(static_cast<float>(x) / static_cast<float>(width), static_cast<float>(z + 1) / static_cast<float>(height));
-            glm::vec2 uv2(static_cast<float>(x + 1) / static_cast<float>(width), static_cast<float>(z) / static_cast<float>(height));
-            glm::vec2 uv3(static_cast<float>(x + 1) / static_cast<float>(width), static_cast<float>(z + 1) / static_cast<float>(height));
-
-            out.push_back({ posMap[z][x], uv0 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
-            out.push_back({ posMap[z + 1][x], uv1 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
-            out.push_back({ posMap[z][x + 1], uv2 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
-
-            out.push_back({ posMap[z][x + 1], uv2 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
-            out.push_back({ posMap[z + 1][x], uv1 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
-            out.push_back({ posMap[z + 1][x + 1], uv3 * 20.0f, {0.0f,1.0f,0.0f}, {0.0f,0.0f,0.0f}, 0.0f });
-        }
-    }
-    computeTangents(out);
-}
-
-void generateSphere(std::vector<Vertex>& out, float radius, int sectors, int stacks, float type) {
-    std::vector<Vertex> raw;
-    for (int i = 0; i <= stacks; ++i) {
-        float stackAngle = M_PI / 2.0f - static_cast<float>(i) / static_cast<float>(stacks) * M_PI;
-        float xy = radius * cosf(stackAngle);
-        float z = radius * sinf(stackAngle);
-        for (int j = 0; j <= sectors; ++j) {
-            float sectorAngle = static_cast<float>(j) / static_cast<float>(sectors) * 2.0f * M_PI;
-            glm::vec3 pos(xy * cosf(sectorAngle), z, xy * sinf(sectorAngle));
-            raw.push_back({ pos,
-                           glm::vec2(static_cast<float>(j) / static_cast<float>(sectors),
-                                     static_cast<float>(i) / static_cast<float>(stacks)),
-                           glm::normalize(pos),
-                           {0.0f,0.0f,0.0f},
-                           type });
-        }
-    }
-
-    std::vector<Vertex> tris;
-    for (int i = 0; i < stacks; ++i) {
-        int k1 = i * (sectors + 1);
-        int k2 = k1 + sectors + 1;
-        for (int j = 0; j < sectors; ++j, ++k1, ++k2) {
-            if (i != 0) {
-                tris.push_back(raw[k1]);
-                tris.push_back(raw[k2]);
-                tris.push_back(raw[k1 + 1]);
-            }
-            if (i != (stacks - 1)) {
-                tris.push_back(raw[k1 + 1]);
-                tris.push_back(raw[k2]);
-                tris.push_back(raw[k2 + 1]);
-            }
-        }
-    }
-    computeTangents(tris);
-    out.insert(out.end(), tris.begin(), tris.end());
-}
-
-void generateHouse(std::vector<Vertex>& out) {
-    float w = 0.5f, h = 0.5f, d = 0.5f;
-
-    glm::vec3 vertices[] = {
-        {-w, -h,  d}, { w, -h,  d}, { w,  h,  d}, {-w,  h,  d},
-        {-w, -h, -d}, { w, -h, -d}, { w,  h, -d}, {-w,  h, -d}
-    };
-
-    int indices[] = {
-        0,1,2, 0,2,3,
-        5,4,7, 5,7,6,
-        1,5,6, 1,6,2,
-        4,0,3, 4,3,7,
-        3,2,6, 3,6,7,
-        4,5,1, 4,1,0
-    };
-
-    for (int i = 0; i < 36; i += 3) {
-        int idx1 = indices[i], idx2 = indices[i + 1], idx3 = indices[i + 2];
-
-        Vertex v1, v2, v3;
-        v1.position = vertices[idx1];
-        v2.position = vertices[idx2];
-        v3.position = vertices[idx3];
-
-        v1.texCoords = glm::vec2(0.0f, 0.0f);
-        v2.texCoords = glm::vec2(1.0f, 0.0f);
-        v3.texCoords = glm::vec2(0.5f, 1.0f);
-
-        glm::vec3 edge1 = v2.position - v1.position;
-        glm::vec3 edge2 = v3.position - v1.position;
-        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
-
-        v1.normal = v2.normal = v3.normal = normal;
-        v1.type = v2.type = v3.type = 0.0f;
-        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-
-        out.push_back(v1);
-        out.push_back(v2);
-        out.push_back(v3);
-    }
-
-    glm::vec3 roofVertices[] = {
-        {-w * 1.3f, h, -d * 1.3f},
-        { w * 1.3f, h, -d * 1.3f},
-        { w * 1.3f, h,  d * 1.3f},
-        {-w * 1.3f, h,  d * 1.3f},
-        {0.0f, h + 0.6f, 0.0f}
-    };
-
-    int roofIndices[] = {
-        0,1,4, 1,2,4, 2,3,4, 3,0,4
-    };
-
-    for (int i = 0; i < 12; i += 3) {
-        int idx1 = roofIndices[i], idx2 = roofIndices[i + 1], idx3 = roofIndices[i + 2];
-
-        Vertex v1, v2, v3;
-        v1.position = roofVertices[idx1];
-        v2.position = roofVertices[idx2];
-        v3.position = roofVertices[idx3];
-
-        v1.texCoords = glm::vec2(0.0f, 0.0f);
-        v2.texCoords = glm::vec2(1.0f, 0.0f);
-        v3.texCoords = glm::vec2(0.5f, 1.0f);
-
-        glm::vec3 edge1 = v2.position - v1.position;
-        glm::vec3 edge2 = v3.position - v1.position;
-        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
-
-        v1.normal = v2.normal = v3.normal = normal;
-        v1.type = v2.type = v3.type = 0.0f;
-        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-
-        out.push_back(v1);
-        out.push_back(v2);
-        out.push_back(v3);
-    }
-
-    computeTangents(out);
-}
-
-void generateTree(std::vector<Vertex>& out) {
-    float trunkHeight = 1.2f;
-    float trunkRadius = 0.1f;
-    int segments = 8;
-
-    for (int i = 0; i < segments; i++) {
-        float a1 = 2.0f * M_PI * i / segments;
-        float a2 = 2.0f * M_PI * (i + 1) / segments;
-
-        glm::vec3 p1(cos(a1) * trunkRadius, -0.5f, sin(a1) * trunkRadius);
-        glm::vec3 p2(cos(a2) * trunkRadius, -0.5f, sin(a2) * trunkRadius);
-        glm::vec3 p3(cos(a1) * trunkRadius, trunkHeight, sin(a1) * trunkRadius);
-        glm::vec3 p4(cos(a2) * trunkRadius, trunkHeight, sin(a2) * trunkRadius);
-
-        out.push_back({ p1, {0.0f, 0.0f}, glm::normalize(glm::vec3(p1.x, 0.0f, p1.z)), {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ p2, {1.0f, 0.0f}, glm::normalize(glm::vec3(p2.x, 0.0f, p2.z)), {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ p3, {0.0f, 1.0f}, glm::normalize(glm::vec3(p1.x, 0.0f, p1.z)), {0.0f,0.0f,0.0f}, 0.0f });
-
-        out.push_back({ p2, {1.0f, 0.0f}, glm::normalize(glm::vec3(p2.x, 0.0f, p2.z)), {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ p4, {1.0f, 1.0f}, glm::normalize(glm::vec3(p2.x, 0.0f, p2.z)), {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ p3, {0.0f, 1.0f}, glm::normalize(glm::vec3(p1.x, 0.0f, p1.z)), {0.0f,0.0f,0.0f}, 0.0f });
-    }
-
-    std::vector<Vertex> crown1, crown2;
-    generateSphere(crown1, 0.5f, 8, 6, 1.0f);
-    generateSphere(crown2, 0.3f, 8, 6, 1.0f);
-
-    for (auto& v : crown1) { v.position.y += trunkHeight - 0.1f; out.push_back(v); }
-    for (auto& v : crown2) { v.position.y += trunkHeight + 0.3f; out.push_back(v); }
-
-    computeTangents(out);
-}
-
-void generateLantern(std::vector<Vertex>& out) {
-    float r = 2.0f, h = 40.0f;
-
-    for (int i = 0; i < 12; i++) {
-        float a = 2.0f * M_PI * i / 12.0f;
-        float na = 2.0f * M_PI * (i + 1) / 12.0f;
-
-        glm::vec3 n(cos(a), 0.0f, sin(a));
-
-        out.push_back({ {cos(a) * r, 0.0f, sin(a) * r}, {0.0f,0.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ {cos(na) * r, 0.0f, sin(na) * r}, {1.0f,0.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ {cos(a) * r, h, sin(a) * r}, {0.0f,1.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
-
-        out.push_back({ {cos(na) * r, 0.0f, sin(na) * r}, {1.0f,0.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ {cos(na) * r, h, sin(na) * r}, {1.0f,1.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
-        out.push_back({ {cos(a) * r, h, sin(a) * r}, {0.0f,1.0f}, n, {0.0f,0.0f,0.0f}, 0.0f });
-    }
-
-    computeTangents(out);
-
-    std::vector<Vertex> bulb;
-    generateSphere(bulb, 4.0f, 10, 10, 1.0f);
-    for (auto& v : bulb) {
-        v.position.y += h;
-        out.push_back(v);
-    }
-}
-
-void generateSled(std::vector<Vertex>& out) {
-    float length = 1.0f;
-    float width = 0.3f;
-    float height = 0.15f;
-
-    glm::vec3 vertices[] = {
-        {-length / 2, height / 2, -width / 2},
-        { length / 2, height / 2, -width / 2},
-        { length / 2, height / 2,  width / 2},
-        {-length / 2, height / 2,  width / 2},
-
-        {-length / 2, height, -width / 2},
-        { length / 2, height, -width / 2},
-        { length / 2, height,  width / 2},
-        {-length / 2, height,  width / 2},
-
-        {-length / 2 * 0.7f, 0.0f, -width / 2},
-        { length / 2 * 0.7f, 0.0f, -width / 2},
-        { length / 2 * 0.7f, 0.0f,  width / 2},
-        {-length / 2 * 0.7f, 0.0f,  width / 2},
-
-        {0.0f, height * 0.5f, -width / 2},
-        {0.0f, height * 0.5f, width / 2}
-    };
-
-    int indices[] = {
-        0,1,2, 0,2,3,
-
-        0,4,5, 0,5,1,
-        1,5,6, 1,6,2,
-        2,6,7, 2,7,3,
-        3,7,4, 3,4,0,
-
-        4,5,6, 4,6,7,
-
-        8,9,10, 8,10,11,
-
-        0,8,11, 0,11,3,
-        1,9,8, 1,8,0,
-        2,10,9, 2,9,1,
-        3,11,10, 3,10,2,
-
-        8,12,9, 11,13,10
-    };
-
-    for (int i = 0; i < 36; i += 3) {
-        int idx1 = indices[i], idx2 = indices[i + 1], idx3 = indices[i + 2];
-
-        Vertex v1, v2, v3;
-        v1.position = vertices[idx1];
-        v2.position = vertices[idx2];
-        v3.position = vertices[idx3];
-
-        v1.texCoords = glm::vec2(0.0f, 0.0f);
-        v2.texCoords = glm::vec2(1.0f, 0.0f);
-        v3.texCoords = glm::vec2(0.5f, 1.0f);
-
-        glm::vec3 edge1 = v2.position - v1.position;
-        glm::vec3 edge2 = v3.position - v1.position;
-        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
-
-        v1.normal = v2.normal = v3.normal = normal;
-        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-        v1.type = v2.type = v3.type = 0.0f;
-
-        out.push_back(v1);
-        out.push_back(v2);
-        out.push_back(v3);
-    }
-
-    computeTangents(out);
-}
-
-void generateSnowCircle(std::vector<Vertex>& out) {
-    float radius = 200.0f;
-    int segments = 32;
-    float centerY = 0.0f;
-
-    glm::vec3 center(0.0f, centerY, 200.0f);
-
-    for (int i = 0; i < segments; i++) {
-        float angle1 = 2.0f * M_PI * i / segments;
-        float angle2 = 2.0f * M_PI * (i + 1) / segments;
-
-        glm::vec3 p1 = center + glm::vec3(sin(angle1) * radius, 0.0f, cos(angle1) * radius);
-        glm::vec3 p2 = center + glm::vec3(sin(angle2) * radius, 0.0f, cos(angle2) * radius);
-        glm::vec3 p3 = center;
-
-        p3.y = centerY + 5.0f;
-
-        Vertex v1, v2, v3;
-        v1.position = p1;
-        v2.position = p2;
-        v3.position = p3;
-
-        v1.texCoords = glm::vec2((sin(angle1) + 1.0f) * 0.5f, (cos(angle1) + 1.0f) * 0.5f);
-        v2.texCoords = glm::vec2((sin(angle2) + 1.0f) * 0.5f, (cos(angle2) + 1.0f) * 0.5f);
-        v3.texCoords = glm::vec2(0.5f, 0.5f);
-
-        v1.normal = v2.normal = v3.normal = glm::vec3(0.0f, 1.0f, 0.0f);
-        v1.tangent = v2.tangent = v3.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-        v1.type = v2.type = v3.type = 0.0f;
-
-        out.push_back(v1);
-        out.push_back(v2);
-        out.push_back(v3);
-    }
-
-    computeTangents(out);
-}
-
-GameObject create_obj(const std::string& type, const std::string& png = "", const std::string& nmap = "",
+GameObject create_obj(TextureArray& textures, const std::string& type, const std::string& png = "", const std::string& nmap = "",
     glm::vec3* instPos = nullptr, int instCount = 0, float sType = 0.0f) {
+    PROFILE_SCOPE_DYNAMIC("create_obj " + type);
     std::vector<Vertex> vertices;
 
     if (type == "GEN_TERRAIN") {
@@ -639,6 +204,9 @@ GameObject create_obj(const std::string& type, const std::string& png = "", cons
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, type));
 
+    glEnableVertexAttribArray(11);
+    glVertexAttribPointer(11, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, lightmapUv));
+
     if (instPos != nullptr && instCount > 0) {
         unsigned int instanceVBO;
         glGenBuffers(1, &instanceVBO);
@@ -652,45 +220,77 @@ GameObject create_obj(const std::string& type, const std::string& png = "", cons
 
     glBindVertexArray(0);
 
-    unsigned int texture = 0;
-    if (!png.empty()) {
-        texture = load_texture(png.c_str());
+    int texture = png.empty() ? -1 : textures.Add(png);
+    int normalMap = nmap.empty() ? -1 : textures.Add(nmap);
+
+    return { vao, texture, normalMap, static_cast<int>(vertices.size()) };
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return -1;
     }
+    PROFILE_THREAD("Main");
 
-    unsigned int normalMap = 0;
-    if (!nmap.empty()) {
-        normalMap = load_texture(nmap.c_str());
+    Logger::Get().SetLevel(options.logLevel);
+    if (!options.logFile.empty() && !Logger::Get().OpenFile(options.logFile)) {
+        return -1;
     }
 
-    return { vao, texture, normalMap, static_cast<int>(vertices.size()) };
-}
+    if (options.benchJobs) {
+        return RunJobSystemBenchmark();
+    }
+
+    if (options.testJobs) {
+        return RunJobSystemTests();
+    }
 
-int main() {
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    if (options.benchMicro) {
+        return RunMicroBenchmarks(options.microMax);
+    }
 
-    for (int i = 0; i < NUM_HOUSES; i++) {
-        housePositions[i] = glm::vec3(
-            static_cast<float>(std::rand() % 4000 - 2000),
-            15.0f,
-            static_cast<float>(std::rand() % 4000 - 2000)
-        );
+    if (options.headless) {
+        int result = RunHeadless(options);
+        if (!options.trace.empty()) Profiler::Get().WriteTrace(options.trace);
+        return result;
+    }
 
-        houseColors[i] = glm::vec3(
-            static_cast<float>(std::rand() % 70 + 30) / 100.0f,
-            static_cast<float>(std::rand() % 70 + 30) / 100.0f,
-            static_cast<float>(std::rand() % 70 + 30) / 100.0f
-        );
+    // A replay rebuilds the recorded world whatever the command line says.
+    InputReplay replay;
+    if (!options.replay.empty()) {
+        if (!replay.Load(options.replay)) return -1;
+        inputReplaying = true;
+        options.seed = replay.Header().seed;
+        options.seedSet = true;
+        options.tickRate = replay.Header().tickRate;
+        options.scene = replay.Header().scene;
+    }
 
-        houseNeedsDelivery[i] = true;
-        houseDeliveryTimers[i] = static_cast<float>(std::rand() % 10 + 5);
+    unsigned int seed = options.seedSet ? options.seed : static_cast<unsigned int>(std::time(nullptr));
+    if (options.benchmark && !options.seedSet) seed = 1;
+    std::cout << "World seed: " << seed << std::endl;
+
+    GameState initialState;
+    SceneDecor decor;
+    BuildScene(options.scene, seed, initialState, decor);
+    PrintSceneSummary(options.scene);
+
+    InputRecorder recorder;
+    if (!options.record.empty()) {
+        InputLogHeader header;
+        header.seed = seed;
+        header.tickRate = options.tickRate;
+        header.scene = options.scene;
+        if (!recorder.Open(options.record, header)) return -1;
     }
 
-    for (int i = 0; i < NUM_TREES; i++) {
-        treePositions[i] = glm::vec3(
-            static_cast<float>(std::rand() % 6000 - 3000),
-            0.0f,
-            static_cast<float>(std::rand() % 6000 - 3000)
-        );
+    int lanternCount = static_cast<int>(decor.lanternPositions.size());
+    int treeCount = static_cast<int>(decor.treePositions.size());
+    std::vector<glm::vec3> litLanterns;
+
+    if (options.benchmark && !ApplyOffscreenHints(options.offscreen)) {
+        return -1;
     }
 
     if (!glfwInit()) {
@@ -698,6 +298,10 @@ int main() {
         return -1;
     }
 
+    if (options.benchmark) {
+        ApplyOffscreenWindowHints(options.offscreen);
+    }
+
     GLFWwindow* window = glfwCreateWindow(1280, 720, "Zima", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
@@ -709,6 +313,7 @@ int main() {
 
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     if (glewInit() != GLEW_OK) {
         std::cerr << "Failed to initialize GLEW" << std::endl;
@@ -723,7 +328,19 @@ int main() {
 
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 
-    unsigned int program = CreateShaderProgram();
+    OffscreenTarget offscreenTarget;
+    if (options.benchmark) {
+        glfwSwapInterval(0);
+        if (options.offscreen != "none" && !offscreenTarget.Init(1280, 720)) {
+            return -1;
+        }
+    }
+
+    unsigned int program = 0;
+    {
+        PROFILE_SCOPE("Shader compile");
+        program = CreateShaderProgram();
+    }
     if (program == 0) {
         std::cerr << "Failed to create shader program" << std::endl;
         return -1;
@@ -733,20 +350,24 @@ int main() {
 
     std::cout << "Creating winter scene with sleds circling the Christmas tree..." << std::endl;
 
-    GameObject terrain = create_obj("GEN_TERRAIN", "Field.png", "", nullptr, 0, 0.0f);
-    GameObject airship = create_obj("shar.obj", "shar.png", "shar_displacement.png", nullptr, 0, 0.0f);
-    GameObject tree = create_obj("ChrTree.obj", "ChrTree.png", "", nullptr, 0, 0.0f);
-    GameObject lantern = create_obj("GEN_LANTERN", "", "", lanternPositions, NUM_LANTERNS, 0.0f);
-    GameObject houseObj = create_obj("GEN_HOUSE", "", "", nullptr, 0, 0.0f);
-    GameObject packageObj = create_obj("GEN_SPHERE", "", "", nullptr, 0, 1.0f);
-    GameObject treeInstanced = create_obj("GEN_TREE", "", "", treePositions, NUM_TREES, 0.0f);
+    TextureArray textures;
+    GameObject terrain = create_obj(textures, "GEN_TERRAIN", "Field.png", "", nullptr, 0, 0.0f);
+    GameObject airship = create_obj(textures, "shar.obj", "shar.png", "shar_displacement.png", nullptr, 0, 0.0f);
+    GameObject tree = create_obj(textures, "ChrTree.obj", "ChrTree.png", "", nullptr, 0, 0.0f);
+    GameObject lantern = create_obj(textures, "GEN_LANTERN", "", "", decor.lanternPositions.data(), lanternCount, 0.0f);
+    GameObject houseObj = create_obj(textures, "GEN_HOUSE", "", "", nullptr, 0, 0.0f);
+    GameObject packageObj = create_obj(textures, "GEN_SPHERE", "", "", nullptr, 0, 1.0f);
+    GameObject treeInstanced = create_obj(textures, "GEN_TREE", "", "", decor.treePositions.data(), treeCount, 0.0f);
+    // Every tree, for the shadow cache: the impostors point treeInstanced's
+    // offsets at the near trees each frame.
+    GameObject treeCasters = create_obj(textures, "GEN_TREE", "", "", decor.treePositions.data(), treeCount, 0.0f);
 
-    GameObject snowCircle = create_obj("GEN_SNOW_CIRCLE", "", "", nullptr, 0, 0.0f);
+    GameObject snowCircle = create_obj(textures, "GEN_SNOW_CIRCLE", "", "", nullptr, 0, 0.0f);
 
-    GameObject sledObj = create_obj("GEN_SLED", "", "", nullptr, 0, 0.0f);
+    GameObject sledObj = create_obj(textures, "GEN_SLED", "", "", nullptr, 0, 0.0f);
 
     try {
-        GameObject sledObjLoaded = create_obj("sled.obj", "", "", nullptr, 0, 0.0f);
+        GameObject sledObjLoaded = create_obj(textures, "sled.obj", "", "", nullptr, 0, 0.0f);
         if (sledObjLoaded.vao != 0) {
             std::cout << "Successfully loaded sled OBJ model" << std::endl;
             sledObj = sledObjLoaded;
@@ -756,48 +377,38 @@ int main() {
         std::cout << "Could not load sled OBJ file. Using generated model." << std::endl;
     }
 
-    for (int i = 0; i < NUM_SLEDS; i++) {
-        float radius = 120.0f + static_cast<float>(i) * 40.0f;  
-        float angle = static_cast<float>(i) * (2.0f * M_PI / NUM_SLEDS);
-
-        sleds[i].radius = radius;
-        sleds[i].angle = angle;
-        sleds[i].speed = 0.3f + static_cast<float>(i) * 0.15f;  
-        sleds[i].bobOffset = static_cast<float>(std::rand() % 100) / 100.0f * 2.0f * M_PI;  
-
-        sleds[i].position = glm::vec3(
-            sin(angle) * radius,
-            20.0f, 
-            cos(angle) * radius + 200.0f  
-        );
-    }
-
     int modelLoc = glGetUniformLocation(program, "m");
-    int viewLoc = glGetUniformLocation(program, "v");
-    int projectionLoc = glGetUniformLocation(program, "pr");
-    int useTextureLoc = glGetUniformLocation(program, "useTexture");
+    int albedoTextureLoc = glGetUniformLocation(program, "albedoTexture");
     int lightDirLoc = glGetUniformLocation(program, "lightDir");
     int lanternPosLoc = glGetUniformLocation(program, "lanternPos");
+    int lanternCountLoc = glGetUniformLocation(program, "lanternCount");
     int isInstancedLoc = glGetUniformLocation(program, "isInstanced");
     int baseColorLoc = glGetUniformLocation(program, "baseColor");
-    int timeLoc = glGetUniformLocation(program, "time");
-    int isCloudLoc = glGetUniformLocation(program, "isCloud");
-    int useNormalMapLoc = glGetUniformLocation(program, "useNormalMap");
+    int normalTextureLoc = glGetUniformLocation(program, "normalTexture");
     int spotlightOnLoc = glGetUniformLocation(program, "spotlightOn");
     int spotlightPosLoc = glGetUniformLocation(program, "spotlightPos");
     int spotlightDirLoc = glGetUniformLocation(program, "spotlightDir");
+    int useInstanceDataLoc = glGetUniformLocation(program, "useInstanceData");
+    int overdrawLoc = glGetUniformLocation(program, "overdraw");
+    int lightmapRectLoc = glGetUniformLocation(program, "lightmapRect");
+    FrameUniformBuffer frameUniforms;
+    frameUniforms.Init(program);
 
     if (spotlightOnLoc == -1) std::cerr << "Warning: spotlightOn uniform not found" << std::endl;
     if (spotlightPosLoc == -1) std::cerr << "Warning: spotlightPos uniform not found" << std::endl;
     if (spotlightDirLoc == -1) std::cerr << "Warning: spotlightDir uniform not found" << std::endl;
 
-    glUniform1i(glGetUniformLocation(program, "t"), 0);
-    glUniform1i(glGetUniformLocation(program, "nm"), 1);
+    glUniform1i(glGetUniformLocation(program, "textures"), TEXTURE_ARRAY_UNIT);
+    glUniform1i(albedoTextureLoc, -1);
+    glUniform1i(normalTextureLoc, -1);
+    glUniform1i(glGetUniformLocation(program, "lightmap"), 2);
+    // Set even when unused: samplers of different types may not share a unit.
+    glUniform1i(glGetUniformLocation(program, "probes"), 3);
+    glUniform1i(glGetUniformLocation(program, "shadowMap"), SHADOW_TEXTURE_UNIT);
 
     Camera camera;
     glfwSetWindowUserPointer(window, &camera);
 
-    glm::vec3 airshipPos(0.0f, 300.0f, 0.0f);
     float lastFrame = 0.0f;
 
     bool isAimMode = false;
@@ -807,9 +418,175 @@ int main() {
     bool fPressed = false;
     bool showInfo = true;
     bool mPressed = false;  
+    bool f9Pressed = false;
+    bool f3Pressed = false;
+    bool f2Pressed = false;
+
+    JobSystem jobs;
+    std::cout << "Job system: " << jobs.WorkerCount() << " workers" << std::endl;
+
+    if (!textures.Build(jobs, program)) {
+        std::cerr << "Failed to create texture array" << std::endl;
+        return -1;
+    }
+
+    // Benchmark runs step the simulation inside the frame at a fixed
+    // timestep, so every run renders exactly the same frames. Recorded and
+    // replayed runs step it inside the frame too, from the frame times, so a
+    // replay reaches the same states as the recording.
+    bool lockstep = recorder.Active() || replay.Active();
+    FixedStepClock stepClock(options.tickRate);
+    int pendingDrops = 0;
+
+    SimulationThread simulation;
+    GameState prevState = initialState;
+    if (!options.benchmark && !lockstep) {
+        simulation.Start(initialState, options.tickRate, &jobs);
+        simulation.Snapshots().Update();
+        prevState = simulation.Snapshots().ReadBuffer().curr;
+    }
+    GameState currState = prevState;
+    GameState world = currState;
+
+    std::vector<char> houseVisible, sledVisible, packageVisible;
+    CullStats cullStats;
+
+    DrawList drawList;
+    drawList.Init(jobs.WorkerCount());
+    // Moving shadow casters, keyed by cascade and mesh; their instances
+    // follow the scene's in the same stream.
+    DrawList shadowList;
+    shadowList.Init(jobs.WorkerCount());
+
+    InstanceStream instanceStream;
+    instanceStream.Init();
+
+    const GameObject* batchMeshes[MESH_COUNT] = { &houseObj, &packageObj, &sledObj };
+    const char* batchPassNames[MESH_COUNT] = { "Houses", "Packages", "Sleds" };
+
+    RenderCounters renderCounters;
+    GpuFrameTimer gpuTimer;
+    BenchmarkResult benchResult;
+    int benchFrame = 0;
+    int benchFrameCount = options.frames + BENCH_WARMUP_FRAMES;
+    if (options.benchmark && replay.Active()) benchFrameCount = replay.Frames();
+    if (options.benchmark) {
+        gpuTimer.Init();
+        gpuTimer.KeepSamples(BENCH_WARMUP_FRAMES);
+    }
+
+    GpuPassTimer gpuPasses;
+    gpuPasses.Init();
+    if (options.benchmark) {
+        gpuPasses.KeepSamples(BENCH_WARMUP_FRAMES);
+    }
+
+    OverdrawView overdraw;
+    bool overdrawOn = false;
+    int overdrawFrames = 0;
+    auto setOverdraw = [&](bool on) {
+        if (on && !overdraw.Initialized() && !overdraw.Init(1280, 720)) return;
+        if (on && !gpuPasses.EnablePipelineStats(true)) return;
+        if (!on) gpuPasses.EnablePipelineStats(false);
+        overdrawOn = on;
+        overdrawFrames = 0;
+        glUniform1i(overdrawLoc, on ? 1 : 0);
+        LOG_INFO("Overdraw view: " << (on ? "ON" : "OFF"));
+    };
+    if (options.overdraw) setOverdraw(true);
+
+    StatsOverlay overlay;
+    bool overlayOn = false;
+    auto setOverlay = [&](bool on) {
+        if (on && !overlay.Initialized() && !overlay.Init(1280, 720)) return;
+        overlayOn = on;
+    };
+    if (options.overlay) setOverlay(true);
+
+    TemporalUpscaler upscaler;
+    bool upscaleOn = false;
+    if (options.dynres || options.renderScale > 0.0) {
+        float initialScale = options.renderScale > 0.0 ? static_cast<float>(options.renderScale) : 1.0f;
+        upscaleOn = upscaler.Init(1280, 720, initialScale, options.dynres, options.frameTarget);
+        if (!upscaleOn) std::cerr << "Temporal upscaling disabled" << std::endl;
+    }
+    double lastRenderMs = 0.0;
+
+    SnowSystem snow;
+    if (options.snow > 0 && !snow.Init(options.snow, 1.0f, 15000.0f)) {
+        std::cerr << "Snowfall disabled" << std::endl;
+    }
+
+    CloudLayer clouds;
+    if (options.clouds > 0 && !clouds.Init(options.clouds, load_texture("Clouds.png"), 1280, 720, 1.0f, 15000.0f)) {
+        std::cerr << "Clouds disabled" << std::endl;
+    }
+
+    SceneDepthCopy sceneDepth;
+    if (snow.Initialized() || clouds.Initialized()) sceneDepth.Init(1280, 720);
+
+    const glm::vec3 treeColor(0.3f, 0.6f, 0.2f);
+    TreeImpostors treeImpostors;
+    {
+        std::vector<Vertex> treeVertices;
+        generateTree(treeVertices);
+        if (!treeImpostors.Init(treeInstanced.vao, treeVertices, treeColor, options.impostorDistance)
+            && options.impostorDistance > 0.0f) {
+            std::cerr << "Tree impostors disabled" << std::endl;
+        }
+    }
+
+    const glm::vec3 lightDirection = glm::normalize(glm::vec3(0.2f, -0.4f, 0.2f));
+    StaticLights staticLights;
+    if (options.lightmaps || options.probes) {
+        BuildStaticLights(decor.lanternPositions, initialState.housePositions, staticLights);
+    }
+    StaticLightmaps lightmaps;
+    if (options.lightmaps) {
+        lightmaps.Build(jobs, staticLights, initialState.housePositions);
+    }
+    LightProbeGrid probes;
+    if (options.probes) {
+        probes.Init(jobs, staticLights);
+    }
+    // Only the bakes above trace against the occluders.
+    staticLights = StaticLights();
+    ShadowCascades shadows;
+    if (options.shadows && !shadows.Init(glm::radians(45.0f), 1280.0f / 720.0f, 1.0f, lightDirection, program)) {
+        std::cerr << "Sun shadows disabled" << std::endl;
+    }
+
+    glm::mat4 christmasTreeModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 200.0f));
+    christmasTreeModel = glm::rotate(christmasTreeModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    christmasTreeModel = glm::scale(christmasTreeModel, glm::vec3(400.0f, 400.0f, 400.0f));
+
+    // The setups above leave their own programs bound.
+    glUseProgram(program);
+    if (probes.Initialized()) {
+        glUniform1i(glGetUniformLocation(program, "useProbes"), 1);
+        glUniform3fv(glGetUniformLocation(program, "probeOrigin"), 1, glm::value_ptr(probes.Origin()));
+        glUniform3fv(glGetUniformLocation(program, "probeSpacing"), 1, glm::value_ptr(probes.Spacing()));
+        glUniform3fv(glGetUniformLocation(program, "probeCount"), 1, glm::value_ptr(probes.Count()));
+        glUniform2f(glGetUniformLocation(program, "exactRange"), PROBE_EXACT_NEAR, PROBE_EXACT_FAR);
+        treeImpostors.UseProbes(probes);
+        glUseProgram(program);
+    }
+
+    double replayStart = -1.0;
 
-    float gameTime = 0.0f;
-    int score = 0;
+    // Benchmarks and unthrottled replays measure the loop itself.
+    FramePacer pacer;
+    if (options.benchmark || (replay.Active() && options.replaySpeed == 0.0)) pacer.Init(PACE_OFF, 0.0, 0.0);
+    else pacer.Init(options.paceMode, options.fpsCap, options.idleFps);
+
+    // A replay already carries its mouse movement in the frame records.
+    bool lateLatch = options.lateLatch && !inputReplaying;
+    bool trackLatency = options.latency || options.frameQueue > 0;
+    frameLatency.Init(options.frameQueue);
+
+    int framesInWindow = 0;
+    float fpsWindowStart = 0.0f;
+    float renderFps = 0.0f;
 
     std::cout << "Starting winter game with mouse control..." << std::endl;
     std::cout << "=== CONTROLS ===" << std::endl;
@@ -821,308 +598,656 @@ int main() {
     std::cout << "F - toggle spotlight" << std::endl;
     std::cout << "Enter - drop package" << std::endl;
     std::cout << "M - alternative toggle mouse control" << std::endl;
+    std::cout << "F2 - performance overlay" << std::endl;
+    std::cout << "F3 - overdraw heat map and pipeline statistics" << std::endl;
+    std::cout << "F9 - write profiler trace" << std::endl;
     std::cout << "ESC - exit" << std::endl;
     std::cout << "=================" << std::endl;
 
     while (!glfwWindowShouldClose(window)) {
+        if (options.benchmark && benchFrame >= benchFrameCount) break;
+        double frameStart = pacer.Wait(window);
+
         float currentFrame = static_cast<float>(glfwGetTime());
         float deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        gameTime += deltaTime;
+        // The measured interval, for the overlay; the simulation and camera
+        // get the smoothed or replayed deltaTime below.
+        float frameInterval = deltaTime;
+
+        InputFrame frameInput;
+        if (replay.Active()) {
+            if (!replay.Next(frameInput)) break;
+            if (!options.benchmark && options.replaySpeed > 0.0) {
+                if (replayStart < 0.0) replayStart = frameStart;
+                double wait = replayStart + replay.Seconds() / options.replaySpeed - BenchSeconds();
+                if (wait > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            }
+            deltaTime = frameInput.dt;
+            mouseCaptured = frameInput.mouseCaptured;
+        }
+        else {
+            deltaTime = pacer.SmoothDelta(deltaTime);
+            frameInput.dt = deltaTime;
+            frameInput.keys = PollInputKeys(window);
+            frameInput.mouseCaptured = mouseCaptured;
+            camera.TakeMouseOffset(frameInput.mouseX, frameInput.mouseY);
+        }
+        if (recorder.Active()) recorder.Write(frameInput);
+        camera.ApplyMouseOffset(frameInput.mouseX, frameInput.mouseY);
+        frameLatency.Latch(INPUT_EVENT_KEY);
+        frameLatency.Latch(INPUT_EVENT_MOUSE);
+        bool latchView = lateLatch && mouseCaptured;
+
+        framesInWindow++;
+        if (currentFrame - fpsWindowStart >= 1.0f) {
+            renderFps = static_cast<float>(framesInWindow) / (currentFrame - fpsWindowStart);
+            framesInWindow = 0;
+            fpsWindowStart = currentFrame;
+        }
 
-        for (int i = 0; i < NUM_SLEDS; i++) {
-            sleds[i].angle += sleds[i].speed * deltaTime;
+        SimInput input;
+        {
+            PROFILE_SCOPE("Input");
+            if (frameInput.Held(GLFW_KEY_C) && !cPressed) {
+                isAimMode = !isAimMode;
+                upscaler.ResetHistory();
+                cPressed = true;
+                camera.pitch = isAimMode ? -10.0f : 25.0f;
+                LOG_INFO("Camera mode: " << (isAimMode ? "aiming" : "overview"));
+            }
+            if (!frameInput.Held(GLFW_KEY_C)) cPressed = false;
 
-            sleds[i].position.x = sin(sleds[i].angle) * sleds[i].radius;
-            sleds[i].position.z = cos(sleds[i].angle) * sleds[i].radius + 200.0f;
+            if (frameInput.Held(GLFW_KEY_F) && !fPressed) {
+                spotlightOn = !spotlightOn;
+                fPressed = true;
+                LOG_INFO("Spotlight: " << (spotlightOn ? "ON" : "OFF"));
+            }
+            if (!frameInput.Held(GLFW_KEY_F)) fPressed = false;
 
-            sleds[i].position.y = 20.0f + sin(gameTime * 2.0f + sleds[i].bobOffset) * 3.0f;
-        }
+            if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS && !f2Pressed) {
+                setOverlay(!overlayOn);
+                f2Pressed = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_RELEASE) f2Pressed = false;
 
-        if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cPressed) {
-            isAimMode = !isAimMode;
-            cPressed = true;
-            camera.pitch = isAimMode ? -10.0f : 25.0f;
-            std::cout << "Camera mode: " << (isAimMode ? "aiming" : "overview") << std::endl;
-        }
-        if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) cPressed = false;
+            if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS && !f3Pressed) {
+                setOverdraw(!overdrawOn);
+                f3Pressed = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_RELEASE) f3Pressed = false;
 
-        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !fPressed) {
-            spotlightOn = !spotlightOn;
-            fPressed = true;
-            std::cout << "Spotlight: " << (spotlightOn ? "ON" : "OFF") << std::endl;
-        }
-        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) fPressed = false;
+            if (frameInput.Held(GLFW_KEY_ENTER) && !enterPressed) {
+                if (lockstep) pendingDrops++;
+                else simulation.RequestDrop();
+                enterPressed = true;
+            }
+            if (!frameInput.Held(GLFW_KEY_ENTER)) enterPressed = false;
 
-        if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS && !enterPressed) {
-            Package newPackage;
-            newPackage.pos = isAimMode ? airshipPos + glm::vec3(0.0f, 20.0f, 0.0f) : airshipPos;
+            if (frameInput.Held(GLFW_KEY_M) && !mPressed) {
+                mouseCaptured = !mouseCaptured;
+                camera.ToggleMouseControl(mouseCaptured);
 
-            glm::vec3 shotDir = camera.GetForward();
-            if (!isAimMode) shotDir = -shotDir;
+                if (mouseCaptured) {
+                    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+                    LOG_INFO("Mouse control ENABLED (via M key)");
+                }
+                else {
+                    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+                    LOG_INFO("Mouse control DISABLED (via M key)");
+                }
+                mPressed = true;
+            }
+            if (!frameInput.Held(GLFW_KEY_M)) mPressed = false;
 
-            newPackage.dir = glm::normalize(shotDir);
-            newPackage.lifeTime = 6.0f;
-            newPackage.active = true;
-            newPackage.color = glm::vec3(1.0f, 0.9f, 0.3f);
+            if (!mouseCaptured) {
+                float lookSpeed = 80.0f * deltaTime;
+                if (frameInput.Held(GLFW_KEY_UP))    camera.pitch += lookSpeed;
+                if (frameInput.Held(GLFW_KEY_DOWN))  camera.pitch -= lookSpeed;
+                if (frameInput.Held(GLFW_KEY_LEFT))  camera.yaw += lookSpeed;
+                if (frameInput.Held(GLFW_KEY_RIGHT)) camera.yaw -= lookSpeed;
 
-            packages.push_back(newPackage);
-            enterPressed = true;
+                camera.pitch = std::max(-89.0f, std::min(89.0f, camera.pitch));
+            }
 
-            std::cout << "Package dropped! Total packages: " << packages.size() << std::endl;
+            input.forward = frameInput.Held(GLFW_KEY_W);
+            input.back = frameInput.Held(GLFW_KEY_S);
+            input.left = frameInput.Held(GLFW_KEY_A);
+            input.right = frameInput.Held(GLFW_KEY_D);
+            input.up = frameInput.Held(GLFW_KEY_SPACE);
+            input.down = frameInput.Held(GLFW_KEY_LEFT_SHIFT);
+            input.aimMode = isAimMode;
+            input.cameraForward = camera.GetForward();
+            if (options.benchmark && !lockstep) {
+                BenchmarkCameraPath(benchFrame, benchFrameCount, camera, isAimMode, input);
+            }
+            else if (!lockstep) {
+                simulation.SetInput(input);
+            }
         }
-        if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_RELEASE) enterPressed = false;
 
-        if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !mPressed) {
-            mouseCaptured = !mouseCaptured;
-            camera.ToggleMouseControl(mouseCaptured);
+        float gameTime = 0.0f;
+        glm::vec3 airshipPos;
+        glm::mat4 projection;
+        glm::mat4 view;
+        Frustum frustum;
+
+        TaskRef simulateTask = jobs.Create([&]() {
+            PROFILE_SCOPE("Simulate");
+            if (options.benchmark && !lockstep) {
+                StepSimulation(currState, input, BENCH_FRAME_DT, &jobs);
+                world = currState;
+            }
+            else if (lockstep) {
+                SimInput tickInput = input;
+                tickInput.dropRequests = pendingDrops;
+                int ticks = stepClock.Advance(deltaTime);
+                for (int t = 0; t < ticks; t++) {
+                    prevState = currState;
+                    StepSimulation(currState, tickInput, stepClock.TickDt(), &jobs);
+                    tickInput.dropRequests = 0;
+                }
+                if (ticks > 0) pendingDrops = 0;
+                InterpolateState(prevState, currState, stepClock.Alpha(), world);
+            }
+            else {
+                simulation.Snapshots().Update();
+                const SimSnapshot& snapshot = simulation.Snapshots().ReadBuffer();
+                InterpolateState(snapshot.prev, snapshot.curr, snapshot.Alpha(SimClockSeconds(), simulation.TickDt()), world);
+            }
 
-            if (mouseCaptured) {
-                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-                std::cout << "Mouse control ENABLED (via M key)" << std::endl;
+            gameTime = static_cast<float>(world.gameTime);
+            airshipPos = world.airshipPos;
+
+            projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 1.0f, 15000.0f);
+            view = isAimMode ? camera.GetViewAim(airshipPos) : camera.GetView(airshipPos);
+            if (latchView) {
+                glm::mat4 cullProjection = glm::perspective(glm::radians(45.0f + LATE_LATCH_CULL_MARGIN_DEGREES), 1280.0f / 720.0f, 1.0f, 15000.0f);
+                frustum.FromMatrix(cullProjection * view);
             }
             else {
-                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-                std::cout << "Mouse control DISABLED (via M key)" << std::endl;
+                frustum.FromMatrix(projection * view);
             }
-            mPressed = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE) mPressed = false;
+            if (shadows.Initialized()) shadows.Fit(view);
+        });
+
+        TaskRef cullTask = jobs.Create([&]() {
+            PROFILE_SCOPE("Cull");
+            houseVisible.assign(world.HouseCount(), 0);
+            sledVisible.assign(world.SledCount(), 0);
+            packageVisible.assign(world.packages.size(), 0);
+
+            jobs.ParallelFor(0, world.HouseCount(), CULL_GRAIN, [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    houseVisible[i] = frustum.ContainsSphere(world.housePositions[i], HOUSE_CULL_RADIUS);
+                }
+            });
+            jobs.ParallelFor(0, world.SledCount(), CULL_GRAIN, [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    sledVisible[i] = frustum.ContainsSphere(world.sleds[i].position, SLED_CULL_RADIUS);
+                }
+            });
+            jobs.ParallelFor(0, static_cast<int>(world.packages.size()), CULL_GRAIN, [&](int begin, int end) {
+                for (int k = begin; k < end; k++) {
+                    packageVisible[k] = world.packages[k].active && frustum.ContainsSphere(world.packages[k].pos, PACKAGE_CULL_RADIUS);
+                }
+            });
+            treeImpostors.Select(jobs, decor.treePositions, frustum, glm::vec3(glm::inverse(view)[3]));
+        });
+
+        auto sledModel = [&](int i) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), world.sleds[i].position);
+
+            float rotationAngle = world.sleds[i].angle + M_PI;
+            model = glm::rotate(model, rotationAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, sin(gameTime + world.sleds[i].bobOffset) * 0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+            return glm::scale(model, glm::vec3(2.0f, 2.0f, 2.0f));
+        };
+        auto packageModel = [&](int k) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), world.packages[k].pos);
+            return glm::scale(model, glm::vec3(6.0f, 6.0f, 6.0f));
+        };
 
-        if (!mouseCaptured) {
-            float lookSpeed = 80.0f * deltaTime;
-            if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)    camera.pitch += lookSpeed;
-            if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)  camera.pitch -= lookSpeed;
-            if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)  camera.yaw += lookSpeed;
-            if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) camera.yaw -= lookSpeed;
+        TaskRef buildTask = jobs.Create([&]() {
+            PROFILE_SCOPE("Build draw list");
+            drawList.Reset();
+
+            jobs.ParallelFor(0, world.HouseCount(), CULL_GRAIN, [&](int begin, int end) {
+                drawList.Record(jobs, [&](CommandBuffer& cb) {
+                    for (int i = begin; i < end; i++) {
+                        if (!houseVisible[i]) continue;
+
+                        glm::mat4 houseModel = glm::translate(glm::mat4(1.0f), world.housePositions[i]);
+                        houseModel = glm::scale(houseModel, glm::vec3(HOUSE_SCALE));
+                        glm::vec3 houseColor = world.houseNeedsDelivery[i] ? world.houseColors[i] : glm::vec3(0.4f, 0.4f, 0.4f);
+
+                        cb.Add(MakeDrawKey(MESH_HOUSE, MATERIAL_COLOR, MATERIAL_COUNT), houseModel, glm::vec4(houseColor, 1.0f),
+                            lightmaps.HouseRect(i));
+                    }
+                });
+            });
+
+            jobs.ParallelFor(0, world.SledCount(), CULL_GRAIN, [&](int begin, int end) {
+                drawList.Record(jobs, [&](CommandBuffer& cb) {
+                    for (int i = begin; i < end; i++) {
+                        if (!sledVisible[i]) continue;
+
+                        glm::vec3 sledColor;
+                        switch (i % 3) {
+                        case 0: sledColor = glm::vec3(0.8f, 0.2f, 0.2f); break;  
+                        case 1: sledColor = glm::vec3(0.2f, 0.8f, 0.2f); break;  
+                        case 2: sledColor = glm::vec3(0.2f, 0.2f, 0.8f); break;  
+                        }
+
+                        cb.Add(MakeDrawKey(MESH_SLED, MATERIAL_COLOR, MATERIAL_COUNT), sledModel(i), glm::vec4(sledColor, 1.0f));
+                    }
+                });
+            });
 
-            camera.pitch = std::max(-89.0f, std::min(89.0f, camera.pitch));
+            float pulse = 0.8f + 0.2f * sin(gameTime * 8.0f);
+            jobs.ParallelFor(0, static_cast<int>(world.packages.size()), CULL_GRAIN, [&](int begin, int end) {
+                drawList.Record(jobs, [&](CommandBuffer& cb) {
+                    for (int k = begin; k < end; k++) {
+                        if (!packageVisible[k]) continue;
+
+                        cb.Add(MakeDrawKey(MESH_PACKAGE, MATERIAL_COLOR, MATERIAL_COUNT), packageModel(k),
+                            glm::vec4(world.packages[k].color * pulse, 1.0f));
+                    }
+                });
+            });
+
+            // Culled against each cascade, not the view: off-screen sleds
+            // still throw shadows into it.
+            shadowList.Reset();
+            if (!shadows.Initialized()) return;
+            jobs.ParallelFor(0, world.SledCount(), CULL_GRAIN, [&](int begin, int end) {
+                shadowList.Record(jobs, [&](CommandBuffer& cb) {
+                    for (int i = begin; i < end; i++) {
+                        for (int c = 0; c < SHADOW_CASCADES; c++) {
+                            if (!shadows.InCascade(c, world.sleds[i].position, SLED_CULL_RADIUS)) continue;
+                            cb.Add(MakeDrawKey(c, MESH_SLED, MESH_COUNT), sledModel(i), glm::vec4(0.0f));
+                        }
+                    }
+                });
+            });
+            jobs.ParallelFor(0, static_cast<int>(world.packages.size()), CULL_GRAIN, [&](int begin, int end) {
+                shadowList.Record(jobs, [&](CommandBuffer& cb) {
+                    for (int k = begin; k < end; k++) {
+                        if (!world.packages[k].active) continue;
+                        for (int c = 0; c < SHADOW_CASCADES; c++) {
+                            if (!shadows.InCascade(c, world.packages[k].pos, PACKAGE_CULL_RADIUS)) continue;
+                            cb.Add(MakeDrawKey(c, MESH_PACKAGE, MESH_COUNT), packageModel(k), glm::vec4(0.0f));
+                        }
+                    }
+                });
+            });
+        });
+
+        jobs.AddDependency(cullTask, simulateTask);
+        jobs.AddDependency(buildTask, cullTask);
+        jobs.Submit(buildTask);
+        jobs.Submit(cullTask);
+        jobs.Submit(simulateTask);
+        {
+            PROFILE_SCOPE("Wait for jobs");
+            jobs.Wait(buildTask);
         }
 
-        for (auto& pkg : packages) {
-            if (!pkg.active) continue;
+        int instanceCount = 0;
+        {
+            PROFILE_SCOPE("Upload instances");
+            instanceCount = drawList.Finalize();
+            int shadowInstanceCount = shadowList.Finalize();
+            InstanceData* instances = instanceStream.Map(instanceCount + shadowInstanceCount);
+            drawList.Write(jobs, instances);
+            shadowList.Write(jobs, instances ? instances + instanceCount : nullptr);
+            instanceStream.Unmap();
+        }
 
-            pkg.pos += pkg.dir * 600.0f * deltaTime;
-            pkg.lifeTime -= deltaTime;
+        cullStats.tested = world.HouseCount() + world.SledCount() + static_cast<int>(world.packages.size());
+        cullStats.visible = instanceCount;
+
+        // Mouse movement that arrived while the frame was simulated and culled
+        // still makes it into the view; the culling frustum was widened for it.
+        Camera viewCamera = camera;
+        if (latchView) {
+            PROFILE_SCOPE("Late latch");
+            glfwPollEvents();
+            frameLatency.Latch(INPUT_EVENT_MOUSE);
+            viewCamera = camera.Latched();
+            view = isAimMode ? viewCamera.GetViewAim(airshipPos) : viewCamera.GetView(airshipPos);
+        }
 
-            if (pkg.lifeTime <= 0) {
-                pkg.active = false;
-                continue;
-            }
+        double renderStart = BenchSeconds();
+        {
+            PROFILE_SCOPE("Render");
+            renderCounters.Reset();
+            if (options.benchmark) gpuTimer.Begin();
 
-            for (int i = 0; i < NUM_HOUSES; i++) {
-                if (houseNeedsDelivery[i] && glm::distance(pkg.pos, housePositions[i]) < 40.0f) {
-                    houseNeedsDelivery[i] = false;
-                    pkg.active = false;
-                    score += 10;
-                    deliveriesCompleted++;
+            gpuPasses.BeginFrame();
 
-                    std::cout << "Hit house " << i << "! Score: " << score;
-                    std::cout << " Deliveries: " << deliveriesCompleted << "/" << NUM_HOUSES << std::endl;
-                    break;
-                }
+            glm::mat4 airshipModel = glm::translate(glm::mat4(1.0f), airshipPos);
+            airshipModel = glm::rotate(airshipModel, glm::radians(viewCamera.yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+            airshipModel = glm::rotate(airshipModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            airshipModel = glm::scale(airshipModel, glm::vec3(2.0f, 2.0f, 2.0f));
+
+            if (shadows.Initialized()) {
+                PROFILE_PASS(gpuPasses, "Shadows");
+                shadows.Render(program, renderCounters, [&](int cascade) {
+                    shadows.DrawMesh(terrain.vao, terrain.vertexCount, glm::mat4(1.0f));
+                    shadows.DrawMesh(tree.vao, tree.vertexCount, christmasTreeModel);
+                    shadows.DrawOffsets(lantern.vao, lantern.vertexCount, lanternCount);
+                    shadows.DrawOffsets(treeCasters.vao, treeCasters.vertexCount, treeCount);
+                    for (int i = 0; i < world.HouseCount(); i++) {
+                        if (!shadows.InCascade(cascade, world.housePositions[i], HOUSE_CULL_RADIUS)) continue;
+                        glm::mat4 houseModel = glm::translate(glm::mat4(1.0f), world.housePositions[i]);
+                        shadows.DrawMesh(houseObj.vao, houseObj.vertexCount, glm::scale(houseModel, glm::vec3(HOUSE_SCALE)));
+                    }
+                }, [&](int cascade) {
+                    for (const auto& batch : shadowList.Batches()) {
+                        if (static_cast<int>(batch.key / MESH_COUNT) != cascade) continue;
+                        const GameObject& mesh = *batchMeshes[batch.key % MESH_COUNT];
+                        instanceStream.Bind(mesh.vao, instanceCount + batch.firstInstance);
+                        shadows.DrawInstances(mesh.vao, mesh.vertexCount, batch.instanceCount);
+                    }
+                    if (!isAimMode && shadows.InCascade(cascade, airshipPos, AIRSHIP_SHADOW_RADIUS)) {
+                        shadows.DrawMesh(airship.vao, airship.vertexCount, airshipModel);
+                    }
+                });
+                shadows.Bind();
             }
 
-            if (pkg.pos.y < 30.0f) {
-                pkg.active = false;
+            bool upscaling = upscaleOn && !overdrawOn;
+            if (overdrawOn) {
+                overdraw.Begin();
+                upscaler.ResetHistory();
+            }
+            else if (upscaling) {
+                // A swap that waits for the display would read as render cost.
+                upscaler.BeginScene(pacer.SwapWaits() ? 0.0 : lastRenderMs);
+            }
+            {
+                PROFILE_PASS(gpuPasses, "Clear");
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glClearColor(0.05f, 0.08f, 0.12f, 1.0f); 
             }
-        }
 
-        packages.erase(std::remove_if(packages.begin(), packages.end(),
-            [](const Package& p) { return !p.active; }), packages.end());
+            frameUniforms.Write(view, upscaling ? upscaler.Jitter(projection) : projection);
 
-        for (int i = 0; i < NUM_HOUSES; i++) {
-            if (!houseNeedsDelivery[i]) {
-                houseDeliveryTimers[i] -= deltaTime;
-                if (houseDeliveryTimers[i] <= 0) {
-                    houseNeedsDelivery[i] = true;
-                    houseDeliveryTimers[i] = static_cast<float>(std::rand() % 10 + 8);
-                    std::cout << "House " << i << " needs delivery again!" << std::endl;
-                }
+            glUniform3f(lightDirLoc, lightDirection.x, lightDirection.y, lightDirection.z);
+            SelectLitLanterns(decor, airshipPos, litLanterns, probes.Initialized() ? PROBE_EXACT_LIGHTS : MAX_LIT_LANTERNS);
+            glUniform1i(lanternCountLoc, static_cast<int>(litLanterns.size()));
+            if (!litLanterns.empty()) {
+                glUniform3fv(lanternPosLoc, static_cast<int>(litLanterns.size()), glm::value_ptr(litLanterns[0]));
             }
-        }
 
-        float moveSpeed = 400.0f * deltaTime;
-        glm::vec3 camForward = camera.GetForward();
-        if (!isAimMode) camForward = -camForward;
-
-        glm::vec3 flatForward = glm::normalize(glm::vec3(camForward.x, 0.0f, camForward.z));
-        glm::vec3 flatRight = glm::normalize(glm::cross(flatForward, glm::vec3(0.0f, 1.0f, 0.0f)));
+            if (spotlightOnLoc != -1) glUniform1i(spotlightOnLoc, spotlightOn ? 1 : 0);
+            if (spotlightPosLoc != -1) glUniform3f(spotlightPosLoc, airshipPos.x, airshipPos.y, airshipPos.z);
+            if (spotlightDirLoc != -1) {
+                glm::vec3 spotDir = viewCamera.GetForward();
+                if (!isAimMode) spotDir = -spotDir;
+                glUniform3f(spotlightDirLoc, spotDir.x, spotDir.y, spotDir.z);
+            }
 
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) airshipPos += flatForward * moveSpeed;
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) airshipPos -= flatForward * moveSpeed;
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) airshipPos -= flatRight * moveSpeed;
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) airshipPos += flatRight * moveSpeed;
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) airshipPos.y += moveSpeed;
-        if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) airshipPos.y -= moveSpeed;
+            glUniform1i(isInstancedLoc, 0);
+            glUniform1i(normalTextureLoc, -1);
+
+            {
+                PROFILE_PASS(gpuPasses, "Terrain");
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+                glUniform4fv(lightmapRectLoc, 1, glm::value_ptr(lightmaps.TerrainRect()));
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, lightmaps.Texture());
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_3D, probes.Texture());
+                textures.Bind();
+                glUniform1i(albedoTextureLoc, terrain.texture);
+                glBindVertexArray(terrain.vao);
+                glDrawArrays(GL_TRIANGLES, 0, terrain.vertexCount); 
+                renderCounters.Add(terrain.vertexCount);
+            }
 
-        airshipPos.y = std::max(50.0f, std::min(1000.0f, airshipPos.y));
+            {
+                PROFILE_PASS(gpuPasses, "Snow circle");
+                glUniform1i(albedoTextureLoc, -1);
+                glUniform3f(baseColorLoc, 0.95f, 0.97f, 1.0f);  
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+                glBindVertexArray(snowCircle.vao);
+                glDrawArrays(GL_TRIANGLES, 0, snowCircle.vertexCount);  
+                renderCounters.Add(snowCircle.vertexCount);
+                glUniform4f(lightmapRectLoc, 0.0f, 0.0f, 0.0f, 0.0f);
+            }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glClearColor(0.05f, 0.08f, 0.12f, 1.0f); 
+            {
+                PROFILE_PASS(gpuPasses, "Christmas tree");
+                glUniform1i(albedoTextureLoc, tree.texture);
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(christmasTreeModel));
+                glBindVertexArray(tree.vao);
+                glDrawArrays(GL_TRIANGLES, 0, tree.vertexCount); 
+                renderCounters.Add(tree.vertexCount);
+            }
 
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 1.0f, 15000.0f);
-        glm::mat4 view = isAimMode ? camera.GetViewAim(airshipPos) : camera.GetView(airshipPos);
+            {
+                PROFILE_PASS(gpuPasses, "Lanterns");
+                glUniform1i(isInstancedLoc, 1);
+                glUniform1i(albedoTextureLoc, -1);
+                glUniform3f(baseColorLoc, 0.9f, 0.9f, 0.8f);
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+                glBindVertexArray(lantern.vao);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, lantern.vertexCount, lanternCount);  
+                renderCounters.Add(lantern.vertexCount, lanternCount);
+            }
 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+            {
+                PROFILE_PASS(gpuPasses, "Trees");
+                glUniform1i(isInstancedLoc, 1);
+                glUniform3f(baseColorLoc, treeColor.x, treeColor.y, treeColor.z);
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+                treeImpostors.BindNear(treeInstanced.vao);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, treeInstanced.vertexCount, treeImpostors.NearCount());
+                renderCounters.Add(treeInstanced.vertexCount, treeImpostors.NearCount());
+            }
 
-        glm::vec3 lightDirection = glm::normalize(glm::vec3(0.2f, -0.4f, 0.2f));
-        glUniform3f(lightDirLoc, lightDirection.x, lightDirection.y, lightDirection.z);
-        glUniform3fv(lanternPosLoc, NUM_LANTERNS, glm::value_ptr(lanternPositions[0]));
-        glUniform1f(timeLoc, gameTime);
+            if (treeImpostors.FarCount() > 0) {
+                PROFILE_PASS(gpuPasses, "Tree impostors");
+                treeImpostors.Draw(glm::vec3(glm::inverse(view)[3]), lightDirection, shadows, overdrawOn, program);
+                renderCounters.Add(4, treeImpostors.FarCount());
+            }
 
-        if (spotlightOnLoc != -1) glUniform1i(spotlightOnLoc, spotlightOn ? 1 : 0);
-        if (spotlightPosLoc != -1) glUniform3f(spotlightPosLoc, airshipPos.x, airshipPos.y, airshipPos.z);
-        if (spotlightDirLoc != -1) {
-            glm::vec3 spotDir = camera.GetForward();
-            if (!isAimMode) spotDir = -spotDir;
-            glUniform3f(spotlightDirLoc, spotDir.x, spotDir.y, spotDir.z);
-        }
+            glUniform1i(isInstancedLoc, 0);
+            glUniform1i(useInstanceDataLoc, 1);
 
-        glUniform1i(isCloudLoc, 0);
-        glUniform1i(isInstancedLoc, 0);
-        glUniform1i(useTextureLoc, 1);
-        glUniform1i(useNormalMapLoc, 0);
-
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, terrain.texture);
-        glBindVertexArray(terrain.vao);
-        glDrawArrays(GL_TRIANGLES, 0, terrain.vertexCount); 
-
-        glUniform1i(useTextureLoc, 0);
-        glUniform3f(baseColorLoc, 0.95f, 0.97f, 1.0f);  
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
-        glBindVertexArray(snowCircle.vao);
-        glDrawArrays(GL_TRIANGLES, 0, snowCircle.vertexCount);  
-
-        glUniform1i(useTextureLoc, 1);
-        glm::mat4 treeModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 200.0f));
-        treeModel = glm::rotate(treeModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        treeModel = glm::scale(treeModel, glm::vec3(400.0f, 400.0f, 400.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(treeModel));
-        glBindTexture(GL_TEXTURE_2D, tree.texture);
-        glBindVertexArray(tree.vao);
-        glDrawArrays(GL_TRIANGLES, 0, tree.vertexCount); 
-
-        glUniform1i(isInstancedLoc, 1);
-        glUniform1i(useTextureLoc, 0);
-        glUniform3f(baseColorLoc, 0.9f, 0.9f, 0.8f);
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
-        glBindVertexArray(lantern.vao);
-        glDrawArraysInstanced(GL_TRIANGLES, 0, lantern.vertexCount, NUM_LANTERNS);  
-
-        glUniform1i(isInstancedLoc, 0);
-        glUniform3f(baseColorLoc, 0.7f, 0.7f, 0.7f);
-
-        for (int i = 0; i < NUM_HOUSES; i++) {
-            glm::mat4 houseModel = glm::translate(glm::mat4(1.0f), housePositions[i]);
-            houseModel = glm::scale(houseModel, glm::vec3(30.0f, 30.0f, 30.0f));
-
-            if (houseNeedsDelivery[i]) {
-                glUniform3f(baseColorLoc, houseColors[i].r, houseColors[i].g, houseColors[i].b);
-            }
-            else {
-                glUniform3f(baseColorLoc, 0.4f, 0.4f, 0.4f);
+            for (const auto& batch : drawList.Batches()) {
+                PROFILE_PASS(gpuPasses, batchPassNames[batch.key / MATERIAL_COUNT]);
+                const GameObject& mesh = *batchMeshes[batch.key / MATERIAL_COUNT];
+                instanceStream.Bind(mesh.vao, batch.firstInstance);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.vertexCount, batch.instanceCount);
+                renderCounters.Add(mesh.vertexCount, batch.instanceCount);
             }
 
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(houseModel));
-            glBindVertexArray(houseObj.vao);
-            glDrawArrays(GL_TRIANGLES, 0, houseObj.vertexCount);  
-        }
-
-        glUniform1i(isInstancedLoc, 1);
-        glUniform3f(baseColorLoc, 0.3f, 0.6f, 0.2f);
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
-        glBindVertexArray(treeInstanced.vao);
-        glDrawArraysInstanced(GL_TRIANGLES, 0, treeInstanced.vertexCount, NUM_TREES);  
+            glUniform1i(useInstanceDataLoc, 0);
 
-        glUniform1i(isInstancedLoc, 0);
-        glBindVertexArray(packageObj.vao);
+            if (!isAimMode) {
+                PROFILE_PASS(gpuPasses, "Airship");
+                glUniform1i(albedoTextureLoc, airship.texture);
+                glUniform1i(normalTextureLoc, airship.normalMap);
+                glUniform3f(baseColorLoc, 1.0f, 1.0f, 1.0f);
 
-        for (const auto& pkg : packages) {
-            if (!pkg.active) continue;
+                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(airshipModel));
+                glBindVertexArray(airship.vao);
+                glDrawArrays(GL_TRIANGLES, 0, airship.vertexCount); 
+                renderCounters.Add(airship.vertexCount);
+            }
 
-            glm::mat4 packageModel = glm::translate(glm::mat4(1.0f), pkg.pos);
-            packageModel = glm::scale(packageModel, glm::vec3(6.0f, 6.0f, 6.0f));
+            if ((snow.Initialized() || clouds.Initialized()) && !overdrawOn) {
+                unsigned int sceneTarget = upscaling ? upscaler.SceneFramebuffer() : offscreenTarget.Framebuffer();
+                int sceneWidth = upscaling ? upscaler.RenderWidth() : 1280;
+                int sceneHeight = upscaling ? upscaler.RenderHeight() : 720;
+                {
+                    PROFILE_PASS(gpuPasses, "Depth copy");
+                    sceneDepth.Copy(sceneTarget, sceneWidth, sceneHeight);
+                }
+                if (clouds.Initialized()) {
+                    PROFILE_PASS(gpuPasses, "Clouds");
+                    clouds.Draw(sceneTarget, sceneWidth, sceneHeight, view, sceneDepth, gameTime, program);
+                }
+                if (snow.Initialized()) {
+                    {
+                        PROFILE_PASS(gpuPasses, "Snow update");
+                        snow.Update(gameTime, glm::vec3(glm::inverse(view)[3]));
+                    }
+                    PROFILE_PASS(gpuPasses, "Snow");
+                    snow.Draw(sceneDepth, program);
+                }
+            }
 
-            float pulse = 0.8f + 0.2f * sin(gameTime * 8.0f);
-            glUniform3f(baseColorLoc, pkg.color.r * pulse, pkg.color.g * pulse, pkg.color.b * pulse);
+            if (upscaling) {
+                PROFILE_PASS(gpuPasses, "Upscale");
+                upscaler.Resolve(offscreenTarget.Framebuffer(), view, projection, program);
+            }
 
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(packageModel));
-            glDrawArrays(GL_TRIANGLES, 0, packageObj.vertexCount);  
-        }
+            if (overdrawOn) {
+                overdraw.Resolve(offscreenTarget.Framebuffer(), program);
+                if (++overdrawFrames % OVERDRAW_REPORT_FRAMES == 0) {
+                    gpuPasses.PrintPipelineStats(overdraw.Pixels());
+                    std::cout << "Fragments per pixel after depth test: " << overdraw.AverageFragmentsPerPixel() << std::endl;
+                }
+            }
 
-        glUniform1i(useTextureLoc, 0);
+            if (overlayOn) {
+                OverlayFrame overlayFrame;
+                overlayFrame.frameMs = frameInterval * 1000.0;
+                overlayFrame.drawCalls = renderCounters.drawCalls;
+                overlayFrame.triangles = renderCounters.triangles;
+                overlayFrame.packages = static_cast<int>(world.packages.size());
+                // The Christmas tree and the airship on top of the per-type counts.
+                overlayFrame.entities = world.HouseCount() + world.SledCount() + overlayFrame.packages + treeCount + lanternCount + 2;
+                overlayFrame.visible = cullStats.visible;
+                overlayFrame.tested = cullStats.tested;
+                if (upscaling) {
+                    overlayFrame.renderWidth = upscaler.RenderWidth();
+                    overlayFrame.renderHeight = upscaler.RenderHeight();
+                }
 
-        for (int i = 0; i < NUM_SLEDS; i++) {
-            glm::vec3 sledColor;
-            switch (i % 3) {
-            case 0: sledColor = glm::vec3(0.8f, 0.2f, 0.2f); break;  
-            case 1: sledColor = glm::vec3(0.2f, 0.8f, 0.2f); break;  
-            case 2: sledColor = glm::vec3(0.2f, 0.2f, 0.8f); break;  
+                PROFILE_PASS(gpuPasses, "Overlay");
+                overlay.Draw(overlayFrame, program);
             }
+            gpuPasses.EndFrame();
+        }
 
-            glUniform3f(baseColorLoc, sledColor.r, sledColor.g, sledColor.b);
+        if (showInfo && gameTime > 5.0f && gameTime < 5.1f) {
+            PROFILE_SCOPE("Info print");
+            LOG_INFO("\n=== WINTER AIRSHIP DELIVERY ===\n"
+                << "Score: " << world.score << " | Deliveries: " << world.deliveriesCompleted << "/" << world.HouseCount() << "\n"
+                << "Time: " << static_cast<int>(gameTime) << " sec\n"
+                << "Active packages: " << world.packages.size() << "\n"
+                << "Sleds circling the tree: " << world.SledCount() << "\n"
+                << "Airship position: (" << static_cast<int>(airshipPos.x) << ", "
+                << static_cast<int>(airshipPos.y) << ", " << static_cast<int>(airshipPos.z) << ")\n"
+                << "Camera angles: pitch=" << camera.pitch << ", yaw=" << camera.yaw << "\n"
+                << "Mouse control: " << (mouseCaptured ? "ENABLED" : "DISABLED") << "\n"
+                << "Simulation: " << simulation.TicksPerSecond() << " ticks/s, "
+                << simulation.AverageStepMs() << " ms/tick\n"
+                << "Render: " << renderFps << " fps, " << cullStats.visible << "/" << cullStats.tested << " objects visible");
+        }
 
-            glm::mat4 sledModel = glm::translate(glm::mat4(1.0f), sleds[i].position);
+        if (options.benchmark) gpuTimer.End();
 
-            float rotationAngle = sleds[i].angle + M_PI;
-            sledModel = glm::rotate(sledModel, rotationAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+        {
+            PROFILE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        lastRenderMs = (BenchSeconds() - renderStart) * 1000.0;
+        if (trackLatency) frameLatency.EndFrame();
+        {
+            PROFILE_SCOPE("PollEvents");
+            glfwPollEvents();
+        }
 
-            sledModel = glm::rotate(sledModel, sin(gameTime + sleds[i].bobOffset) * 0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+        PROFILE_COUNTER("Packages", world.packages.size());
+        PROFILE_COUNTER("Draw calls", renderCounters.drawCalls);
+        PROFILE_COUNTER("Triangles", renderCounters.triangles);
+        PROFILE_COUNTER("Visible objects", cullStats.visible);
+        PROFILE_FRAME();
+
+        if (options.benchmark) {
+            if (benchFrame >= BENCH_WARMUP_FRAMES) {
+                benchResult.cpuMs.push_back((BenchSeconds() - frameStart) * 1000.0);
+                benchResult.drawCalls.push_back(renderCounters.drawCalls);
+                benchResult.triangles.push_back(static_cast<double>(renderCounters.triangles));
+            }
+            benchFrame++;
+        }
 
-            sledModel = glm::scale(sledModel, glm::vec3(2.0f, 2.0f, 2.0f));
+        if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS && !f9Pressed) {
+            Profiler::Get().WriteTrace(options.trace.empty() ? "trace.json" : options.trace);
+            f9Pressed = true;
+        }
+        if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_RELEASE) f9Pressed = false;
 
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(sledModel));
-            glBindVertexArray(sledObj.vao);
-            glDrawArrays(GL_TRIANGLES, 0, sledObj.vertexCount);  
+        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+            glfwSetWindowShouldClose(window, GL_TRUE);
         }
+    }
 
-        if (!isAimMode) {
-            glUniform1i(useTextureLoc, 1);
-            glUniform1i(useNormalMapLoc, 1);
-            glUniform3f(baseColorLoc, 1.0f, 1.0f, 1.0f);
+    if (!options.trace.empty()) {
+        Profiler::Get().WriteTrace(options.trace);
+    }
 
-            glm::mat4 airshipModel = glm::translate(glm::mat4(1.0f), airshipPos);
-            airshipModel = glm::rotate(airshipModel, glm::radians(camera.yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-            airshipModel = glm::rotate(airshipModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            airshipModel = glm::scale(airshipModel, glm::vec3(2.0f, 2.0f, 2.0f));
+    simulation.Stop();
+    recorder.Close();
+    Logger::Get().Flush();
+    if (trackLatency) {
+        frameLatency.Finish();
+        if (options.latency) frameLatency.PrintReport();
+    }
+    if (options.pacing) pacer.PrintReport();
+    if (!options.benchmark && !lockstep) {
+        simulation.Snapshots().Update();
+        currState = simulation.Snapshots().ReadBuffer().curr;
+    }
 
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(airshipModel));
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, airship.texture);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, airship.normalMap);
-            glBindVertexArray(airship.vao);
-            glDrawArrays(GL_TRIANGLES, 0, airship.vertexCount); 
+    if (options.benchmark) {
+        gpuTimer.Flush();
+        gpuPasses.Flush();
+        if (overdrawOn) {
+            gpuPasses.PrintPipelineStats(overdraw.Pixels());
+            std::cout << "Fragments per pixel after depth test: " << overdraw.AverageFragmentsPerPixel() << std::endl;
         }
 
-        if (showInfo && gameTime > 5.0f && gameTime < 5.1f) {
-            std::cout << "\n=== WINTER AIRSHIP DELIVERY ===\n";
-            std::cout << "Score: " << score << " | Deliveries: " << deliveriesCompleted << "/" << NUM_HOUSES << "\n";
-            std::cout << "Time: " << static_cast<int>(gameTime) << " sec\n";
-            std::cout << "Active packages: " << packages.size() << "\n";
-            std::cout << "Sleds circling the tree: " << NUM_SLEDS << "\n";
-            std::cout << "Airship position: (" << static_cast<int>(airshipPos.x) << ", "
-                << static_cast<int>(airshipPos.y) << ", " << static_cast<int>(airshipPos.z) << ")\n";
-            std::cout << "Camera angles: pitch=" << camera.pitch << ", yaw=" << camera.yaw << "\n";
-            std::cout << "Mouse control: " << (mouseCaptured ? "ENABLED" : "DISABLED") << "\n";
-        }
+        benchResult.seed = seed;
+        benchResult.frames = static_cast<int>(benchResult.cpuMs.size());
+        benchResult.width = 1280;
+        benchResult.height = 720;
+        benchResult.offscreen = options.offscreen;
+        benchResult.scene = options.scene;
+        benchResult.replay = options.replay;
+        benchResult.snow = snow.Initialized() ? options.snow : 0;
+        benchResult.clouds = clouds.Initialized() ? options.clouds : 0;
+        benchResult.gpuMs = gpuTimer.samplesMs;
+        benchResult.gpuDroppedFrames = gpuTimer.droppedFrames;
+        benchResult.gpuPassMs = gpuPasses.samplesMs;
+        benchResult.gpuPassDroppedFrames = gpuPasses.droppedFrames;
+        benchResult.gpuPassOverflows = gpuPasses.overflowPasses;
+
+        PrintBenchmarkSummary(benchResult);
+        glfwTerminate();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (!WriteBenchmarkJson(options.benchOut, benchResult)) return -1;
+        std::cout << "Results written to " << options.benchOut << std::endl;
 
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window, GL_TRUE);
+        if (!options.baseline.empty()) {
+            int exceeded = CheckBenchmarkBaseline(options.baseline, benchResult);
+            if (exceeded != 0) return exceeded < 0 ? -1 : 2;
+            std::cout << "All budgets met" << std::endl;
         }
+        return 0;
     }
 
     std::cout << "\n=== GAME OVER ===\n";
-    std::cout << "Final score: " << score << " points\n";
-    std::cout << "Deliveries completed: " << deliveriesCompleted << " of " << NUM_HOUSES << "\n";
-    std::cout << "Total time: " << static_cast<int>(gameTime) << " seconds\n";
+    std::cout << "Final score: " << currState.score << " points\n";
+    std::cout << "Deliveries completed: " << currState.deliveriesCompleted << " of " << currState.HouseCount() << "\n";
+    std::cout << "Total time: " << static_cast<int>(currState.gameTime) << " seconds\n";
     std::cout << "Sleds completed their circles!\n";
 
     glfwTerminate();
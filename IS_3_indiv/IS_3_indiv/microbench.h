@@ -0,0 +1,245 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "alloccount.h"
+#include "benchmarks.h"
+#include "geometry.h"
+#include "heightfield.h"
+#include "jobsystem.h"
+#include "simulation.h"
+#include "stb_image.h"
+
+// Each case runs for at least this long, and at least once.
+const double MICRO_MIN_SECONDS = 0.2;
+const long long MICRO_MAX_PACKAGES = 1000000;
+const float MICRO_SIM_DT = 1.0f / 120.0f;
+
+// Time and heap allocations per call of one benchmark case.
+struct MicroSample {
+    double seconds = 0.0;
+    double allocations = 0.0;
+};
+
+// `setup` runs before every call and is not measured, so cases that consume
+// their input can rebuild it.
+inline MicroSample MeasureMicro(const std::function<void()>& setup, const std::function<void()>& call) {
+    MicroSample sample;
+    double measured = 0.0;
+    unsigned long long allocations = 0;
+    int calls = 0;
+
+    while (calls == 0 || measured < MICRO_MIN_SECONDS) {
+        if (setup) setup();
+        unsigned long long before = AllocationCount();
+        double start = BenchSeconds();
+        call();
+        measured += BenchSeconds() - start;
+        allocations += AllocationCount() - before;
+        calls++;
+    }
+
+    sample.seconds = measured / calls;
+    sample.allocations = static_cast<double>(allocations) / calls;
+    return sample;
+}
+
+// One line per case: time per call, then whichever throughputs apply.
+inline void PrintMicro(const std::string& name, long long size, const char* unit, const MicroSample& s, double bytes = 0.0) {
+    std::cout << name << " " << size << " " << unit << ": " << s.seconds * 1000.0 << " ms/call";
+    if (bytes > 0.0) std::cout << ", " << bytes / s.seconds / 1e6 << " MB/s";
+    std::cout << ", " << size / s.seconds / 1e6 << " M " << unit << "/s";
+    if (ALLOC_COUNTING) std::cout << ", " << s.allocations << " allocs/call";
+    std::cout << std::endl;
+}
+
+// first, 10 * first, ... up to last.
+inline std::vector<long long> MicroSizes(long long first, long long last) {
+    std::vector<long long> sizes;
+    for (long long n = first; n <= last; n *= 10) sizes.push_back(n);
+    return sizes;
+}
+
+// Writes a grid of textured, lit triangles that load_obj expands to about
+// `vertexCount` vertices. Returns the file size in bytes.
+inline long long WriteMicroObj(const std::string& path, long long vertexCount) {
+    int side = std::max(2, static_cast<int>(std::sqrt(static_cast<double>(vertexCount) / 6.0)) + 1);
+
+    std::ofstream out(path);
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            out << "v " << x << " " << std::sin(x * 0.1f + z * 0.2f) << " " << z << "\n";
+            out << "vt " << x / static_cast<float>(side) << " " << z / static_cast<float>(side) << "\n";
+            out << "vn 0 1 0\n";
+        }
+    }
+
+    long long written = 0;
+    for (int z = 0; z + 1 < side && written < vertexCount; z++) {
+        for (int x = 0; x + 1 < side && written < vertexCount; x++) {
+            int a = z * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+            out << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+            out << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+            written += 6;
+        }
+    }
+    return static_cast<long long>(out.tellp());
+}
+
+// Random triangles with well-formed UVs for computeTangents.
+inline void MakeMicroTriangles(long long vertexCount, std::vector<Vertex>& out) {
+    SimRandom rng;
+    rng.Seed(1234);
+    out.resize(static_cast<size_t>(vertexCount / 3 * 3));
+    for (size_t i = 0; i < out.size(); i++) {
+        Vertex& v = out[i];
+        v.position = glm::vec3(rng.Range(1000), rng.Range(1000), rng.Range(1000)) * 0.01f;
+        v.texCoords = glm::vec2(i % 3 == 1 ? 1.0f : 0.0f, i % 3 == 2 ? 1.0f : 0.0f);
+        v.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        v.tangent = glm::vec3(0.0f);
+        v.type = 0.0f;
+    }
+}
+
+// A classic world with `count` packages in flight at random positions, all
+// falling towards the village, for one StepSimulation tick.
+inline void MakeMicroPackages(long long count, GameState& state) {
+    InitGameState(state, 1);
+    state.packages.resize(static_cast<size_t>(count));
+    for (long long i = 0; i < count; i++) {
+        Package& p = state.packages[i];
+        p.id = state.nextPackageId++;
+        p.pos = glm::vec3(state.rng.Range(4000) - 2000.0f, 50.0f + state.rng.Range(400), state.rng.Range(4000) - 2000.0f);
+        p.velocity = glm::vec3(state.rng.Range(600) - 300.0f, -static_cast<float>(state.rng.Range(300)), state.rng.Range(600) - 300.0f);
+        p.lifeTime = static_cast<float>(state.rng.Range(5));
+        p.active = true;
+        p.color = glm::vec3(1.0f);
+    }
+}
+
+// Keeps load_obj's per-file report out of the results.
+struct MuteStdout {
+    MuteStdout() { std::cout.setstate(std::ios::failbit); }
+    ~MuteStdout() { std::cout.clear(); }
+};
+
+// Asset and geometry hot paths in isolation, on synthetic inputs from 1K
+// vertices up to `maxVertices` and from 10 to 1M packages. Texture decoding
+// uses the PNGs shipped with the game; the GL upload in load_texture is left
+// out, so nothing here needs a GL context.
+inline int RunMicroBenchmarks(long long maxVertices) {
+    std::cout << "=== MICRO BENCHMARKS (up to " << maxVertices << " vertices) ===" << std::endl;
+    std::vector<long long> vertexSizes = MicroSizes(1000, maxVertices);
+
+    {
+        const std::string path = "microbench.obj";
+        for (long long n : vertexSizes) {
+            long long bytes = WriteMicroObj(path, n);
+            std::vector<Vertex> mesh;
+            MicroSample s = MeasureMicro([&mesh]() { mesh.clear(); mesh.shrink_to_fit(); }, [&]() {
+                MuteStdout mute;
+                load_obj(path, mesh);
+            });
+            PrintMicro("load_obj", static_cast<long long>(mesh.size()), "vertices", s, static_cast<double>(bytes));
+        }
+        std::remove(path.c_str());
+    }
+
+    for (long long n : vertexSizes) {
+        std::vector<Vertex> mesh;
+        MakeMicroTriangles(n, mesh);
+        MicroSample s = MeasureMicro(nullptr, [&mesh]() { computeTangents(mesh); });
+        PrintMicro("computeTangents", static_cast<long long>(mesh.size()), "vertices", s,
+            static_cast<double>(mesh.size() * sizeof(Vertex)));
+    }
+
+    for (long long n : vertexSizes) {
+        int grid = std::max(2, static_cast<int>(std::sqrt(static_cast<double>(n) / 6.0)) + 1);
+        HeightField field;
+        field.width = grid;
+        field.height = grid;
+        field.cellSize = TERRAIN_SIZE / static_cast<float>(grid);
+        field.originX = field.originZ = -0.5f * TERRAIN_SIZE;
+        field.heights.assign(static_cast<size_t>(grid) * grid, 0.0f);
+        for (int z = 0; z < grid; z++) {
+            for (int x = 0; x < grid; x++) field.heights[z * grid + x] = 30.0f * std::sin(x * 0.1f) * std::cos(z * 0.1f);
+        }
+
+        std::vector<Vertex> mesh;
+        MicroSample s = MeasureMicro([&mesh]() { mesh.clear(); mesh.shrink_to_fit(); },
+            [&]() { BuildTerrainMesh(field, mesh); });
+        PrintMicro("generateTerrain", static_cast<long long>(mesh.size()), "vertices", s);
+    }
+
+    for (long long n : vertexSizes) {
+        int sectors = std::max(3, static_cast<int>(std::sqrt(static_cast<double>(n) / 6.0)));
+        std::vector<Vertex> mesh;
+        MicroSample s = MeasureMicro([&mesh]() { mesh.clear(); mesh.shrink_to_fit(); },
+            [&]() { generateSphere(mesh, 1.0f, sectors, sectors, 1.0f); });
+        PrintMicro("generateSphere", static_cast<long long>(mesh.size()), "vertices", s);
+    }
+
+    {
+        std::vector<Vertex> one;
+        generateTree(one);
+        for (long long n : vertexSizes) {
+            long long trees = std::max(1LL, n / static_cast<long long>(one.size()));
+            std::vector<Vertex> mesh;
+            MicroSample s = MeasureMicro([&mesh]() { mesh.clear(); mesh.shrink_to_fit(); }, [&]() {
+                for (long long t = 0; t < trees; t++) generateTree(mesh);
+            });
+            PrintMicro("generateTree x" + std::to_string(trees), static_cast<long long>(mesh.size()), "vertices", s);
+        }
+    }
+
+    {
+        const char* textures[] = { "shar.png", "ChrTree.png", "shar_displacement.png", "Clouds.png", "Field.png" };
+        stbi_set_flip_vertically_on_load(true);
+        for (const char* path : textures) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) {
+                std::cerr << "Micro benchmark: missing texture " << path << std::endl;
+                continue;
+            }
+            double bytes = static_cast<double>(file.tellg());
+
+            int w = 0, h = 0, ch = 0;
+            MicroSample s = MeasureMicro(nullptr, [&]() {
+                unsigned char* data = stbi_load(path, &w, &h, &ch, 0);
+                stbi_image_free(data);
+            });
+            PrintMicro(std::string("load_texture ") + path, static_cast<long long>(w) * h, "pixels", s, bytes);
+        }
+    }
+
+    {
+        bool logging = SimEventLogging();
+        SimEventLogging() = false;
+        JobSystem jobs;
+        SimInput input;
+        GameState base, state;
+
+        for (long long n : MicroSizes(10, MICRO_MAX_PACKAGES)) {
+            MakeMicroPackages(n, base);
+            MicroSample serial = MeasureMicro([&]() { state = base; },
+                [&]() { StepSimulation(state, input, MICRO_SIM_DT); });
+            PrintMicro("collision serial", n, "packages", serial);
+            MicroSample parallel = MeasureMicro([&]() { state = base; },
+                [&]() { StepSimulation(state, input, MICRO_SIM_DT, &jobs); });
+            PrintMicro("collision jobs", n, "packages", parallel);
+        }
+        SimEventLogging() = logging;
+    }
+    return 0;
+}
+
+#endif
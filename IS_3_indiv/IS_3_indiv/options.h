@@ -0,0 +1,344 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "framepacer.h"
+#include "log.h"
+#include "scene.h"
+
+struct Options {
+    bool benchJobs = false;
+    bool testJobs = false;
+    bool benchMicro = false;
+    long long microMax = 1000000;
+
+    bool benchmark = false;
+    int frames = 1200;
+    std::string benchOut = "benchmark.json";
+    std::string baseline;
+    std::string offscreen = "egl";
+
+    bool headless = false;
+    bool seedSet = false;
+    unsigned int seed = 0;
+    long long ticks = 0;
+    double simSeconds = 0.0;
+    float tickRate = 120.0f;
+    std::string script;
+    std::string bot;
+    bool verbose = false;
+    int batch = 0;
+    bool batchCheck = false;
+
+    std::string trace;
+    bool overdraw = false;
+    bool overlay = false;
+
+    std::string record;
+    std::string replay;
+    double replaySpeed = 1.0;
+    std::string logFile;
+    int logLevel = LOG_LEVEL_INFO;
+    bool latency = false;
+    bool lateLatch = true;
+    int frameQueue = 0;
+    int paceMode = PACE_VSYNC;
+    double fpsCap = 60.0;
+    double idleFps = 10.0;
+    bool pacing = false;
+    bool dynres = false;
+    double renderScale = 0.0;
+    double frameTarget = 16.7;
+    int snow = 0;
+    int clouds = 0;
+    float impostorDistance = 60.0f;
+    bool lightmaps = true;
+    bool probes = true;
+    bool shadows = true;
+
+    SceneConfig scene;
+};
+
+inline void PrintUsage() {
+    std::cout << "Usage: IS_3_indiv [options]\n";
+    std::cout << "  --seed N          world seed (default: current time)\n";
+    std::cout << "  --bench-jobs      run the job system benchmark and exit\n";
+    std::cout << "  --test-jobs       run the job system self-test; exit code 1 on failure\n";
+    std::cout << "  --bench-micro     run the asset and geometry micro benchmarks and exit\n";
+    std::cout << "  --micro-max N     micro benchmarks: largest vertex count (default 1000000)\n";
+    std::cout << "  --benchmark       render a scripted flight at a fixed timestep and write JSON\n";
+    std::cout << "  --frames N        benchmark: measured frames (default 1200)\n";
+    std::cout << "  --bench-out FILE  benchmark: results file (default benchmark.json)\n";
+    std::cout << "  --baseline FILE   benchmark: budget file; exit code 2 if exceeded\n";
+    std::cout << "  --offscreen API   benchmark: egl, osmesa or none (default egl)\n";
+    std::cout << "  --headless        step the simulation without a window\n";
+    std::cout << "  --ticks N         headless: number of ticks to run\n";
+    std::cout << "  --sim-seconds S   headless: simulated seconds to run\n";
+    std::cout << "  --tick-rate HZ    simulation ticks per simulated second (default 120)\n";
+    std::cout << "  --script FILE     headless: scripted input file\n";
+    std::cout << "  --bot NAME        headless: built-in pilot (idle, seek)\n";
+    std::cout << "  --verbose         headless: print game events\n";
+    std::cout << "  --batch N         headless: step N independent worlds in lockstep\n";
+    std::cout << "  --batch-check     batch: compare every world with StepSimulation each tick; exit code 1 on mismatch\n";
+    std::cout << "  --trace FILE      write a Chrome trace of the run on exit (F9 writes one at any time)\n";
+    std::cout << "  --overdraw        overdraw heat map and per-pass pipeline statistics (F3 toggles)\n";
+    std::cout << "  --overlay         on-screen performance overlay (F2 toggles)\n";
+    std::cout << "  --record FILE     record keys, mouse and frame times with the seed to FILE\n";
+    std::cout << "  --replay FILE     play back a recording frame by frame (with --benchmark: as the flight)\n";
+    std::cout << "  --replay-speed X  replay: playback speed, 0 for as fast as possible (default 1)\n";
+    std::cout << "  --log-file FILE   also write log messages, with timestamps, to FILE\n";
+    std::cout << "  --log-level L     lowest level logged: trace, debug, info, warn, error (default info)\n";
+    std::cout << "  --latency         print input-to-frame-completion latency on exit\n";
+    std::cout << "  --no-late-latch   build the view at frame start instead of just before drawing\n";
+    std::cout << "  --frame-queue N   let the CPU run at most N frames ahead of the GPU (0: no limit)\n";
+    std::cout << "  --pace MODE       frame pacing: off, vsync, adaptive, cap (default vsync)\n";
+    std::cout << "  --fps N           pace cap: frames per second (default 60)\n";
+    std::cout << "  --idle-fps N      frame rate while unfocused or iconified, 0 for no limit (default 10)\n";
+    std::cout << "  --pacing          print frame interval and jitter statistics on exit\n";
+    std::cout << "  --dynres          scale the render resolution to meet --frame-target, upscaled temporally\n";
+    std::cout << "  --render-scale S  render at S times the window size per axis, 0.5 to 1 (with --dynres: start there)\n";
+    std::cout << "  --frame-target MS dynres: frame cost to aim for in milliseconds (default 16.7)\n";
+    std::cout << "  --snow N          snowflakes simulated on the GPU, e.g. 100000 (default 0)\n";
+    std::cout << "  --clouds N        cloud impostors in the sky, e.g. 2000 (default 0)\n";
+    std::cout << "  --impostor-distance D  trees farther than D draw as impostors, 0 for never (default 60)\n";
+    std::cout << "  --no-lightmaps    light terrain and houses per pixel instead of from baked lightmaps\n";
+    std::cout << "  --no-probes       light objects without lightmaps per pixel instead of from light probes\n";
+    std::cout << "  --no-shadows      no cascaded sun shadows\n";
+    std::cout << "  --scene FILE      scene config file (key value per line)\n";
+    std::cout << "  --layout NAME     scene layout (classic, uniform, village, forest)\n";
+    std::cout << "  --houses N        number of houses\n";
+    std::cout << "  --trees N         number of trees\n";
+    std::cout << "  --lanterns N      number of lanterns\n";
+    std::cout << "  --sleds N         number of sleds\n";
+    std::cout << "  --autofire R      packages fired automatically per second\n";
+}
+
+// Returns false if the command line is invalid or help was requested.
+inline bool ParseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--bench-jobs") {
+            opt.benchJobs = true;
+        }
+        else if (arg == "--test-jobs") {
+            opt.testJobs = true;
+        }
+        else if (arg == "--bench-micro") {
+            opt.benchMicro = true;
+        }
+        else if (arg == "--micro-max" && hasValue) {
+            opt.microMax = std::atoll(argv[++i]);
+        }
+        else if (arg == "--benchmark") {
+            opt.benchmark = true;
+        }
+        else if (arg == "--frames" && hasValue) {
+            opt.frames = std::atoi(argv[++i]);
+        }
+        else if (arg == "--bench-out" && hasValue) {
+            opt.benchOut = argv[++i];
+        }
+        else if (arg == "--baseline" && hasValue) {
+            opt.baseline = argv[++i];
+        }
+        else if (arg == "--offscreen" && hasValue) {
+            opt.offscreen = argv[++i];
+        }
+        else if (arg == "--headless") {
+            opt.headless = true;
+        }
+        else if (arg == "--verbose") {
+            opt.verbose = true;
+        }
+        else if (arg == "--seed" && hasValue) {
+            opt.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+            opt.seedSet = true;
+        }
+        else if (arg == "--ticks" && hasValue) {
+            opt.ticks = std::atoll(argv[++i]);
+        }
+        else if (arg == "--sim-seconds" && hasValue) {
+            opt.simSeconds = std::atof(argv[++i]);
+        }
+        else if (arg == "--tick-rate" && hasValue) {
+            opt.tickRate = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (arg == "--script" && hasValue) {
+            opt.script = argv[++i];
+        }
+        else if (arg == "--bot" && hasValue) {
+            opt.bot = argv[++i];
+        }
+        else if (arg == "--batch" && hasValue) {
+            opt.batch = std::atoi(argv[++i]);
+        }
+        else if (arg == "--batch-check") {
+            opt.batchCheck = true;
+        }
+        else if (arg == "--trace" && hasValue) {
+            opt.trace = argv[++i];
+        }
+        else if (arg == "--overdraw") {
+            opt.overdraw = true;
+        }
+        else if (arg == "--overlay") {
+            opt.overlay = true;
+        }
+        else if (arg == "--record" && hasValue) {
+            opt.record = argv[++i];
+        }
+        else if (arg == "--replay" && hasValue) {
+            opt.replay = argv[++i];
+        }
+        else if (arg == "--replay-speed" && hasValue) {
+            opt.replaySpeed = std::atof(argv[++i]);
+        }
+        else if (arg == "--log-file" && hasValue) {
+            opt.logFile = argv[++i];
+        }
+        else if (arg == "--log-level" && hasValue) {
+            if (!ParseLogLevel(argv[++i], opt.logLevel)) return false;
+        }
+        else if (arg == "--latency") {
+            opt.latency = true;
+        }
+        else if (arg == "--no-late-latch") {
+            opt.lateLatch = false;
+        }
+        else if (arg == "--frame-queue" && hasValue) {
+            opt.frameQueue = std::atoi(argv[++i]);
+        }
+        else if (arg == "--pace" && hasValue) {
+            if (!ParsePaceMode(argv[++i], opt.paceMode)) return false;
+        }
+        else if (arg == "--fps" && hasValue) {
+            opt.fpsCap = std::atof(argv[++i]);
+        }
+        else if (arg == "--idle-fps" && hasValue) {
+            opt.idleFps = std::atof(argv[++i]);
+        }
+        else if (arg == "--pacing") {
+            opt.pacing = true;
+        }
+        else if (arg == "--dynres") {
+            opt.dynres = true;
+        }
+        else if (arg == "--render-scale" && hasValue) {
+            opt.renderScale = std::atof(argv[++i]);
+        }
+        else if (arg == "--frame-target" && hasValue) {
+            opt.frameTarget = std::atof(argv[++i]);
+        }
+        else if (arg == "--snow" && hasValue) {
+            opt.snow = std::atoi(argv[++i]);
+        }
+        else if (arg == "--clouds" && hasValue) {
+            opt.clouds = std::atoi(argv[++i]);
+        }
+        else if (arg == "--impostor-distance" && hasValue) {
+            opt.impostorDistance = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (arg == "--no-lightmaps") {
+            opt.lightmaps = false;
+        }
+        else if (arg == "--no-probes") {
+            opt.probes = false;
+        }
+        else if (arg == "--no-shadows") {
+            opt.shadows = false;
+        }
+        else if (arg == "--scene" && hasValue) {
+            if (!LoadSceneConfig(argv[++i], opt.scene)) return false;
+        }
+        else if (arg == "--layout" && hasValue) {
+            if (!ParseSceneLayout(argv[++i], opt.scene.layout)) return false;
+        }
+        else if (arg == "--houses" && hasValue) {
+            opt.scene.houses = std::atoi(argv[++i]);
+        }
+        else if (arg == "--trees" && hasValue) {
+            opt.scene.trees = std::atoi(argv[++i]);
+        }
+        else if (arg == "--lanterns" && hasValue) {
+            opt.scene.lanterns = std::atoi(argv[++i]);
+        }
+        else if (arg == "--sleds" && hasValue) {
+            opt.scene.sleds = std::atoi(argv[++i]);
+        }
+        else if (arg == "--autofire" && hasValue) {
+            opt.scene.autofire = static_cast<float>(std::atof(argv[++i]));
+        }
+        else {
+            if (arg != "--help" && arg != "-h") {
+                std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            }
+            PrintUsage();
+            return false;
+        }
+    }
+
+    if (opt.tickRate <= 0.0f) {
+        std::cerr << "Tick rate must be positive" << std::endl;
+        return false;
+    }
+    if (opt.frames <= 0) {
+        std::cerr << "Frame count must be positive" << std::endl;
+        return false;
+    }
+    if (!opt.record.empty() && (opt.benchmark || !opt.replay.empty())) {
+        std::cerr << "--record cannot be combined with --benchmark or --replay" << std::endl;
+        return false;
+    }
+    if (opt.batchCheck && (!opt.headless || opt.batch <= 0)) {
+        std::cerr << "--batch-check needs --headless and --batch N" << std::endl;
+        return false;
+    }
+    if (opt.replaySpeed < 0.0) {
+        std::cerr << "Replay speed must not be negative" << std::endl;
+        return false;
+    }
+    if (opt.frameQueue < 0 || opt.frameQueue > 8) {
+        std::cerr << "Frame queue limit must be between 0 and 8" << std::endl;
+        return false;
+    }
+    if (opt.fpsCap <= 0.0 || opt.idleFps < 0.0) {
+        std::cerr << "Frame rates must be positive" << std::endl;
+        return false;
+    }
+    if (opt.renderScale != 0.0 && (opt.renderScale < 0.5 || opt.renderScale > 1.0)) {
+        std::cerr << "Render scale must be between 0.5 and 1" << std::endl;
+        return false;
+    }
+    if (opt.snow < 0) {
+        std::cerr << "Snowflake count must not be negative" << std::endl;
+        return false;
+    }
+    if (opt.clouds < 0) {
+        std::cerr << "Cloud count must not be negative" << std::endl;
+        return false;
+    }
+    if (opt.impostorDistance < 0.0f) {
+        std::cerr << "Impostor distance must not be negative" << std::endl;
+        return false;
+    }
+    if (opt.frameTarget <= 0.0) {
+        std::cerr << "Frame target must be positive" << std::endl;
+        return false;
+    }
+    if (opt.microMax < 1000) {
+        std::cerr << "Micro benchmark size must be at least 1000" << std::endl;
+        return false;
+    }
+    if (opt.scene.houses < 0 || opt.scene.trees < 0 || opt.scene.lanterns < 0 || opt.scene.sleds < 0 || opt.scene.autofire < 0.0f) {
+        std::cerr << "Scene counts must not be negative" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <GL/glew.h>
+#include <iostream>
+#include <vector>
+
+#include "shaders.h"
+
+// Frames between pipeline statistics reports in the overdraw mode.
+const int OVERDRAW_REPORT_FRAMES = 120;
+
+// Overdraw heat map. While active the scene renders into an R8 target with
+// additive blending and the main shader writes 1/255 per shaded fragment, so
+// each pixel ends up holding the number of fragments that passed the depth
+// test there. Resolve maps the counts to colours on the real target.
+class OverdrawView {
+public:
+    bool Init(int w, int h) {
+        width = w;
+        height = h;
+
+        program = CompileProgram(overdraw_vs_source, overdraw_fs_source);
+        if (program == 0) return false;
+        glGenVertexArrays(1, &emptyVao);
+
+        glGenTextures(1, &counts);
+        glBindTexture(GL_TEXTURE_2D, counts);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, counts, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            std::cerr << "Overdraw framebuffer is incomplete" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Initialized() const { return fbo != 0; }
+
+    // Call before the frame's clear.
+    void Begin() {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
+    // Draws the heat map into `target` and restores the scene state.
+    void Resolve(unsigned int target, unsigned int sceneProgram) {
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        glUseProgram(program);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, counts);
+        glBindVertexArray(emptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glUseProgram(sceneProgram);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // Mean fragments per pixel that survived the depth test, read back from
+    // the count target. Stalls; for reports only.
+    double AverageFragmentsPerPixel() {
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height);
+        GLint previous = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+
+        unsigned long long sum = 0;
+        for (unsigned char v : pixels) sum += v;
+        return static_cast<double>(sum) / pixels.size();
+    }
+
+    int Pixels() const { return width * height; }
+
+private:
+    int width = 0;
+    int height = 0;
+    unsigned int program = 0;
+    unsigned int emptyVao = 0;
+    unsigned int counts = 0;
+    unsigned int depth = 0;
+    unsigned int fbo = 0;
+};
+
+#endif
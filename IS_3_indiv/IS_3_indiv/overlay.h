@@ -0,0 +1,402 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+#include "alloccount.h"
+#include "profiler.h"
+#include "shaders.h"
+
+// Frames kept in the frame and GPU time graphs.
+const int OVERLAY_HISTORY = 120;
+
+// Frames of vertices the ring holds before its storage is orphaned.
+const int OVERLAY_RING_FRAMES = 3;
+const int OVERLAY_MAX_QUADS = 2048;
+
+const int OVERLAY_GLYPH_W = 5;
+const int OVERLAY_GLYPH_H = 7;
+const int OVERLAY_CELL_W = 6;
+const int OVERLAY_CELL_H = 8;
+const int OVERLAY_ATLAS_COLS = 16;
+const int OVERLAY_ATLAS_ROWS = 5;
+const int OVERLAY_SCALE = 2;
+
+// Frames between resident memory samples.
+const int OVERLAY_MEMORY_FRAMES = 30;
+
+// 5x7 glyphs for ' ' to '_', one byte per row, bit 4 is the leftmost
+// column. Lower case is drawn as upper case.
+const unsigned char overlay_font[64][OVERLAY_GLYPH_H] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x04 },
+    { 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 }, { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A },
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 }, { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D }, { 0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 }, { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 },
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E }, { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E },
+    { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E },
+    { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }
+};
+
+// Resident set size of this process in bytes, 0 if unknown.
+inline unsigned long long ProcessMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.WorkingSetSize;
+    return 0;
+#else
+    unsigned long long pages = 0, resident = 0;
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (f == nullptr) return 0;
+    int read = std::fscanf(f, "%llu %llu", &pages, &resident);
+    std::fclose(f);
+    return read == 2 ? resident * 4096ULL : 0;
+#endif
+}
+
+// What the overlay shows besides the profiler stats, filled in once the
+// frame's scene draws are recorded.
+struct OverlayFrame {
+    double frameMs = 0.0;
+    int drawCalls = 0;
+    long long triangles = 0;
+    int packages = 0;
+    int entities = 0;
+    int visible = 0;
+    int tested = 0;
+    int renderWidth = 0;   // 0 when the scene renders at window size
+    int renderHeight = 0;
+};
+
+struct OverlayVertex {
+    float x, y;
+    float u, v;
+    unsigned int color;
+};
+
+// On-screen stats: text and graphs go into one vertex array that is drawn
+// with a single call, glyphs and solid quads sharing one small atlas.
+class StatsOverlay {
+public:
+    bool Init(int w, int h) {
+        width = w;
+        height = h;
+
+        program = CompileProgram(overlay_vs_source, overlay_fs_source);
+        if (program == 0) return false;
+        screenLoc = glGetUniformLocation(program, "screenSize");
+
+        // Glyph cells in ASCII order from ' ', then one solid cell for
+        // backgrounds and graph bars.
+        int atlasW = OVERLAY_ATLAS_COLS * OVERLAY_CELL_W;
+        int atlasH = OVERLAY_ATLAS_ROWS * OVERLAY_CELL_H;
+        std::vector<unsigned char> pixels(static_cast<size_t>(atlasW) * atlasH, 0);
+        for (int g = 0; g <= 64; g++) {
+            int cx = (g % OVERLAY_ATLAS_COLS) * OVERLAY_CELL_W;
+            int cy = (g / OVERLAY_ATLAS_COLS) * OVERLAY_CELL_H;
+            for (int y = 0; y < OVERLAY_CELL_H; y++) {
+                for (int x = 0; x < OVERLAY_CELL_W; x++) {
+                    bool on = g == 64 || (y < OVERLAY_GLYPH_H && x < OVERLAY_GLYPH_W && (overlay_font[g][y] >> (4 - x)) & 1);
+                    if (on) pixels[(cy + y) * atlasW + cx + x] = 255;
+                }
+            }
+        }
+
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasW, atlasH, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        texelU = 1.0f / atlasW;
+        texelV = 1.0f / atlasH;
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, RegionBytes() * OVERLAY_RING_FRAMES, nullptr, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, u));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, color));
+        glBindVertexArray(0);
+
+        vertices.reserve(static_cast<size_t>(OVERLAY_MAX_QUADS) * 6);
+        stats.reserve(64);
+        return true;
+    }
+
+    bool Initialized() const { return vao != 0; }
+
+    // Builds the overlay for this frame and draws it into the bound
+    // framebuffer. Leaves `sceneProgram` bound and the scene's depth, blend
+    // and cull state restored.
+    void Draw(const OverlayFrame& frame, unsigned int sceneProgram) {
+        PROFILE_SCOPE("Build overlay");
+        long long start = Profiler::Now();
+
+        Profiler::Get().Stats(stats);
+        double gpuMs = 0.0;
+        for (const ProfileStat& s : stats) {
+            if (s.type == PROFILE_GPU) gpuMs += s.last;
+        }
+
+        frameHistory[historyHead] = static_cast<float>(frame.frameMs);
+        gpuHistory[historyHead] = static_cast<float>(gpuMs);
+        historyHead = (historyHead + 1) % OVERLAY_HISTORY;
+        historyCount = std::min(historyCount + 1, OVERLAY_HISTORY);
+
+        unsigned long long allocations = AllocationCount();
+        double allocsPerFrame = static_cast<double>(allocations - lastAllocations);
+        lastAllocations = allocations;
+        if (frameCounter++ % OVERLAY_MEMORY_FRAMES == 0) memoryBytes = ProcessMemoryBytes();
+
+        Build(frame, gpuMs, allocsPerFrame);
+        int first = Upload();
+
+        glUseProgram(program);
+        glUniform2f(screenLoc, static_cast<float>(width), static_cast<float>(height));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, first, static_cast<GLsizei>(vertices.size()));
+
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glUseProgram(sceneProgram);
+
+        cpuMs = (Profiler::Now() - start) / 1.0e6;
+    }
+
+private:
+    static size_t RegionBytes() { return static_cast<size_t>(OVERLAY_MAX_QUADS) * 6 * sizeof(OverlayVertex); }
+
+    static unsigned int Color(int r, int g, int b, int a = 255) {
+        return static_cast<unsigned int>(r) | (static_cast<unsigned int>(g) << 8)
+            | (static_cast<unsigned int>(b) << 16) | (static_cast<unsigned int>(a) << 24);
+    }
+
+    void Quad(float x, float y, float w, float h, float u0, float v0, float u1, float v1, unsigned int color) {
+        if (vertices.size() + 6 > static_cast<size_t>(OVERLAY_MAX_QUADS) * 6) return;
+        OverlayVertex a = { x, y, u0, v0, color };
+        OverlayVertex b = { x + w, y, u1, v0, color };
+        OverlayVertex c = { x + w, y + h, u1, v1, color };
+        OverlayVertex d = { x, y + h, u0, v1, color };
+        vertices.push_back(a); vertices.push_back(b); vertices.push_back(c);
+        vertices.push_back(a); vertices.push_back(c); vertices.push_back(d);
+    }
+
+    void Rect(float x, float y, float w, float h, unsigned int color) {
+        // Middle of the solid cell, so nearest sampling never leaves it.
+        float u = ((64 % OVERLAY_ATLAS_COLS) * OVERLAY_CELL_W + 0.5f * OVERLAY_CELL_W) * texelU;
+        float v = ((64 / OVERLAY_ATLAS_COLS) * OVERLAY_CELL_H + 0.5f * OVERLAY_CELL_H) * texelV;
+        Quad(x, y, w, h, u, v, u, v, color);
+    }
+
+    float Text(float x, float y, const char* text, unsigned int color) {
+        for (const char* p = text; *p; p++) {
+            int c = *p;
+            if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+            if (c > ' ' && c <= '_') {
+                int g = c - ' ';
+                float u = (g % OVERLAY_ATLAS_COLS) * OVERLAY_CELL_W * texelU;
+                float v = (g / OVERLAY_ATLAS_COLS) * OVERLAY_CELL_H * texelV;
+                Quad(x, y, static_cast<float>(OVERLAY_CELL_W * OVERLAY_SCALE), static_cast<float>(OVERLAY_CELL_H * OVERLAY_SCALE),
+                    u, v, u + OVERLAY_CELL_W * texelU, v + OVERLAY_CELL_H * texelV, color);
+            }
+            x += OVERLAY_CELL_W * OVERLAY_SCALE;
+        }
+        return y + (OVERLAY_CELL_H + 2) * OVERLAY_SCALE;
+    }
+
+    // Bars for the last OVERLAY_HISTORY frames, oldest on the left, with a
+    // line at the 60 Hz budget. The scale grows to fit the worst frame.
+    float Graph(float x, float y, float w, float h, const float* history, unsigned int color) {
+        float peak = 1000.0f / 60.0f;
+        for (int i = 0; i < historyCount; i++) peak = std::max(peak, history[i]);
+        peak *= 1.1f;
+
+        Rect(x, y, w, h, Color(0, 0, 0, 120));
+        float bar = w / OVERLAY_HISTORY;
+        for (int i = 0; i < historyCount; i++) {
+            int index = (historyHead - historyCount + i + OVERLAY_HISTORY) % OVERLAY_HISTORY;
+            float bh = std::min(h, h * history[index] / peak);
+            float bx = x + w - (historyCount - i) * bar;
+            Rect(bx, y + h - bh, std::max(1.0f, bar - 1.0f), bh, color);
+        }
+        Rect(x, y + h - h * (1000.0f / 60.0f) / peak, w, 1.0f, Color(255, 255, 255, 140));
+        return y + h + 2 * OVERLAY_SCALE;
+    }
+
+    void Build(const OverlayFrame& frame, double gpuMs, double allocsPerFrame) {
+        vertices.clear();
+        const float x = 10.0f, w = 420.0f;
+        const float graphH = 48.0f;
+        const unsigned int white = Color(235, 240, 255);
+        const unsigned int dim = Color(170, 180, 200);
+
+        // Background first, sized once the lines are in.
+        size_t background = vertices.size();
+        Rect(0.0f, 0.0f, 0.0f, 0.0f, Color(10, 14, 30, 170));
+
+        float avgFrame = 0.0f, maxFrame = 0.0f, avgGpu = 0.0f, maxGpu = 0.0f;
+        for (int i = 0; i < historyCount; i++) {
+            avgFrame += frameHistory[i];
+            maxFrame = std::max(maxFrame, frameHistory[i]);
+            avgGpu += gpuHistory[i];
+            maxGpu = std::max(maxGpu, gpuHistory[i]);
+        }
+        if (historyCount > 0) {
+            avgFrame /= historyCount;
+            avgGpu /= historyCount;
+        }
+
+        char line[96];
+        float y = 10.0f;
+        std::snprintf(line, sizeof(line), "Frame %6.2f ms  avg %6.2f  max %6.2f", frame.frameMs, avgFrame, maxFrame);
+        y = Text(x, y, line, white);
+        y = Graph(x, y, w, graphH, frameHistory, Color(90, 200, 255, 220));
+
+        std::snprintf(line, sizeof(line), "GPU   %6.2f ms  avg %6.2f  max %6.2f", gpuMs, avgGpu, maxGpu);
+        y = Text(x, y, line, white);
+        y = Graph(x, y, w, graphH, gpuHistory, Color(255, 170, 60, 220));
+
+        std::snprintf(line, sizeof(line), "Draws %d  tris %lld", frame.drawCalls, frame.triangles);
+        y = Text(x, y, line, white);
+        std::snprintf(line, sizeof(line), "Packages %d  entities %d", frame.packages, frame.entities);
+        y = Text(x, y, line, white);
+        std::snprintf(line, sizeof(line), "Culling %d/%d visible", frame.visible, frame.tested);
+        y = Text(x, y, line, white);
+        if (frame.renderWidth > 0) {
+            std::snprintf(line, sizeof(line), "Render %dx%d  %.0f%% of pixels", frame.renderWidth, frame.renderHeight,
+                100.0 * frame.renderWidth * frame.renderHeight / (static_cast<double>(width) * height));
+            y = Text(x, y, line, white);
+        }
+        if (ALLOC_COUNTING) {
+            std::snprintf(line, sizeof(line), "Memory %.1f MB  allocs/frame %.0f", memoryBytes / (1024.0 * 1024.0), allocsPerFrame);
+        }
+        else {
+            std::snprintf(line, sizeof(line), "Memory %.1f MB", memoryBytes / (1024.0 * 1024.0));
+        }
+        y = Text(x, y, line, white);
+
+        // Slowest CPU zones over the stats window.
+        zones.clear();
+        for (const ProfileStat& s : stats) {
+            if (s.type == PROFILE_ZONE) zones.push_back(&s);
+        }
+        size_t shown = std::min<size_t>(zones.size(), 6);
+        std::partial_sort(zones.begin(), zones.begin() + shown, zones.end(),
+            [](const ProfileStat* a, const ProfileStat* b) { return a->average > b->average; });
+        for (size_t i = 0; i < shown; i++) {
+            std::snprintf(line, sizeof(line), "%-18.18s %6.3f ms", zones[i]->name.c_str(), zones[i]->average);
+            y = Text(x, y, line, dim);
+        }
+
+        std::snprintf(line, sizeof(line), "Overlay %.3f ms cpu", cpuMs);
+        y = Text(x, y, line, dim);
+
+        OverlayVertex* bg = &vertices[background];
+        float bw = w + 2.0f * x, bh = y;
+        bg[1].x = bg[2].x = bg[4].x = bw;
+        bg[2].y = bg[4].y = bg[5].y = bh;
+    }
+
+    // Appends this frame's vertices to the ring and returns the first
+    // vertex. Frames only ever write past what earlier frames wrote, so the
+    // mapping is unsynchronized; when the ring is full the storage is
+    // orphaned, as InstanceStream does every frame, instead of waiting.
+    int Upload() {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        size_t bytes = vertices.size() * sizeof(OverlayVertex);
+        if (ringCursor + bytes > RegionBytes() * OVERLAY_RING_FRAMES) {
+            glBufferData(GL_ARRAY_BUFFER, RegionBytes() * OVERLAY_RING_FRAMES, nullptr, GL_STREAM_DRAW);
+            ringCursor = 0;
+        }
+
+        int first = static_cast<int>(ringCursor / sizeof(OverlayVertex));
+        void* dst = glMapBufferRange(GL_ARRAY_BUFFER, ringCursor, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst != nullptr) {
+            std::memcpy(dst, vertices.data(), bytes);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        ringCursor += bytes;
+        return first;
+    }
+
+    int width = 0;
+    int height = 0;
+    unsigned int program = 0;
+    int screenLoc = -1;
+    unsigned int atlas = 0;
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+    float texelU = 0.0f;
+    float texelV = 0.0f;
+
+    size_t ringCursor = 0;
+    std::vector<OverlayVertex> vertices;
+
+    std::vector<ProfileStat> stats;
+    std::vector<const ProfileStat*> zones;
+    float frameHistory[OVERLAY_HISTORY] = {};
+    float gpuHistory[OVERLAY_HISTORY] = {};
+    int historyHead = 0;
+    int historyCount = 0;
+
+    unsigned long long lastAllocations = 0;
+    unsigned long long memoryBytes = 0;
+    int frameCounter = 0;
+    double cpuMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "heightfield.h"
+#include "jobsystem.h"
+#include "lightmap.h"
+#include "profiler.h"
+
+// Probe grid over the whole terrain, from just above the highest ground up
+// to well over the airship's cruising height.
+const int PROBE_GRID_X = 32;
+const int PROBE_GRID_Y = 8;
+const int PROBE_GRID_Z = 32;
+const float PROBE_BOTTOM = 30.0f;
+const float PROBE_TOP = 830.0f;
+
+// L2 spherical harmonics: nine RGB coefficients per probe, packed into seven
+// RGBA slabs laid side by side along x of one 3D texture.
+const int PROBE_COEFFICIENTS = 9;
+const int PROBE_SLABS = 7;
+
+// Sky visibility rays per probe, spread over the whole sphere.
+const int PROBE_SKY_RAYS = 64;
+const int PROBE_GRAIN = 16;
+
+// Lanterns closer than PROBE_EXACT_NEAR are left out of the probes and lit
+// exactly per pixel, fading over to the probes by PROBE_EXACT_FAR. Only the
+// PROBE_EXACT_LIGHTS lanterns nearest the airship get the exact part.
+const float PROBE_EXACT_NEAR = 150.0f;
+const float PROBE_EXACT_FAR = 400.0f;
+const int PROBE_EXACT_LIGHTS = 4;
+
+// Real SH basis in the order the vertex shader reads it.
+inline void ShBasis(const glm::vec3& d, float out[PROBE_COEFFICIENTS]) {
+    out[0] = 0.282095f;
+    out[1] = 0.488603f * d.y;
+    out[2] = 0.488603f * d.z;
+    out[3] = 0.488603f * d.x;
+    out[4] = 1.092548f * d.x * d.y;
+    out[5] = 1.092548f * d.y * d.z;
+    out[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    out[7] = 1.092548f * d.x * d.z;
+    out[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+// Share of a lantern at `dist` that the probes carry.
+inline float ProbeFarWeight(float dist) {
+    float t = std::min(std::max((dist - PROBE_EXACT_NEAR) / (PROBE_EXACT_FAR - PROBE_EXACT_NEAR), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// Irradiance probes for everything without a lightmap: the same static
+// lights the lightmaps bake, projected to SH and convolved with the cosine
+// lobe, so the vertex shader gets light for any normal from seven fetches.
+// Like the lightmaps, the grid is built once: no light in the scene moves.
+class LightProbeGrid {
+public:
+    bool Init(JobSystem& jobs, const StaticLights& staticLights) {
+        origin = glm::vec3(-0.5f * TERRAIN_SIZE, PROBE_BOTTOM, -0.5f * TERRAIN_SIZE);
+        spacing = glm::vec3(TERRAIN_SIZE / static_cast<float>(PROBE_GRID_X - 1),
+            (PROBE_TOP - PROBE_BOTTOM) / static_cast<float>(PROBE_GRID_Y - 1),
+            TERRAIN_SIZE / static_cast<float>(PROBE_GRID_Z - 1));
+
+        // Fibonacci sphere, the same directions for every probe.
+        skyDirections.resize(PROBE_SKY_RAYS);
+        for (int i = 0; i < PROBE_SKY_RAYS; i++) {
+            float y = 1.0f - 2.0f * (static_cast<float>(i) + 0.5f) / static_cast<float>(PROBE_SKY_RAYS);
+            float r = std::sqrt(std::max(0.0f, 1.0f - y * y));
+            float phi = static_cast<float>(i) * 2.39996323f;
+            skyDirections[i] = glm::vec3(r * std::cos(phi), y, r * std::sin(phi));
+        }
+
+        texels.assign(static_cast<size_t>(PROBE_GRID_X) * PROBE_SLABS * PROBE_GRID_Y * PROBE_GRID_Z * 4, 0.0f);
+
+        std::vector<int> all(static_cast<size_t>(PROBE_GRID_X) * PROBE_GRID_Y * PROBE_GRID_Z);
+        for (size_t i = 0; i < all.size(); i++) all[i] = static_cast<int>(i);
+        Evaluate(jobs, staticLights, all);
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, PROBE_GRID_X * PROBE_SLABS, PROBE_GRID_Y, PROBE_GRID_Z, 0,
+            GL_RGBA, GL_FLOAT, texels.data());
+        std::vector<float>().swap(texels);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        return true;
+    }
+
+    bool Initialized() const { return texture != 0; }
+    unsigned int Texture() const { return texture; }
+    glm::vec3 Origin() const { return origin; }
+    glm::vec3 Spacing() const { return spacing; }
+    glm::vec3 Count() const {
+        return glm::vec3(static_cast<float>(PROBE_GRID_X), static_cast<float>(PROBE_GRID_Y), static_cast<float>(PROBE_GRID_Z));
+    }
+
+private:
+    glm::vec3 ProbePosition(int x, int y, int z) const {
+        return origin + spacing * glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+    }
+
+    void Evaluate(JobSystem& jobs, const StaticLights& lights, const std::vector<int>& probes) {
+        jobs.ParallelFor(0, static_cast<int>(probes.size()), PROBE_GRAIN, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                int probe = probes[i];
+                int x = probe % PROBE_GRID_X;
+                int y = (probe / PROBE_GRID_X) % PROBE_GRID_Y;
+                int z = probe / (PROBE_GRID_X * PROBE_GRID_Y);
+
+                glm::vec3 sh[PROBE_COEFFICIENTS];
+                Project(lights, ProbePosition(x, y, z), sh);
+
+                float* row = texels.data() + (static_cast<size_t>(z) * PROBE_GRID_Y + y) * PROBE_GRID_X * PROBE_SLABS * 4;
+                for (int c = 0; c < PROBE_COEFFICIENTS * 3; c++) {
+                    int slab = c / 4;
+                    row[(slab * PROBE_GRID_X + x) * 4 + c % 4] = sh[c / 3][c % 3];
+                }
+            }
+        });
+    }
+
+    // Radiance around `p` in SH, already convolved with the cosine lobe:
+    // an open sky that gives the shaders' ambient term and the far share of
+    // every lantern in reach, shadowed.
+    void Project(const StaticLights& lights, const glm::vec3& p, glm::vec3 sh[PROBE_COEFFICIENTS]) const {
+        for (int i = 0; i < PROBE_COEFFICIENTS; i++) sh[i] = glm::vec3(0.0f);
+        float basis[PROBE_COEFFICIENTS];
+
+        // Uniform radiance ambient / pi over the sphere irradiates any
+        // normal with exactly the ambient term.
+        glm::vec3 sky = LIGHT_AMBIENT * (4.0f / static_cast<float>(PROBE_SKY_RAYS));
+        for (const auto& dir : skyDirections) {
+            if (lights.occluders.Occluded(p, dir, LIGHTMAP_SKY_DISTANCE)) continue;
+            ShBasis(dir, basis);
+            for (int i = 0; i < PROBE_COEFFICIENTS; i++) sh[i] += sky * basis[i];
+        }
+
+        for (const auto& lantern : lights.lanterns) {
+            glm::vec3 toLight = lantern + glm::vec3(0.0f, LANTERN_LIGHT_HEIGHT, 0.0f) - p;
+            float dist = glm::length(toLight);
+            float strength = LanternAttenuation(dist) * LANTERN_LIGHT_STRENGTH * ProbeFarWeight(dist);
+            if (strength < LIGHTMAP_MIN_CONTRIBUTION) continue;
+            glm::vec3 dir = toLight / dist;
+            if (lights.occluders.Occluded(p, dir, dist)) continue;
+            ShBasis(dir, basis);
+            for (int i = 0; i < PROBE_COEFFICIENTS; i++) sh[i] += LANTERN_LIGHT_COLOR * (strength * basis[i]);
+        }
+
+        // Cosine lobe convolution per band.
+        const float pi = static_cast<float>(M_PI);
+        const float band[PROBE_COEFFICIENTS] = {
+            pi, 2.0f * pi / 3.0f, 2.0f * pi / 3.0f, 2.0f * pi / 3.0f,
+            pi / 4.0f, pi / 4.0f, pi / 4.0f, pi / 4.0f, pi / 4.0f
+        };
+        for (int i = 0; i < PROBE_COEFFICIENTS; i++) sh[i] *= band[i];
+    }
+
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 spacing = glm::vec3(1.0f);
+    std::vector<glm::vec3> skyDirections;
+    std::vector<float> texels;
+    unsigned int texture = 0;
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Build with PROFILER_ENABLED=0 to compile every PROFILE_* macro away.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Events kept per thread; older ones are overwritten. Must be a power of two.
+const int PROFILER_RING_SIZE = 1 << 16;
+
+// Frames in the rolling averages of the stats API.
+const int PROFILER_STAT_FRAMES = 60;
+
+enum ProfileEventType {
+    PROFILE_ZONE,
+    PROFILE_COUNTER,
+    PROFILE_FRAME,
+    PROFILE_GPU
+};
+
+// Names must outlive the profiler: string literals or Profiler::Intern.
+struct ProfileEvent {
+    const char* name;
+    long long start;
+    long long end;
+    double value;
+    int type;
+};
+
+// Written only by its own thread. `written` is published after the event is
+// stored, so readers on other threads never need a lock; a reader that races
+// with a wrap-around drops the events that may have been overwritten.
+struct ProfileThreadBuffer {
+    std::string name;
+    int id = 0;
+    std::vector<ProfileEvent> events;
+    std::atomic<unsigned long long> written{ 0 };
+
+    void Push(const ProfileEvent& e) {
+        unsigned long long n = written.load(std::memory_order_relaxed);
+        events[n & (PROFILER_RING_SIZE - 1)] = e;
+        written.store(n + 1, std::memory_order_release);
+    }
+
+    // Appends the events from `cursor` on and advances it.
+    void Read(unsigned long long& cursor, std::vector<ProfileEvent>& out) const {
+        unsigned long long end = written.load(std::memory_order_acquire);
+        unsigned long long begin = std::max(cursor, end > PROFILER_RING_SIZE ? end - PROFILER_RING_SIZE : 0ULL);
+        size_t first = out.size();
+        for (unsigned long long i = begin; i < end; i++) {
+            out.push_back(events[i & (PROFILER_RING_SIZE - 1)]);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        unsigned long long now = written.load(std::memory_order_relaxed);
+        if (now > PROFILER_RING_SIZE && now - PROFILER_RING_SIZE > begin) {
+            size_t lost = static_cast<size_t>(std::min(end, now - PROFILER_RING_SIZE) - begin);
+            out.erase(out.begin() + first, out.begin() + first + lost);
+        }
+        cursor = end;
+    }
+};
+
+// Rolling per-frame totals of one zone or counter.
+struct ProfileStat {
+    std::string name;
+    int type = PROFILE_ZONE;
+    double average = 0.0;
+    double last = 0.0;
+    double max = 0.0;
+    int calls = 0;
+};
+
+class Profiler {
+public:
+    static Profiler& Get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    static long long Now() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void SetThreadName(const char* name) {
+        ProfileThreadBuffer& buffer = ThreadBuffer();
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.name = name;
+    }
+
+    void Zone(const char* name, long long start, long long end) {
+        ThreadBuffer().Push({ name, start, end, 0.0, PROFILE_ZONE });
+    }
+
+    void Counter(const char* name, double value) {
+        long long now = Now();
+        ThreadBuffer().Push({ name, now, now, value, PROFILE_COUNTER });
+    }
+
+    // GPU time of a pass, reported when its queries come back.
+    void GpuTime(const char* name, double ms) {
+        long long now = Now();
+        ThreadBuffer().Push({ name, now, now, ms, PROFILE_GPU });
+    }
+
+    // Ends a frame: marks it in the trace and folds everything recorded since
+    // the previous mark into the rolling stats. Call from one thread only.
+    void FrameMark() {
+        long long now = Now();
+        ThreadBuffer().Push({ "Frame", now, now, 0.0, PROFILE_FRAME });
+        UpdateStats();
+    }
+
+    // Stable copy of a runtime string, for zones named after data.
+    const char* Intern(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return interned.insert(name).first->c_str();
+    }
+
+    // Zones and GPU passes in milliseconds, counters in their own units,
+    // averaged over the last PROFILER_STAT_FRAMES frames.
+    void Stats(std::vector<ProfileStat>& out) const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        out.clear();
+        for (const auto& entry : stats) out.push_back(entry.second.stat);
+        std::sort(out.begin(), out.end(), [](const ProfileStat& a, const ProfileStat& b) {
+            return a.type != b.type ? a.type < b.type : a.name < b.name;
+        });
+    }
+
+    // Chrome trace event format; opens in chrome://tracing and Perfetto.
+    bool WriteTrace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<ProfileThreadBuffer*> threads;
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& b : buffers) {
+                threads.push_back(b.get());
+                names.push_back(b->name);
+            }
+        }
+
+        out << "{\"traceEvents\":[\n";
+        std::vector<ProfileEvent> events;
+        for (size_t t = 0; t < threads.size(); t++) {
+            ProfileThreadBuffer* thread = threads[t];
+            out << (t == 0 ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+                << ",\"args\":{\"name\":\"" << names[t] << "\"}}";
+
+            unsigned long long cursor = 0;
+            events.clear();
+            thread->Read(cursor, events);
+            for (const ProfileEvent& e : events) {
+                out << ",\n{\"name\":\"" << e.name << "\",\"pid\":1,\"tid\":" << thread->id << ",\"ts\":" << (e.start - epoch) / 1000.0;
+                if (e.type == PROFILE_ZONE) out << ",\"ph\":\"X\",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+                else if (e.type == PROFILE_COUNTER) out << ",\"ph\":\"C\",\"args\":{\"value\":" << e.value << "}}";
+                else if (e.type == PROFILE_GPU) out << ",\"ph\":\"C\",\"args\":{\"gpu_ms\":" << e.value << "}}";
+                else out << ",\"ph\":\"i\",\"s\":\"g\"}";
+            }
+        }
+        out << "\n]}\n";
+        std::cout << "Trace written to " << path << std::endl;
+        return true;
+    }
+
+private:
+    Profiler() : epoch(Now()) {}
+
+    ProfileThreadBuffer& ThreadBuffer() {
+        thread_local ProfileThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.emplace_back(new ProfileThreadBuffer());
+            buffer = buffers.back().get();
+            buffer->id = static_cast<int>(buffers.size());
+            buffer->name = "Thread " + std::to_string(buffer->id);
+            buffer->events.resize(PROFILER_RING_SIZE);
+        }
+        return *buffer;
+    }
+
+    struct StatSlot {
+        ProfileStat stat;
+        double frameTotal = 0.0;
+        int frameCalls = 0;
+        double history[PROFILER_STAT_FRAMES] = {};
+    };
+
+    void UpdateStats() {
+        std::vector<ProfileThreadBuffer*> threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& b : buffers) threads.push_back(b.get());
+        }
+        statCursors.resize(threads.size(), 0);
+
+        pending.clear();
+        for (size_t i = 0; i < threads.size(); i++) threads[i]->Read(statCursors[i], pending);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        for (const ProfileEvent& e : pending) {
+            if (e.type == PROFILE_FRAME) continue;
+            StatSlot& slot = stats[std::make_pair(e.name, e.type)];
+            slot.stat.type = e.type;
+            if (e.type == PROFILE_ZONE) slot.frameTotal += (e.end - e.start) / 1.0e6;
+            else if (e.type == PROFILE_GPU) slot.frameTotal += e.value;
+            else slot.frameTotal = e.value;
+            slot.frameCalls++;
+        }
+
+        int index = statFrame % PROFILER_STAT_FRAMES;
+        int window = std::min(statFrame + 1, PROFILER_STAT_FRAMES);
+        for (auto& entry : stats) {
+            StatSlot& slot = entry.second;
+            // Counters hold their value until they are set again, GPU passes
+            // until their next queries come back.
+            if (slot.stat.type != PROFILE_ZONE && slot.frameCalls == 0) slot.frameTotal = slot.stat.last;
+
+            slot.history[index] = slot.frameTotal;
+            double sum = 0.0, peak = 0.0;
+            for (int i = 0; i < window; i++) {
+                sum += slot.history[i];
+                peak = std::max(peak, slot.history[i]);
+            }
+            slot.stat.name = entry.first.first;
+            slot.stat.last = slot.frameTotal;
+            slot.stat.average = sum / window;
+            slot.stat.max = peak;
+            slot.stat.calls = slot.frameCalls;
+            slot.frameTotal = 0.0;
+            slot.frameCalls = 0;
+        }
+        statFrame++;
+    }
+
+    long long epoch;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileThreadBuffer>> buffers;
+    std::set<std::string> interned;
+
+    mutable std::mutex statsMutex;
+    std::map<std::pair<const char*, int>, StatSlot> stats;
+    std::vector<unsigned long long> statCursors;
+    std::vector<ProfileEvent> pending;
+    int statFrame = 0;
+};
+
+// Records the time between construction and destruction as one zone.
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start(Profiler::Now()) {}
+    ~ProfileScope() { Profiler::Get().Zone(name, start, Profiler::Now()); }
+
+private:
+    const char* name;
+    long long start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_SCOPE_DYNAMIC(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(Profiler::Get().Intern(name))
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_COUNTER(name, value) Profiler::Get().Counter(name, static_cast<double>(value))
+#define PROFILE_FRAME() Profiler::Get().FrameMark()
+#define PROFILE_GPU(name, ms) Profiler::Get().GpuTime(name, ms)
+#define PROFILE_THREAD(name) Profiler::Get().SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_DYNAMIC(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_GPU(name, ms) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+#endif
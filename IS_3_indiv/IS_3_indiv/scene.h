@@ -0,0 +1,209 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+enum SceneLayout {
+    SCENE_CLASSIC,
+    SCENE_UNIFORM,
+    SCENE_VILLAGE,
+    SCENE_FOREST
+};
+
+const int DEFAULT_TREES = 20;
+const int DEFAULT_LANTERNS = 10;
+
+// Lanterns lighting the scene at once; the shader has this many slots.
+const int MAX_LIT_LANTERNS = 10;
+
+const glm::vec3 CLASSIC_LANTERNS[DEFAULT_LANTERNS] = {
+    {400.0f, 15.0f, 400.0f}, {-400.0f, 15.0f, 400.0f}, {400.0f, 15.0f, -400.0f}, {-400.0f, 15.0f, -400.0f},
+    {1200.0f, 15.0f, 0.0f}, {-1200.0f, 15.0f, 0.0f}, {0.0f, 15.0f, 1200.0f}, {0.0f, 15.0f, -1200.0f},
+    {1800.0f, 15.0f, 1800.0f}, {-1800.0f, 15.0f, -1800.0f}
+};
+
+struct SceneConfig {
+    int layout = SCENE_CLASSIC;
+    int houses = NUM_HOUSES;
+    int trees = DEFAULT_TREES;
+    int lanterns = DEFAULT_LANTERNS;
+    int sleds = NUM_SLEDS;
+    float autofire = 0.0f;
+};
+
+// Static scenery that only the renderer needs.
+struct SceneDecor {
+    std::vector<glm::vec3> treePositions;
+    std::vector<glm::vec3> lanternPositions;
+};
+
+inline const char* SceneLayoutName(int layout) {
+    switch (layout) {
+    case SCENE_UNIFORM: return "uniform";
+    case SCENE_VILLAGE: return "village";
+    case SCENE_FOREST: return "forest";
+    default: return "classic";
+    }
+}
+
+inline bool ParseSceneLayout(const std::string& name, int& layout) {
+    if (name == "classic") layout = SCENE_CLASSIC;
+    else if (name == "uniform") layout = SCENE_UNIFORM;
+    else if (name == "village") layout = SCENE_VILLAGE;
+    else if (name == "forest") layout = SCENE_FOREST;
+    else {
+        std::cerr << "Unknown scene layout: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// One "key value" pair per line, "#" starts a comment:
+//   layout classic|uniform|village|forest
+//   houses N, trees N, lanterns N, sleds N
+//   autofire <packages per second>
+inline bool LoadSceneConfig(const std::string& path, SceneConfig& cfg) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open scene config: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line = line.substr(0, comment);
+
+        std::stringstream ss(line);
+        std::string key, value;
+        if (!(ss >> key)) continue;
+        if (!(ss >> value)) {
+            std::cerr << "Scene config line " << lineNumber << ": missing value for " << key << std::endl;
+            return false;
+        }
+
+        if (key == "layout") {
+            if (!ParseSceneLayout(value, cfg.layout)) return false;
+        }
+        else if (key == "houses") cfg.houses = std::atoi(value.c_str());
+        else if (key == "trees") cfg.trees = std::atoi(value.c_str());
+        else if (key == "lanterns") cfg.lanterns = std::atoi(value.c_str());
+        else if (key == "sleds") cfg.sleds = std::atoi(value.c_str());
+        else if (key == "autofire") cfg.autofire = static_cast<float>(std::atof(value.c_str()));
+        else {
+            std::cerr << "Scene config line " << lineNumber << ": unknown key " << key << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+inline float SceneUniform(SimRandom& rng, int halfExtent) {
+    return static_cast<float>(rng.Range(2 * halfExtent) - halfExtent);
+}
+
+// Triangular distribution around a center; most points land near it.
+inline glm::vec3 SceneScatter(SimRandom& rng, glm::vec3 center, float radius) {
+    float dx = static_cast<float>(rng.Range(1000) + rng.Range(1000)) / 1000.0f - 1.0f;
+    float dz = static_cast<float>(rng.Range(1000) + rng.Range(1000)) / 1000.0f - 1.0f;
+    return center + glm::vec3(dx * radius, 0.0f, dz * radius);
+}
+
+// A point on a ring around a center, for woods surrounding a village.
+inline glm::vec3 SceneRing(SimRandom& rng, glm::vec3 center, float inner, float outer) {
+    float angle = static_cast<float>(rng.Range(3600)) / 3600.0f * 2.0f * M_PI;
+    float r = inner + static_cast<float>(rng.Range(1000)) / 1000.0f * (outer - inner);
+    return center + glm::vec3(sin(angle) * r, 0.0f, cos(angle) * r);
+}
+
+// Fills the simulation state and the scenery for a config. The classic
+// layout with the default counts reproduces the original hand-made scene.
+inline void BuildScene(const SceneConfig& cfg, unsigned int seed, GameState& state, SceneDecor& decor) {
+    InitGameState(state, seed, cfg.houses, cfg.sleds);
+    state.autofireRate = cfg.autofire;
+
+    SimRandom rng;
+    rng.Seed(seed ^ 0x5EEDu);
+
+    decor.treePositions.resize(cfg.trees);
+    decor.lanternPositions.resize(cfg.lanterns);
+
+    std::vector<glm::vec3> centers;
+    if (cfg.layout == SCENE_VILLAGE || cfg.layout == SCENE_FOREST) {
+        int count = cfg.layout == SCENE_VILLAGE ? (cfg.houses + 11) / 12 : (cfg.trees + 149) / 150;
+        centers.resize(std::max(1, count));
+        for (auto& c : centers) {
+            c = glm::vec3(SceneUniform(rng, 2000), 0.0f, SceneUniform(rng, 2000));
+        }
+    }
+
+    for (int i = 0; i < cfg.trees; i++) {
+        glm::vec3& p = decor.treePositions[i];
+        if (cfg.layout == SCENE_VILLAGE) {
+            p = SceneRing(rng, centers[i % centers.size()], 500.0f, 1100.0f);
+        }
+        else if (cfg.layout == SCENE_FOREST) {
+            p = SceneScatter(rng, centers[i % centers.size()], 500.0f);
+        }
+        else {
+            p = glm::vec3(SceneUniform(rng, 3000), 0.0f, SceneUniform(rng, 3000));
+        }
+    }
+
+    for (int i = 0; i < cfg.lanterns; i++) {
+        glm::vec3& p = decor.lanternPositions[i];
+        if (cfg.layout == SCENE_CLASSIC && i < DEFAULT_LANTERNS) {
+            p = CLASSIC_LANTERNS[i];
+        }
+        else if (cfg.layout == SCENE_VILLAGE) {
+            p = SceneScatter(rng, centers[i % centers.size()], 450.0f);
+        }
+        else {
+            p = glm::vec3(SceneUniform(rng, 2000), 0.0f, SceneUniform(rng, 2000));
+        }
+        p.y = 15.0f;
+    }
+
+    if (cfg.layout == SCENE_VILLAGE) {
+        for (int i = 0; i < cfg.houses; i++) {
+            glm::vec3 p = SceneScatter(rng, centers[i % centers.size()], 350.0f);
+            state.housePositions[i].x = p.x;
+            state.housePositions[i].z = p.z;
+        }
+    }
+}
+
+// The lanterns closest to `focus`, at most `count` of them.
+inline void SelectLitLanterns(const SceneDecor& decor, glm::vec3 focus, std::vector<glm::vec3>& lit,
+    int count = MAX_LIT_LANTERNS) {
+    lit = decor.lanternPositions;
+    if (static_cast<int>(lit.size()) <= count) return;
+
+    std::nth_element(lit.begin(), lit.begin() + count, lit.end(),
+        [focus](const glm::vec3& a, const glm::vec3& b) {
+            glm::vec3 da = a - focus, db = b - focus;
+            return glm::dot(da, da) < glm::dot(db, db);
+        });
+    lit.resize(count);
+}
+
+inline void PrintSceneSummary(const SceneConfig& cfg) {
+    std::cout << "Scene: " << SceneLayoutName(cfg.layout) << " layout, " << cfg.houses << " houses, "
+        << cfg.trees << " trees, " << cfg.lanterns << " lanterns, " << cfg.sleds << " sleds";
+    if (cfg.autofire > 0.0f) std::cout << ", autofire " << cfg.autofire << " packages/s";
+    std::cout << std::endl;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SCENEDEPTH_H
+#define SCENEDEPTH_H
+
+#include <GL/glew.h>
+#include <iostream>
+
+// Copy of the opaque scene's depth for the passes drawn over it. The scene's
+// own depth buffer cannot be sampled while it is still being tested against,
+// and the default framebuffer's cannot be sampled at all. Made once per
+// frame and shared by every pass that needs it.
+class SceneDepthCopy {
+public:
+    bool Init(int w, int h) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, w, h, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        usable = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        // Until a copy succeeds everything reads as far away.
+        if (usable) glClear(GL_DEPTH_BUFFER_BIT);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return usable;
+    }
+
+    // Copies the `renderWidth` x `renderHeight` corner of `source`'s depth
+    // and leaves `source` bound. The first copy is checked: a source whose
+    // depth format differs cannot be blitted, and the copy then stays far.
+    void Copy(unsigned int source, int renderWidth, int renderHeight) {
+        if (!usable) return;
+        if (!checked) {
+            while (glGetError() != GL_NO_ERROR) {}
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, source);
+        if (!checked) {
+            checked = true;
+            if (glGetError() != GL_NO_ERROR) {
+                std::cerr << "Scene depth cannot be copied; snow and clouds ignore the scene behind them" << std::endl;
+                usable = false;
+            }
+        }
+    }
+
+    // False when the copy never holds the scene.
+    bool Available() const { return usable; }
+    unsigned int Texture() const { return texture; }
+
+private:
+    unsigned int texture = 0;
+    unsigned int fbo = 0;
+    bool usable = false;
+    bool checked = false;
+};
+
+#endif
@@ -6,47 +6,93 @@
 
 const char* vs_source = "#version 330 core\n"
 "layout(location=0)in vec3 p; layout(location=1)in vec2 u; layout(location=2)in vec3 n; "
-"layout(location=3)in vec3 t_in_vec; layout(location=4)in float t_in; layout(location=5)in vec3 instPos; "
-"uniform mat4 m,v,pr; uniform bool isInstanced; uniform bool isCloud; uniform float time; "
-"out vec2 uv; out vec3 fragPos; out float vType; out float cloudID; out mat3 TBN; "
-"void main(){ "
-"  vType = t_in; cloudID = float(gl_InstanceID); "
-"  vec3 posOffset = instPos; "
-"  if(isCloud){ "
-"    float id = float(gl_InstanceID); "
-"    posOffset.x += sin(time * 0.4 + id) * 300.0; "
-"    posOffset.z += cos(time * 0.3 + id * 1.5) * 300.0; "
-"    posOffset.y += sin(time * 0.7 + id * 2.0) * 40.0; "
-"  } "
-"  vec4 worldPos = isInstanced ? (m * vec4(p, 1.0) + vec4(posOffset, 0.0)) : (m * vec4(p, 1.0)); "
+"layout(location=3)in vec3 t_in_vec; layout(location=4)in float t_in; layout(location=5)in vec4 instPos; "
+"layout(location=6)in mat4 instModel; layout(location=10)in vec4 instColor; "
+"layout(location=11)in vec2 lmUv; layout(location=12)in vec4 instLightmap; "
+"uniform mat4 m; layout(std140) uniform FrameUniforms { mat4 v; mat4 pr; }; uniform bool isInstanced; uniform bool useInstanceData; "
+"uniform vec4 lightmapRect; "
+"uniform bool useProbes; uniform sampler3D probes; uniform vec3 probeOrigin; uniform vec3 probeSpacing; uniform vec3 probeCount; "
+"out vec2 uv; out vec3 fragPos; out float vType; out mat3 TBN; out vec3 instanceColor; out float instanceFade; "
+"out vec2 lightmapUv; flat out int baked; out vec3 probeLight; "
+"vec3 ProbeIrradiance(vec3 pos, vec3 nrm){ "
+"  vec3 g = clamp((pos - probeOrigin) / probeSpacing, vec3(0.0), probeCount - 1.0) + 0.5; "
+"  vec4 s[7]; "
+"  for(int k = 0; k < 7; k++) s[k] = texture(probes, vec3(g.x + float(k) * probeCount.x, g.y, g.z) / vec3(probeCount.x * 7.0, probeCount.yz)); "
+"  float x = nrm.x, y = nrm.y, z = nrm.z; "
+"  return s[0].xyz * 0.282095 "
+"    + vec3(s[0].w, s[1].xy) * (0.488603 * y) + vec3(s[1].zw, s[2].x) * (0.488603 * z) + s[2].yzw * (0.488603 * x) "
+"    + s[3].xyz * (1.092548 * x * y) + vec3(s[3].w, s[4].xy) * (1.092548 * y * z) "
+"    + vec3(s[4].zw, s[5].x) * (0.315392 * (3.0 * z * z - 1.0)) + s[5].yzw * (1.092548 * x * z) "
+"    + s[6].xyz * (0.546274 * (x * x - y * y)); } "
+"void main(){ "
+"  vType = t_in; instanceColor = instColor.rgb; instanceFade = isInstanced ? instPos.w : 1.0; "
+"  vec4 rect = useInstanceData ? instLightmap : lightmapRect; "
+"  lightmapUv = rect.xy + lmUv * rect.zw; baked = rect.z > 0.0 ? 1 : 0; "
+"  mat4 model = useInstanceData ? instModel : m; "
+"  vec4 worldPos = isInstanced ? (model * vec4(p, 1.0) + vec4(instPos.xyz, 0.0)) : (model * vec4(p, 1.0)); "
 "  fragPos = vec3(worldPos); uv = u; "
-"  vec3 T = normalize(vec3(m * vec4(t_in_vec, 0.0))); "
-"  vec3 N = normalize(vec3(m * vec4(n, 0.0))); "
+"  vec3 T = normalize(vec3(model * vec4(t_in_vec, 0.0))); "
+"  vec3 N = normalize(vec3(model * vec4(n, 0.0))); "
 "  T = normalize(T - dot(T, N) * N); "
 "  vec3 B = cross(N, T); "
 "  TBN = mat3(T, B, N); "
+"  probeLight = (useProbes && baked == 0) ? max(ProbeIrradiance(fragPos, N), vec3(0.0)) : vec3(0.0); "
 "  gl_Position = pr * v * worldPos; }";
 
 const char* fs_source = "#version 330 core\n"
-"out vec4 c; in vec2 uv; in vec3 fragPos; in float vType; in float cloudID; in mat3 TBN; "
-"uniform sampler2D t; uniform sampler2D nm; uniform bool useNormalMap; uniform bool useTexture; "
-"uniform vec3 lightDir; uniform vec3 lanternPos[10]; uniform vec3 baseColor; uniform float time; uniform bool isCloud; "
-"uniform bool spotlightOn; uniform vec3 spotlightPos; uniform vec3 spotlightDir; "
-"float rand(float n){return fract(sin(n) * 43758.5453123);} "
+"out vec4 c; in vec2 uv; in vec3 fragPos; in float vType; in mat3 TBN; in vec3 instanceColor; in float instanceFade; "
+"in vec2 lightmapUv; flat in int baked; in vec3 probeLight; uniform bool useProbes; uniform vec2 exactRange; "
+"uniform sampler2DArray textures; layout(std140) uniform TextureTable { vec4 textureRect[16]; vec4 textureLayer[16]; }; "
+"uniform int albedoTexture; uniform int normalTexture; uniform sampler2D lightmap; uniform bool useInstanceData; "
+"uniform vec3 lightDir; uniform vec3 lanternPos[10]; uniform int lanternCount; uniform vec3 baseColor; "
+"uniform bool spotlightOn; uniform vec3 spotlightPos; uniform vec3 spotlightDir; uniform bool overdraw; "
+"uniform bool useShadows; uniform sampler2DArrayShadow shadowMap; uniform mat4 cascadeMatrix[3]; uniform float cascadeFar[3]; "
+"uniform float cascadeTexel[3]; uniform vec3 cameraPos; "
+"vec4 SampleTexture(int index, vec2 st, vec2 dx, vec2 dy){ "
+"  vec4 r = textureRect[index]; vec2 size = vec2(textureSize(textures, 0).xy) * r.zw; "
+"  float lod = 0.5 * log2(max(dot(dx * size, dx * size), dot(dy * size, dy * size))); "
+"  return textureLod(textures, vec3(r.xy + fract(st) * r.zw, textureLayer[index].x), min(lod, textureLayer[index].y)); } "
+"float DitherNoise(){ return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))); } "
+"float SunShadow(vec3 pos, vec3 nrm){ "
+"  if(!useShadows) return 1.0; "
+"  float d = length(pos - cameraPos); "
+"  for(int i = 0; i < 3; i++){ "
+"    if(d < cascadeFar[i]) { "
+"      vec4 s = cascadeMatrix[i] * vec4(pos + nrm * cascadeTexel[i] * 1.5, 1.0); "
+"      return texture(shadowMap, vec4(s.xy, float(i), s.z)); } } "
+"  return 1.0; } "
 "void main(){ "
-"  vec4 tex = useTexture ? texture(t,uv) : vec4(baseColor, 1.0); "
+"  vec2 dx = dFdx(uv), dy = dFdy(uv); "
+"  vec4 tex = albedoTexture >= 0 ? SampleTexture(albedoTexture, uv, dx, dy) : vec4(useInstanceData ? instanceColor : baseColor, 1.0); "
 "  if(tex.a < 0.1) discard; "
+"  if(instanceFade < 1.0 && DitherNoise() >= instanceFade) discard; "
+"  if(overdraw) { c = vec4(1.0 / 255.0, 0.0, 0.0, 1.0); return; } "
 "  if(vType > 0.5) { c = vec4(1.0, 1.0, 1.0, 1.0); return; } "
-"  vec3 n; if(useNormalMap) { n = texture(nm, uv).rgb; n = normalize(n * 2.0 - 1.0); n = normalize(TBN * n); } else { n = normalize(TBN[2]); } "
+"  vec3 n; if(normalTexture >= 0) { n = SampleTexture(normalTexture, uv, dx, dy).rgb; n = normalize(n * 2.0 - 1.0); n = normalize(TBN * n); } else { n = normalize(TBN[2]); } "
+"  vec3 lighting; "
+"  if(baked != 0) { lighting = texture(lightmap, lightmapUv).rgb; } "
+"  else if(useProbes) { "
+"    lighting = probeLight; "
+"    for(int i=0; i<lanternCount; i++){ "
+"      vec3 lPos = lanternPos[i] + vec3(0, 60, 0); "
+"      float dist = length(lPos - fragPos); "
+"      float atten = 1.0 / (1.0 + 0.0006 * dist + 0.00002 * (dist * dist)); "
+"      float exact = 1.0 - smoothstep(exactRange.x, exactRange.y, dist); "
+"      lighting += vec3(1.0, 0.85, 0.6) * max(dot(n, normalize(lPos - fragPos)), 0.0) * atten * 3.0 * exact; "
+"    } "
+"  } "
+"  else { "
 "  vec3 ambient = vec3(0.3, 0.3, 0.4); "
-"  vec3 lighting = ambient + max(dot(n, normalize(lightDir)), 0.0) * 0.5; "
+"  lighting = ambient; "
 "  "
-"  for(int i=0; i<10; i++){ "
+"  for(int i=0; i<lanternCount; i++){ "
 "    vec3 lPos = lanternPos[i] + vec3(0, 60, 0); "
 "    float dist = length(lPos - fragPos); "
 "    float atten = 1.0 / (1.0 + 0.0006 * dist + 0.00002 * (dist * dist)); "
 "    lighting += vec3(1.0, 0.85, 0.6) * max(dot(n, normalize(lPos - fragPos)), 0.0) * atten * 3.0; "
 "  } "
+"  } "
+"  lighting += max(dot(n, -normalize(lightDir)), 0.0) * 0.5 * SunShadow(fragPos, normalize(TBN[2])); "
 "  "
 "  if(spotlightOn) { "
 "    vec3 toLight = normalize(spotlightPos - fragPos); "
@@ -58,22 +104,303 @@ const char* fs_source = "#version 330 core\n"
 "    lighting += vec3(1.0, 0.98, 0.9) * max(dot(n, toLight), 0.0) * intensity * attenuation * 2.5; "
 "  } "
 "  "
-"  if(isCloud){ "
-"    float interval = floor(time * 1.5); "
-"    float targetCloud = floor(rand(interval) * 8.0); "
-"    if(abs(cloudID - targetCloud) < 0.1){ "
-"       float pulse = pow(max(0.0, sin(time * 20.0)), 3.0); "
-"       lighting += vec3(0.8, 0.9, 1.0) * pulse * 3.0; "
-"    } "
-"    float flicker = 0.9 + 0.1 * sin(time * 5.0 + cloudID * 10.0); "
-"    lighting *= flicker; "
-"  } "
-"  "
 "  c = vec4(tex.rgb * lighting, tex.a); }";
 
-inline unsigned int CreateShaderProgram() {
+// Sun shadow casters, depth only. `mode` says how a caster reaches world
+// space: its model matrix, model plus a per-instance offset, or a
+// per-instance model matrix (ShadowCasterMode).
+const char* shadow_vs_source = "#version 330 core\n"
+"layout(location=0)in vec3 p; layout(location=5)in vec4 instPos; layout(location=6)in mat4 instModel; "
+"uniform mat4 lightViewProj; uniform mat4 m; uniform int mode; "
+"void main(){ "
+"  vec4 w = mode == 2 ? instModel * vec4(p, 1.0) : m * vec4(p, 1.0); "
+"  if(mode == 1) w.xyz += instPos.xyz; "
+"  gl_Position = lightViewProj * w; }";
+
+const char* shadow_fs_source = "#version 330 core\n"
+"void main(){ }";
+
+// Fullscreen triangle showing how many fragments were shaded per pixel:
+// blue for one, green for two, then yellow, red and white from 16 on.
+const char* overdraw_vs_source = "#version 330 core\n"
+"out vec2 uv; "
+"void main(){ "
+"  vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2); "
+"  uv = p; gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0); }";
+
+const char* overdraw_fs_source = "#version 330 core\n"
+"out vec4 c; in vec2 uv; uniform sampler2D counts; "
+"void main(){ "
+"  float n = texture(counts, uv).r * 255.0; "
+"  vec3 heat = vec3(0.0); "
+"  if(n >= 1.0) heat = mix(vec3(0.0, 0.1, 0.6), vec3(0.0, 0.7, 0.2), clamp(n - 1.0, 0.0, 1.0)); "
+"  if(n >= 2.0) heat = mix(vec3(0.0, 0.7, 0.2), vec3(1.0, 0.9, 0.0), clamp((n - 2.0) / 2.0, 0.0, 1.0)); "
+"  if(n >= 4.0) heat = mix(vec3(1.0, 0.9, 0.0), vec3(1.0, 0.1, 0.0), clamp((n - 4.0) / 4.0, 0.0, 1.0)); "
+"  if(n >= 8.0) heat = mix(vec3(1.0, 0.1, 0.0), vec3(1.0, 1.0, 1.0), clamp((n - 8.0) / 8.0, 0.0, 1.0)); "
+"  c = vec4(heat, 1.0); }";
+
+const char* overlay_vs_source = "#version 330 core\n"
+"layout(location=0) in vec2 pos; layout(location=1) in vec2 tc; layout(location=2) in vec4 col; "
+"out vec2 uv; out vec4 color; uniform vec2 screenSize; "
+"void main(){ "
+"  uv = tc; color = col; "
+"  gl_Position = vec4(pos.x / screenSize.x * 2.0 - 1.0, 1.0 - pos.y / screenSize.y * 2.0, 0.0, 1.0); }";
+
+const char* overlay_fs_source = "#version 330 core\n"
+"out vec4 c; in vec2 uv; in vec4 color; uniform sampler2D glyphs; "
+"void main(){ c = vec4(color.rgb, color.a * texture(glyphs, uv).r); }";
+
+// Temporal upscale: rebuilds each output pixel from the low-resolution,
+// jittered scene and the previous output, reprojected through the depth
+// buffer. History is clamped to the colours around the current sample so
+// anything that moved or appeared does not ghost. Drawn with the overdraw
+// view's fullscreen triangle.
+const char* upscale_fs_source = "#version 330 core\n"
+"out vec4 c; in vec2 uv; "
+"uniform sampler2D scene; uniform sampler2D sceneDepth; uniform sampler2D history; "
+"uniform vec2 renderScale; uniform vec2 texel; uniform vec2 jitter; uniform bool historyValid; uniform float blend; "
+"uniform mat4 reproject; "
+"void main(){ "
+"  vec2 lo = 0.5 * texel; vec2 hi = renderScale - 0.5 * texel; "
+"  vec2 s = clamp((uv + jitter) * renderScale, lo, hi); "
+"  vec3 cur = texture(scene, s).rgb; "
+"  ivec2 p = ivec2(s / texel); ivec2 last = ivec2(hi / texel); "
+"  vec3 n0 = texelFetch(scene, min(p + ivec2(1, 0), last), 0).rgb; "
+"  vec3 n1 = texelFetch(scene, max(p - ivec2(1, 0), ivec2(0)), 0).rgb; "
+"  vec3 n2 = texelFetch(scene, min(p + ivec2(0, 1), last), 0).rgb; "
+"  vec3 n3 = texelFetch(scene, max(p - ivec2(0, 1), ivec2(0)), 0).rgb; "
+"  vec3 mn = min(cur, min(min(n0, n1), min(n2, n3))); vec3 mx = max(cur, max(max(n0, n1), max(n2, n3))); "
+"  float d = texelFetch(sceneDepth, p, 0).r; "
+"  vec4 prev = reproject * vec4(uv * 2.0 - 1.0, d * 2.0 - 1.0, 1.0); "
+"  vec2 prevUv = prev.xy / prev.w * 0.5 + 0.5; "
+"  bool inside = historyValid && prev.w > 0.0 && prevUv == clamp(prevUv, 0.0, 1.0); "
+"  vec3 hist = clamp(texture(history, prevUv).rgb, mn, mx); "
+"  c = vec4(mix(hist, cur, inside ? blend : 1.0), 1.0); }";
+
+// Snowfall update, run with rasterization off and captured by transform
+// feedback. A flake is xyz plus a seed in w; the seed sets its size, fall
+// speed and flutter. Flakes live in a box around the camera: they wrap
+// sideways and respawn at the top once they reach the ground or the bottom.
+const char* snow_update_vs_source = "#version 330 core\n"
+"layout(location=0) in vec4 state; out vec4 outState; "
+"uniform float time; uniform float dt; uniform vec3 center; uniform vec3 extent; uniform vec2 wind; "
+"float hash(float n){ return fract(sin(n) * 43758.5453123); } "
+"void main(){ "
+"  float seed = state.w; "
+"  vec3 vel = vec3(wind.x, -mix(40.0, 90.0, seed), wind.y); "
+"  vel.xz += wind * 0.5 * sin(time * 0.3 + state.x * 0.002 + state.z * 0.001); "
+"  vel.x += sin(time * (0.7 + seed) + seed * 40.0) * 15.0; "
+"  vel.z += cos(time * (0.9 + seed) + seed * 25.0) * 15.0; "
+"  vec3 rel = state.xyz + vel * dt - center; "
+"  rel.xz = mod(rel.xz + extent.xz, 2.0 * extent.xz) - extent.xz; "
+"  if(rel.y > extent.y) rel.y -= 2.0 * extent.y; "
+"  if(rel.y < -extent.y || center.y + rel.y < 0.0) { "
+"    float n = float(gl_VertexID) * 0.001 + time; "
+"    rel = vec3((hash(n + seed) * 2.0 - 1.0) * extent.x, extent.y, (hash(n * 1.3 + seed * 7.0) * 2.0 - 1.0) * extent.z); "
+"  } "
+"  outState = vec4(center + rel, seed); }";
+
+// Camera-facing quads, one instance per flake, expanded in view space. Flakes
+// right in front of the camera are dropped before they fill the screen; soft
+// particles fade where they come close to the scene depth behind them.
+const char* snow_vs_source = "#version 330 core\n"
+"layout(location=0) in vec4 state; "
+"layout(std140) uniform FrameUniforms { mat4 v; mat4 pr; }; uniform float size; uniform float minDistance; "
+"out vec2 corner; out float viewDepth; "
+"void main(){ "
+"  corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0; "
+"  vec4 viewPos = v * vec4(state.xyz, 1.0); "
+"  viewPos.xy += corner * size * mix(0.6, 1.4, state.w); "
+"  viewDepth = -viewPos.z; "
+"  gl_Position = viewDepth > minDistance ? pr * viewPos : vec4(2.0, 2.0, 2.0, 1.0); }";
+
+const char* snow_fs_source = "#version 330 core\n"
+"out vec4 c; in vec2 corner; in float viewDepth; "
+"uniform sampler2D sceneDepth; uniform bool soft; uniform vec2 nearFar; uniform float softness; uniform float fadeDistance; "
+"void main(){ "
+"  float r = dot(corner, corner); "
+"  if(r > 1.0) discard; "
+"  float a = (1.0 - r) * 0.9 * clamp(1.0 - viewDepth / fadeDistance, 0.0, 1.0); "
+"  if(soft) { "
+"    float d = texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r * 2.0 - 1.0; "
+"    float sceneZ = 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - d * (nearFar.y - nearFar.x)); "
+"    a *= clamp((sceneZ - viewDepth) / softness, 0.0, 1.0); "
+"  } "
+"  c = vec4(0.95, 0.97, 1.0, a); }";
+
+// Half-resolution scene depth for the cloud pass, as linear view distance.
+// Each texel keeps the farthest of the four it covers so clouds reach all
+// the way to silhouettes; the composite sorts out which side a pixel is on.
+// Drawn with the overdraw view's fullscreen triangle.
+const char* cloud_depth_fs_source = "#version 330 core\n"
+"out float c; uniform sampler2D sceneDepth; uniform vec2 nearFar; "
+"float linearDepth(float d){ d = d * 2.0 - 1.0; return 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - d * (nearFar.y - nearFar.x)); } "
+"void main(){ "
+"  ivec2 p = ivec2(gl_FragCoord.xy) * 2; "
+"  float d = max(max(texelFetch(sceneDepth, p, 0).r, texelFetch(sceneDepth, p + ivec2(1, 0), 0).r), "
+"                max(texelFetch(sceneDepth, p + ivec2(0, 1), 0).r, texelFetch(sceneDepth, p + ivec2(1, 1), 0).r)); "
+"  c = linearDepth(d); }";
+
+// Cloud impostors: camera-facing quads, one instance per cloud, each showing
+// a quarter of the cloud texture. An instance is its base position and size,
+// then atlas frame, stable id, LOD scale and LOD fade. Clouds drift around
+// their base position and fade out with distance.
+const char* cloud_vs_source = "#version 330 core\n"
+"layout(location=0) in vec4 posSize; layout(location=1) in vec4 params; "
+"layout(std140) uniform FrameUniforms { mat4 v; mat4 pr; }; uniform float time; uniform vec3 cameraPos; uniform vec2 fade; "
+"out vec2 corner; out vec2 atlasUv; out float alpha; out float cloudID; out float viewDepth; "
+"void main(){ "
+"  corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0; "
+"  float id = params.y; cloudID = id; "
+"  vec3 pos = posSize.xyz; "
+"  pos.x += sin(time * 0.4 + id) * 300.0; "
+"  pos.z += cos(time * 0.3 + id * 1.5) * 300.0; "
+"  pos.y += sin(time * 0.7 + id * 2.0) * 40.0; "
+"  vec2 frame = vec2(mod(params.x, 2.0), floor(params.x * 0.5)) * 0.5; "
+"  atlasUv = frame + (corner * 0.5 + 0.5) * 0.5; "
+"  alpha = params.w * (1.0 - smoothstep(fade.x, fade.y, length(pos - cameraPos))); "
+"  vec4 viewPos = v * vec4(pos, 1.0); "
+"  viewPos.xy += corner * posSize.w * params.z * vec2(1.0, 0.55); "
+"  viewDepth = -viewPos.z; "
+"  gl_Position = pr * viewPos; }";
+
+// Clouds are lit from above and shaded darker underneath; one in 64 flashes
+// with lightning at a time and all of them flicker slightly. Output is
+// premultiplied and thins out where the scene comes close behind.
+const char* cloud_fs_source = "#version 330 core\n"
+"out vec4 c; in vec2 corner; in vec2 atlasUv; in float alpha; in float cloudID; in float viewDepth; "
+"uniform sampler2D atlas; uniform sampler2D lowDepth; uniform float time; uniform float softness; "
+"float rand(float n){ return fract(sin(n) * 43758.5453123); } "
+"void main(){ "
+"  float r = dot(corner, corner); "
+"  if(r > 1.0) discard; "
+"  vec4 tex = texture(atlas, atlasUv); "
+"  float a = alpha * (1.0 - r) * (1.0 - r) * dot(tex.rgb, vec3(0.333)) * tex.a; "
+"  float sceneZ = texelFetch(lowDepth, ivec2(gl_FragCoord.xy), 0).r; "
+"  a *= clamp((sceneZ - viewDepth) / softness, 0.0, 1.0); "
+"  if(a < 0.004) discard; "
+"  vec3 lighting = vec3(0.3, 0.3, 0.4) + vec3(0.5) * (0.6 + 0.4 * corner.y); "
+"  float interval = floor(time * 1.5); "
+"  if(abs(mod(cloudID, 64.0) - floor(rand(interval) * 64.0)) < 0.1){ "
+"    float pulse = pow(max(0.0, sin(time * 20.0)), 3.0); "
+"    lighting += vec3(0.8, 0.9, 1.0) * pulse * 3.0; "
+"  } "
+"  lighting *= 0.9 + 0.1 * sin(time * 5.0 + cloudID * 10.0); "
+"  c = vec4(tex.rgb * lighting * a, a); }";
+
+// Joint bilateral upsample of the half-resolution clouds onto the scene:
+// the four nearest cloud texels are weighted bilinearly and by how close
+// their depth is to this pixel's, so clouds do not bleed over the edges of
+// nearer geometry. Blended premultiplied.
+const char* cloud_composite_fs_source = "#version 330 core\n"
+"out vec4 c; uniform sampler2D clouds; uniform sampler2D lowDepth; uniform sampler2D sceneDepth; "
+"uniform vec2 nearFar; uniform ivec2 lowLast; "
+"float linearDepth(float d){ d = d * 2.0 - 1.0; return 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - d * (nearFar.y - nearFar.x)); } "
+"void main(){ "
+"  float z = linearDepth(texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r); "
+"  vec2 lowPos = gl_FragCoord.xy * 0.5 - 0.5; "
+"  ivec2 base = ivec2(floor(lowPos)); vec2 f = fract(lowPos); "
+"  vec4 sum = vec4(0.0); float total = 0.0; "
+"  for(int j = 0; j < 2; j++) for(int i = 0; i < 2; i++){ "
+"    ivec2 q = clamp(base + ivec2(i, j), ivec2(0), lowLast); "
+"    float w = (i == 1 ? f.x : 1.0 - f.x) * (j == 1 ? f.y : 1.0 - f.y); "
+"    w *= 1.0 / (0.001 + abs(z - texelFetch(lowDepth, q, 0).r) / z); "
+"    sum += texelFetch(clouds, q, 0) * w; total += w; "
+"  } "
+"  c = sum / max(total, 1e-5); }";
+
+// Impostor bake: the tree mesh seen from one direction, as colour and as
+// normal plus depth along the view relative to the tree's bounding sphere.
+// Unlit parts store a zero normal.
+const char* impostor_bake_vs_source = "#version 330 core\n"
+"layout(location=0) in vec3 p; layout(location=2) in vec3 n; layout(location=4) in float t_in; "
+"uniform mat4 viewProj; out vec3 worldPos; out vec3 normal; out float vType; "
+"void main(){ worldPos = p; normal = n; vType = t_in; gl_Position = viewProj * vec4(p, 1.0); }";
+
+const char* impostor_bake_fs_source = "#version 330 core\n"
+"layout(location=0) out vec4 albedo; layout(location=1) out vec4 normalDepth; "
+"in vec3 worldPos; in vec3 normal; in float vType; "
+"uniform vec3 baseColor; uniform vec3 center; uniform vec3 viewDir; uniform float radius; "
+"void main(){ "
+"  bool unlit = vType > 0.5; "
+"  albedo = vec4(unlit ? vec3(1.0) : baseColor, 1.0); "
+"  normalDepth = vec4(unlit ? vec3(0.5) : normalize(normal) * 0.5 + 0.5, dot(worldPos - center, viewDir) / radius * 0.5 + 0.5); }";
+
+// Impostor quad, one instance per tree: position in xyz and the impostor's
+// share of the cross-fade in w. The quad takes the baked view nearest to the
+// direction of the camera and lies in that view's image plane.
+const char* impostor_vs_source = "#version 330 core\n"
+"layout(location=0) in vec4 inst; "
+"layout(std140) uniform FrameUniforms { mat4 v; mat4 pr; }; uniform vec3 cameraPos; uniform vec3 center; uniform float radius; uniform float grid; "
+"uniform bool useProbes; uniform sampler3D probes; uniform vec3 probeOrigin; uniform vec3 probeSpacing; uniform vec3 probeCount; "
+"uniform bool useShadows; uniform sampler2DArrayShadow shadowMap; uniform mat4 cascadeMatrix[3]; uniform float cascadeFar[3]; uniform vec3 lightDir; "
+"out vec2 atlasUv; out vec3 quadPos; flat out vec3 frameDir; out float fade; flat out vec4 sh[7]; flat out float sun; "
+"vec2 octEncode(vec3 d){ "
+"  d /= abs(d.x) + abs(d.y) + abs(d.z); vec2 p = d.xz; "
+"  if(d.y < 0.0) p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0); "
+"  return p * 0.5 + 0.5; } "
+"vec3 octDecode(vec2 uv){ "
+"  vec2 p = uv * 2.0 - 1.0; vec3 d = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y); "
+"  if(d.y < 0.0) d.xz = (1.0 - abs(d.zx)) * vec2(d.x >= 0.0 ? 1.0 : -1.0, d.z >= 0.0 ? 1.0 : -1.0); "
+"  return normalize(d); } "
+"void main(){ "
+"  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0; "
+"  vec3 c = inst.xyz + center; "
+"  vec2 cell = min(floor(octEncode(normalize(cameraPos - c)) * grid), vec2(grid - 1.0)); "
+"  vec3 dir = octDecode((cell + 0.5) / grid); "
+"  vec3 right = normalize(cross(abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0), dir)); "
+"  vec3 up = cross(dir, right); "
+"  quadPos = c + (right * corner.x + up * corner.y) * radius; "
+"  atlasUv = (cell + corner * 0.5 + 0.5) / grid; "
+"  frameDir = dir; fade = inst.w; "
+"  vec3 g = clamp((c - probeOrigin) / probeSpacing, vec3(0.0), probeCount - 1.0) + 0.5; "
+"  for(int k = 0; k < 7; k++) sh[k] = useProbes ? texture(probes, vec3(g.x + float(k) * probeCount.x, g.y, g.z) / vec3(probeCount.x * 7.0, probeCount.yz)) : vec4(0.0); "
+"  sun = 1.0; "
+"  vec3 sp = c - normalize(lightDir) * radius; "
+"  float d = length(sp - cameraPos); "
+"  for(int i = 0; i < 3; i++){ "
+"    if(useShadows && d < cascadeFar[i]) { "
+"      vec4 s = cascadeMatrix[i] * vec4(sp, 1.0); "
+"      sun = texture(shadowMap, vec4(s.xy, float(i), s.z)); break; } } "
+"  gl_Position = pr * v * vec4(quadPos, 1.0); }";
+
+// Lit like the tree meshes without the exact lanterns, which barely reach
+// trees this far away: probe light and shadowed sun, both looked up once per
+// quad, the shadow just outside the tree on its sunny side. The dither is
+// the complement of the mesh's, so over the band every pixel shows exactly
+// one of the two.
+const char* impostor_fs_source = "#version 330 core\n"
+"out vec4 c; in vec2 atlasUv; in vec3 quadPos; flat in vec3 frameDir; in float fade; flat in vec4 sh[7]; flat in float sun; "
+"layout(std140) uniform FrameUniforms { mat4 v; mat4 pr; }; "
+"uniform sampler2D albedo; uniform sampler2D normalDepth; uniform vec3 lightDir; uniform float radius; uniform bool overdraw; "
+"uniform bool useProbes; "
+"vec3 ProbeIrradiance(vec3 nrm){ "
+"  float x = nrm.x, y = nrm.y, z = nrm.z; "
+"  return sh[0].xyz * 0.282095 "
+"    + vec3(sh[0].w, sh[1].xy) * (0.488603 * y) + vec3(sh[1].zw, sh[2].x) * (0.488603 * z) + sh[2].yzw * (0.488603 * x) "
+"    + sh[3].xyz * (1.092548 * x * y) + vec3(sh[3].w, sh[4].xy) * (1.092548 * y * z) "
+"    + vec3(sh[4].zw, sh[5].x) * (0.315392 * (3.0 * z * z - 1.0)) + sh[5].yzw * (1.092548 * x * z) "
+"    + sh[6].xyz * (0.546274 * (x * x - y * y)); } "
+"void main(){ "
+"  vec4 a = texture(albedo, atlasUv); "
+"  if(a.a < 0.5) discard; "
+"  float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))); "
+"  if(noise < 1.0 - fade) discard; "
+"  vec4 nd = texture(normalDepth, atlasUv); "
+"  vec4 clip = pr * v * vec4(quadPos + frameDir * (nd.a * 2.0 - 1.0) * radius, 1.0); "
+"  gl_FragDepth = clip.z / clip.w * 0.5 + 0.5; "
+"  if(overdraw) { c = vec4(1.0 / 255.0, 0.0, 0.0, 1.0); return; } "
+"  vec3 n = nd.rgb * 2.0 - 1.0; "
+"  vec3 lighting = vec3(1.0); "
+"  if(length(n) >= 0.5) { "
+"    n = normalize(n); "
+"    lighting = useProbes ? max(ProbeIrradiance(n), vec3(0.0)) : vec3(0.3, 0.3, 0.4); "
+"    lighting += max(dot(n, -normalize(lightDir)), 0.0) * 0.5 * sun; } "
+"  c = vec4(a.rgb * lighting, 1.0); }";
+
+inline unsigned int CompileProgram(const char* vsSource, const char* fsSource) {
     unsigned int pvs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(pvs, 1, &vs_source, 0);
+    glShaderSource(pvs, 1, &vsSource, 0);
     glCompileShader(pvs);
     
     int success;
@@ -86,7 +413,7 @@ inline unsigned int CreateShaderProgram() {
     }
 
     unsigned int pfs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(pfs, 1, &fs_source, 0);
+    glShaderSource(pfs, 1, &fsSource, 0);
     glCompileShader(pfs);
     
     glGetShaderiv(pfs, GL_COMPILE_STATUS, &success);
@@ -114,4 +441,40 @@ inline unsigned int CreateShaderProgram() {
     return prog;
 }
 
+// Vertex-only program whose output `varying` is captured by transform
+// feedback instead of being rasterized.
+inline unsigned int CompileFeedbackProgram(const char* vsSource, const char* varying) {
+    unsigned int pvs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pvs, 1, &vsSource, 0);
+    glCompileShader(pvs);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(pvs, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(pvs, 512, NULL, infoLog);
+        std::cerr << "VERTEX SHADER COMPILATION FAILED:\n" << infoLog << std::endl;
+        return 0;
+    }
+
+    unsigned int prog = glCreateProgram();
+    glAttachShader(prog, pvs);
+    glTransformFeedbackVaryings(prog, 1, &varying, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(prog);
+
+    glGetProgramiv(prog, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(prog, 512, NULL, infoLog);
+        std::cerr << "SHADER PROGRAM LINKING FAILED:\n" << infoLog << std::endl;
+        return 0;
+    }
+
+    glDeleteShader(pvs);
+    return prog;
+}
+
+inline unsigned int CreateShaderProgram() {
+    return CompileProgram(vs_source, fs_source);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,302 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "framebench.h"
+#include "shaders.h"
+
+const int SHADOW_CASCADES = 3;
+const int SHADOW_MAP_SIZE = 2048;
+// Far end of each cascade, as distance from the camera. Nothing past the
+// last one is shadowed.
+const float SHADOW_SPLITS[SHADOW_CASCADES] = { 150.0f, 600.0f, 3000.0f };
+// Cascades cover their slice's bounding sphere plus this share of its
+// radius, so the cached static depth survives camera moves up to the slack.
+const float SHADOW_CACHE_MARGIN = 0.5f;
+// Casters this far towards the sun from a cascade's center still land in it.
+const float SHADOW_DEPTH_RANGE = 4000.0f;
+const float SHADOW_SLOPE_BIAS = 2.0f;
+const float SHADOW_CONSTANT_BIAS = 4.0f;
+const unsigned int SHADOW_TEXTURE_UNIT = 4;
+
+// How a caster reaches world space in shadow_vs_source.
+enum ShadowCasterMode {
+    SHADOW_MODEL = 0,
+    SHADOW_OFFSETS = 1,
+    SHADOW_INSTANCES = 2
+};
+
+// Cascaded shadow maps for the sun. Static casters are rendered into a
+// cache per cascade, and only when the cascade has to move: each covers more
+// than its slice of the view, and is re-centered on whole texels once the
+// slice would leave it. Every frame the caches are copied to the sampled
+// maps and the moving casters drawn over them, so the pass costs what moved.
+class ShadowCascades {
+public:
+    // `fovY`, `aspect` and `near` describe the camera's projection;
+    // `lightDir` is the direction the sunlight travels.
+    bool Init(float fovY, float aspect, float near, const glm::vec3& lightDir, unsigned int sceneProgram) {
+        program = CompileProgram(shadow_vs_source, shadow_fs_source);
+        if (!program) return false;
+        lightViewProjLoc = glGetUniformLocation(program, "lightViewProj");
+        modelLoc = glGetUniformLocation(program, "m");
+        modeLoc = glGetUniformLocation(program, "mode");
+
+        direction = glm::normalize(lightDir);
+        rotation = glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        // Bounding sphere of each slice of the view frustum, on the view
+        // axis. Its size does not change as the camera turns, which keeps
+        // the cascades' texel size fixed.
+        float th = std::tan(fovY * 0.5f);
+        float tw = th * aspect;
+        float k2 = tw * tw + th * th;
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            float n = i == 0 ? near : SHADOW_SPLITS[i - 1];
+            float f = SHADOW_SPLITS[i];
+            cascades[i].centerDistance = std::min(f, 0.5f * (f + n) * (1.0f + k2));
+            float dz = f - cascades[i].centerDistance;
+            cascades[i].radius = std::sqrt(dz * dz + f * f * k2);
+            cascades[i].halfExtent = cascades[i].radius * (1.0f + SHADOW_CACHE_MARGIN);
+        }
+
+        cached = CreateArray();
+        maps = CreateArray();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, maps);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        bool complete = true;
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            cachedFbo[i] = CreateLayerFbo(cached, i, complete);
+            mapFbo[i] = CreateLayerFbo(maps, i, complete);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            std::cerr << "Shadow map framebuffer incomplete" << std::endl;
+            return false;
+        }
+
+        useShadowsLoc = glGetUniformLocation(sceneProgram, "useShadows");
+        cascadeMatrixLoc = glGetUniformLocation(sceneProgram, "cascadeMatrix");
+        cascadeFarLoc = glGetUniformLocation(sceneProgram, "cascadeFar");
+        cascadeTexelLoc = glGetUniformLocation(sceneProgram, "cascadeTexel");
+        cameraPosLoc = glGetUniformLocation(sceneProgram, "cameraPos");
+        glUseProgram(sceneProgram);
+        glUniform1fv(cascadeFarLoc, SHADOW_CASCADES, SHADOW_SPLITS);
+        float texels[SHADOW_CASCADES];
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            texels[i] = 2.0f * cascades[i].halfExtent / static_cast<float>(SHADOW_MAP_SIZE);
+        }
+        glUniform1fv(cascadeTexelLoc, SHADOW_CASCADES, texels);
+        glUniform1i(useShadowsLoc, 1);
+        return true;
+    }
+
+    bool Initialized() const { return program != 0; }
+
+    // Cascades whose static depth was redrawn in the last Render().
+    int Rebuilt() const { return rebuilt; }
+
+    // Fits the cascades to `view`. No GL calls, so the frame's jobs can do
+    // it and then cull casters with InCascade before Render().
+    void Fit(const glm::mat4& view) {
+        glm::mat4 inverseView = glm::inverse(view);
+        cameraPos = glm::vec3(inverseView[3]);
+        glm::vec3 forward = -glm::normalize(glm::vec3(inverseView[2]));
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            moved[i] = FitCascade(i, cameraPos + forward * cascades[i].centerDistance);
+        }
+    }
+
+    // Brings the maps up to date with the last Fit(). drawStatic(cascade)
+    // is called only for cascades that moved and drawDynamic(cascade) for
+    // all of them; both draw with DrawMesh, DrawOffsets or DrawInstances,
+    // which add to `counters`. Leaves the framebuffer, viewport and
+    // `sceneProgram` as they were.
+    template <typename StaticFn, typename DynamicFn>
+    void Render(unsigned int sceneProgram, RenderCounters& counters, StaticFn drawStatic, DynamicFn drawDynamic) {
+        frameCounters = &counters;
+        GLint previousFbo = 0;
+        GLint viewport[4];
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glUseProgram(program);
+        glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
+
+        rebuilt = 0;
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            if (!moved[i]) continue;
+            moved[i] = false;
+            rebuilt++;
+            glBindFramebuffer(GL_FRAMEBUFFER, cachedFbo[i]);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glUniformMatrix4fv(lightViewProjLoc, 1, GL_FALSE, glm::value_ptr(cascades[i].viewProj));
+            drawStatic(i);
+        }
+
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, cachedFbo[i]);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mapFbo[i]);
+            glBlitFramebuffer(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+                GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, mapFbo[i]);
+            glUniformMatrix4fv(lightViewProjLoc, 1, GL_FALSE, glm::value_ptr(cascades[i].viewProj));
+            drawDynamic(i);
+        }
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glEnable(GL_CULL_FACE);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glUseProgram(sceneProgram);
+        frameCounters = nullptr;
+    }
+
+    // True if a sphere can cast into `cascade`.
+    bool InCascade(int cascade, const glm::vec3& center, float radius) const {
+        glm::vec3 ls = glm::vec3(rotation * glm::vec4(center, 1.0f));
+        float reach = cascades[cascade].halfExtent + radius;
+        return std::fabs(ls.x - cascades[cascade].center.x) <= reach && std::fabs(ls.y - cascades[cascade].center.y) <= reach;
+    }
+
+    void DrawMesh(unsigned int vao, int vertexCount, const glm::mat4& model) {
+        glUniform1i(modeLoc, SHADOW_MODEL);
+        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        if (frameCounters) frameCounters->Add(vertexCount);
+    }
+
+    // Instances offset by attribute 5, as create_obj sets it up.
+    void DrawOffsets(unsigned int vao, int vertexCount, int instances) {
+        glUniform1i(modeLoc, SHADOW_OFFSETS);
+        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+        glBindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instances);
+        if (frameCounters) frameCounters->Add(vertexCount, instances);
+    }
+
+    // Instances from an InstanceStream the caller has bound to `vao`.
+    void DrawInstances(unsigned int vao, int vertexCount, int instances) {
+        glUniform1i(modeLoc, SHADOW_INSTANCES);
+        glBindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instances);
+        if (frameCounters) frameCounters->Add(vertexCount, instances);
+    }
+
+    // World to shadow map coordinates and depth of each cascade.
+    void Lookups(glm::mat4 out[SHADOW_CASCADES]) const {
+        glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+        for (int i = 0; i < SHADOW_CASCADES; i++) out[i] = bias * cascades[i].viewProj;
+    }
+
+    // Binds the maps and sets the scene program's lookup uniforms; the
+    // scene program must be current.
+    void Bind() {
+        glm::mat4 lookups[SHADOW_CASCADES];
+        Lookups(lookups);
+        glUniformMatrix4fv(cascadeMatrixLoc, SHADOW_CASCADES, GL_FALSE, glm::value_ptr(lookups[0]));
+        glUniform3f(cameraPosLoc, cameraPos.x, cameraPos.y, cameraPos.z);
+        glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, maps);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    struct Cascade {
+        float centerDistance = 0.0f;
+        float radius = 0.0f;
+        float halfExtent = 0.0f;
+        bool valid = false;
+        // Light-space center the cached depth was drawn around.
+        glm::vec3 center = glm::vec3(0.0f);
+        glm::mat4 viewProj = glm::mat4(1.0f);
+    };
+
+    // Moves cascade `i` if its slice, centered at `sliceCenter`, no longer
+    // fits. Returns true when it moved.
+    bool FitCascade(int i, const glm::vec3& sliceCenter) {
+        Cascade& c = cascades[i];
+        glm::vec3 ls = glm::vec3(rotation * glm::vec4(sliceCenter, 1.0f));
+        float slack = c.halfExtent - c.radius;
+        if (c.valid && std::fabs(ls.x - c.center.x) <= slack && std::fabs(ls.y - c.center.y) <= slack
+            && std::fabs(ls.z - c.center.z) <= SHADOW_DEPTH_RANGE * 0.5f) {
+            return false;
+        }
+
+        // Whole texels only, so static edges do not crawl when it moves.
+        float texel = 2.0f * c.halfExtent / static_cast<float>(SHADOW_MAP_SIZE);
+        c.center = glm::vec3(std::floor(ls.x / texel) * texel, std::floor(ls.y / texel) * texel, ls.z);
+        c.valid = true;
+
+        glm::vec3 world = glm::vec3(glm::inverse(rotation) * glm::vec4(c.center, 1.0f));
+        glm::mat4 lightView = glm::lookAt(world - direction * SHADOW_DEPTH_RANGE, world, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 lightProj = glm::ortho(-c.halfExtent, c.halfExtent, -c.halfExtent, c.halfExtent, 0.0f, 2.0f * SHADOW_DEPTH_RANGE);
+        c.viewProj = lightProj * lightView;
+        return true;
+    }
+
+    static unsigned int CreateArray() {
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, 0,
+            GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+
+    static unsigned int CreateLayerFbo(unsigned int texture, int layer, bool& complete) {
+        unsigned int fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        return fbo;
+    }
+
+    unsigned int program = 0;
+    int lightViewProjLoc = -1;
+    int modelLoc = -1;
+    int modeLoc = -1;
+
+    int useShadowsLoc = -1;
+    int cascadeMatrixLoc = -1;
+    int cascadeFarLoc = -1;
+    int cascadeTexelLoc = -1;
+    int cameraPosLoc = -1;
+
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::mat4 rotation = glm::mat4(1.0f);
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    Cascade cascades[SHADOW_CASCADES];
+    bool moved[SHADOW_CASCADES] = {};
+    unsigned int cached = 0;
+    unsigned int maps = 0;
+    unsigned int cachedFbo[SHADOW_CASCADES] = {};
+    unsigned int mapFbo[SHADOW_CASCADES] = {};
+    int rebuilt = 0;
+    // Set for the duration of Render().
+    RenderCounters* frameCounters = nullptr;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "simulation.h"
+#include "triplebuffer.h"
+
+const float SIM_TICK_RATE = 120.0f;
+const int SIM_MAX_CATCHUP_TICKS = 8;
+
+inline double SimClockSeconds() {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+// The same fixed-rate ticking driven by frame times instead of the clock,
+// for recorded and replayed runs: equal frame times give equal ticks.
+class FixedStepClock {
+public:
+    explicit FixedStepClock(float tickRate = SIM_TICK_RATE) : tickDt(1.0f / tickRate) {}
+
+    // Ticks due after `dt` more seconds, capped like the simulation thread.
+    int Advance(float dt) {
+        accumulator += dt;
+        int ticks = 0;
+        while (accumulator >= tickDt && ticks < SIM_MAX_CATCHUP_TICKS) {
+            accumulator -= tickDt;
+            ticks++;
+        }
+        if (accumulator >= tickDt) accumulator = 0.0;
+        return ticks;
+    }
+
+    float TickDt() const { return tickDt; }
+
+    // How far the next tick is, for interpolating between the last two.
+    float Alpha() const { return static_cast<float>(accumulator / tickDt); }
+
+private:
+    float tickDt;
+    double accumulator = 0.0;
+};
+
+// The last two ticks and when the newer one was due, so the renderer can
+// interpolate between them one tick behind.
+struct SimSnapshot {
+    GameState prev;
+    GameState curr;
+    double tickTime = 0.0;
+
+    // Position between prev and curr at `now`, clamped to them.
+    float Alpha(double now, float tickDt) const {
+        float alpha = static_cast<float>((now - tickTime) / tickDt);
+        return std::max(0.0f, std::min(1.0f, alpha));
+    }
+};
+
+// Runs StepSimulation at a fixed rate on its own thread and publishes the
+// last two ticks to the renderer through a triple buffer.
+class SimulationThread {
+public:
+    ~SimulationThread() { Stop(); }
+
+    void Start(const GameState& initial, float tickRate = SIM_TICK_RATE, JobSystem* jobSystem = nullptr) {
+        state = initial;
+        jobs = jobSystem;
+        tickDt = 1.0f / tickRate;
+        SimSnapshot& first = snapshots.WriteBuffer();
+        first.prev = state;
+        first.curr = state;
+        first.tickTime = SimClockSeconds();
+        snapshots.Publish();
+
+        running = true;
+        worker = std::thread(&SimulationThread::Run, this);
+    }
+
+    void Stop() {
+        running = false;
+        if (worker.joinable()) worker.join();
+    }
+
+    // Held keys and camera direction; replaced every render frame.
+    void SetInput(const SimInput& in) {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        int drops = input.dropRequests;
+        input = in;
+        input.dropRequests = drops;
+    }
+
+    // Edge-triggered actions are queued so a short key press is never lost
+    // between two ticks.
+    void RequestDrop() {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.dropRequests++;
+    }
+
+    TripleBuffer<SimSnapshot>& Snapshots() { return snapshots; }
+
+    float TickDt() const { return tickDt; }
+    float TicksPerSecond() const { return ticksPerSecond.load(std::memory_order_relaxed); }
+    float AverageStepMs() const { return averageStepMs.load(std::memory_order_relaxed); }
+
+private:
+    void Run() {
+        PROFILE_THREAD("Simulation");
+        double nextTick = SimClockSeconds();
+        double rateWindowStart = nextTick;
+        int rateWindowTicks = 0;
+        double rateWindowStepTime = 0.0;
+
+        while (running) {
+            double now = SimClockSeconds();
+            int ticks = 0;
+
+            while (now >= nextTick && ticks < SIM_MAX_CATCHUP_TICKS) {
+                SimInput tickInput;
+                {
+                    std::lock_guard<std::mutex> lock(inputMutex);
+                    tickInput = input;
+                    input.dropRequests = 0;
+                }
+
+                // Only the last tick of a catch-up burst needs its
+                // predecessor kept.
+                bool last = now < nextTick + tickDt || ticks + 1 >= SIM_MAX_CATCHUP_TICKS;
+                if (last) snapshots.WriteBuffer().prev = state;
+
+                double stepStart = SimClockSeconds();
+                StepSimulation(state, tickInput, tickDt, jobs);
+                rateWindowStepTime += SimClockSeconds() - stepStart;
+
+                nextTick += tickDt;
+                ticks++;
+                rateWindowTicks++;
+            }
+
+            if (ticks > 0) {
+                SimSnapshot& snapshot = snapshots.WriteBuffer();
+                snapshot.curr = state;
+                snapshot.tickTime = nextTick - tickDt;
+                snapshots.Publish();
+            }
+
+            if (ticks == SIM_MAX_CATCHUP_TICKS && now >= nextTick) {
+                nextTick = now;
+            }
+
+            if (now - rateWindowStart >= 1.0) {
+                ticksPerSecond.store(static_cast<float>(rateWindowTicks / (now - rateWindowStart)), std::memory_order_relaxed);
+                if (rateWindowTicks > 0) {
+                    averageStepMs.store(static_cast<float>(rateWindowStepTime * 1000.0 / rateWindowTicks), std::memory_order_relaxed);
+                }
+                rateWindowStart = now;
+                rateWindowTicks = 0;
+                rateWindowStepTime = 0.0;
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0.0, nextTick - SimClockSeconds())));
+        }
+    }
+
+    GameState state;
+    JobSystem* jobs = nullptr;
+    float tickDt = 1.0f / SIM_TICK_RATE;
+
+    std::mutex inputMutex;
+    SimInput input;
+
+    TripleBuffer<SimSnapshot> snapshots;
+
+    std::atomic<bool> running{ false };
+    std::atomic<float> ticksPerSecond{ 0.0f };
+    std::atomic<float> averageStepMs{ 0.0f };
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,439 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "heightfield.h"
+#include "jobsystem.h"
+#include "log.h"
+#include "profiler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846f
+#endif
+
+// Counts of the classic scene. Stress scenes (scene.h) change them at runtime.
+const int NUM_HOUSES = 8;
+const int NUM_SLEDS = 3;
+const int SLED_RINGS = 48;
+
+const float PACKAGE_SPEED = 600.0f;
+const float PACKAGE_LIFETIME = 6.0f;
+const float PACKAGE_GRAVITY = 150.0f;
+const float PACKAGE_RADIUS = 6.0f;
+const float HOUSE_HIT_RADIUS = 40.0f;
+// Houses are the unit house mesh scaled by this.
+const float HOUSE_SCALE = 30.0f;
+const float AIRSHIP_SPEED = 400.0f;
+const int PACKAGE_PARALLEL_GRAIN = 256;
+
+// Small deterministic generator so a seed reproduces a whole run on any
+// platform, independent of std::rand.
+struct SimRandom {
+    unsigned int state = 0x12345678u;
+
+    void Seed(unsigned int seed) {
+        state = seed * 2654435761u + 0x9E3779B9u;
+        if (state == 0) state = 0x12345678u;
+    }
+
+    unsigned int Next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    int Range(int n) {
+        return static_cast<int>(Next() % static_cast<unsigned int>(n));
+    }
+};
+
+inline bool& SimEventLogging() {
+    static bool enabled = true;
+    return enabled;
+}
+
+struct Sled {
+    glm::vec3 position;
+    float angle;
+    float speed;
+    float radius;
+    float bobOffset;
+};
+
+struct Package {
+    unsigned int id;
+    glm::vec3 pos;
+    glm::vec3 velocity;
+    float lifeTime;
+    bool active;
+    glm::vec3 color;
+};
+
+struct GameState {
+    unsigned long long tick = 0;
+    double gameTime = 0.0;
+
+    glm::vec3 airshipPos = glm::vec3(0.0f, 300.0f, 0.0f);
+
+    std::vector<glm::vec3> housePositions;
+    std::vector<glm::vec3> houseColors;
+    std::vector<char> houseNeedsDelivery;
+    std::vector<float> houseDeliveryTimers;
+
+    std::vector<Sled> sleds;
+
+    std::vector<Package> packages;
+    unsigned int nextPackageId = 0;
+
+    int score = 0;
+    int deliveriesCompleted = 0;
+
+    // Packages per second fired automatically in random directions, for
+    // stress scenes.
+    float autofireRate = 0.0f;
+    float autofireAccumulator = 0.0f;
+
+    SimRandom rng;
+
+    int HouseCount() const { return static_cast<int>(housePositions.size()); }
+    int SledCount() const { return static_cast<int>(sleds.size()); }
+};
+
+// Input sampled by the render thread; the simulation only ever reads a copy.
+struct SimInput {
+    bool forward = false;
+    bool back = false;
+    bool left = false;
+    bool right = false;
+    bool up = false;
+    bool down = false;
+    bool aimMode = false;
+    glm::vec3 cameraForward = glm::vec3(0.0f, 0.0f, 1.0f);
+    int dropRequests = 0;
+};
+
+inline void InitGameState(GameState& s, unsigned int seed, int houseCount = NUM_HOUSES, int sledCount = NUM_SLEDS) {
+    s.rng.Seed(seed);
+
+    s.housePositions.resize(houseCount);
+    s.houseColors.resize(houseCount);
+    s.houseNeedsDelivery.resize(houseCount);
+    s.houseDeliveryTimers.resize(houseCount);
+    s.sleds.resize(sledCount);
+
+    for (int i = 0; i < houseCount; i++) {
+        s.housePositions[i] = glm::vec3(
+            static_cast<float>(s.rng.Range(4000) - 2000),
+            15.0f,
+            static_cast<float>(s.rng.Range(4000) - 2000)
+        );
+
+        s.houseColors[i] = glm::vec3(
+            static_cast<float>(s.rng.Range(70) + 30) / 100.0f,
+            static_cast<float>(s.rng.Range(70) + 30) / 100.0f,
+            static_cast<float>(s.rng.Range(70) + 30) / 100.0f
+        );
+
+        s.houseNeedsDelivery[i] = true;
+        s.houseDeliveryTimers[i] = static_cast<float>(s.rng.Range(10) + 5);
+    }
+
+    for (int i = 0; i < sledCount; i++) {
+        // Radii repeat every SLED_RINGS sleds and speeds cycle through the
+        // classic scene's three, so stress scenes never turn faster than
+        // 0.6 rad/s.
+        float radius = 120.0f + static_cast<float>(i % SLED_RINGS) * 40.0f;
+        float angle = static_cast<float>(i) * (2.0f * M_PI / sledCount);
+
+        s.sleds[i].radius = radius;
+        s.sleds[i].angle = angle;
+        s.sleds[i].speed = 0.3f + static_cast<float>(i % NUM_SLEDS) * 0.15f;
+        s.sleds[i].bobOffset = static_cast<float>(s.rng.Range(100)) / 100.0f * 2.0f * M_PI;
+
+        s.sleds[i].position = glm::vec3(
+            sin(angle) * radius,
+            20.0f,
+            cos(angle) * radius + 200.0f
+        );
+    }
+}
+
+// Ballistic step over dt: the exact parabola end point and the new velocity.
+// Collisions are tested along the chord p0 -> p1.
+inline void IntegratePackage(const glm::vec3& p0, const glm::vec3& v0, float dt, glm::vec3& p1, glm::vec3& v1) {
+    glm::vec3 gravity(0.0f, -PACKAGE_GRAVITY, 0.0f);
+    p1 = p0 + v0 * dt + gravity * (0.5f * dt * dt);
+    v1 = v0 + gravity * dt;
+}
+
+// Swept sphere against a house bound: the fraction of p0 -> p1 at which a
+// package first touches the house, or a value above 1 if it does not.
+inline float SweptHouseHit(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& house) {
+    const float radius = HOUSE_HIT_RADIUS + PACKAGE_RADIUS;
+    glm::vec3 d = p1 - p0;
+    glm::vec3 m = p0 - house;
+    float c = glm::dot(m, m) - radius * radius;
+    if (c <= 0.0f) return 0.0f;
+
+    float b = glm::dot(m, d);
+    if (b >= 0.0f) return 2.0f;
+
+    float a = glm::dot(d, d);
+    float disc = b * b - a * c;
+    if (disc < 0.0f) return 2.0f;
+    return (-b - std::sqrt(disc)) / a;
+}
+
+// Earliest house that still wants a delivery along p0 -> p1, before `limit`.
+inline int FirstHouseHit(const GameState& s, const glm::vec3& p0, const glm::vec3& p1, float limit) {
+    int house = -1;
+    float best = std::min(limit, 1.0f);
+    for (int i = 0; i < s.HouseCount(); i++) {
+        if (!s.houseNeedsDelivery[i]) continue;
+        float t = SweptHouseHit(p0, p1, s.housePositions[i]);
+        if (t <= best && (house < 0 || t < best)) {
+            house = i;
+            best = t;
+        }
+    }
+    return house;
+}
+
+inline void StepSimulation(GameState& s, const SimInput& input, float dt, JobSystem* jobs = nullptr) {
+    PROFILE_SCOPE("StepSimulation");
+    s.tick++;
+    s.gameTime += dt;
+
+    for (int i = 0; i < s.SledCount(); i++) {
+        Sled& sled = s.sleds[i];
+        sled.angle += sled.speed * dt;
+
+        sled.position.x = sin(sled.angle) * sled.radius;
+        sled.position.z = cos(sled.angle) * sled.radius + 200.0f;
+
+        sled.position.y = 20.0f + static_cast<float>(sin(s.gameTime * 2.0 + sled.bobOffset)) * 3.0f;
+    }
+
+    for (int d = 0; d < input.dropRequests; d++) {
+        Package newPackage;
+        newPackage.id = s.nextPackageId++;
+        newPackage.pos = input.aimMode ? s.airshipPos + glm::vec3(0.0f, 20.0f, 0.0f) : s.airshipPos;
+
+        glm::vec3 shotDir = input.cameraForward;
+        if (!input.aimMode) shotDir = -shotDir;
+
+        newPackage.velocity = glm::normalize(shotDir) * PACKAGE_SPEED;
+        newPackage.lifeTime = PACKAGE_LIFETIME;
+        newPackage.active = true;
+        newPackage.color = glm::vec3(1.0f, 0.9f, 0.3f);
+
+        s.packages.push_back(newPackage);
+
+        if (SimEventLogging()) {
+            LOG_INFO("Package dropped! Total packages: " << s.packages.size());
+        }
+    }
+
+    s.autofireAccumulator += s.autofireRate * dt;
+    while (s.autofireAccumulator >= 1.0f) {
+        s.autofireAccumulator -= 1.0f;
+
+        float yaw = static_cast<float>(s.rng.Range(3600)) / 3600.0f * 2.0f * M_PI;
+        float pitch = static_cast<float>(s.rng.Range(50) - 30) * (M_PI / 180.0f);
+
+        Package newPackage;
+        newPackage.id = s.nextPackageId++;
+        newPackage.pos = s.airshipPos;
+        newPackage.velocity = glm::vec3(sin(yaw) * cos(pitch), sin(pitch), cos(yaw) * cos(pitch)) * PACKAGE_SPEED;
+        newPackage.lifeTime = PACKAGE_LIFETIME;
+        newPackage.active = true;
+        newPackage.color = glm::vec3(1.0f, 0.6f, 0.3f);
+        s.packages.push_back(newPackage);
+    }
+
+    // Movement, ground and house tests run in parallel; each package only
+    // records the first house it touches. Hits are then applied in spawn
+    // order, so the outcome does not depend on how the range was split.
+    // Everything is swept over the whole step, so the result does not depend
+    // on the tick length either.
+    struct PackageStep {
+        glm::vec3 from;
+        float groundHit;
+        int house;
+    };
+    thread_local std::vector<PackageStep> steps;
+    steps.resize(s.packages.size());
+    PackageStep* results = steps.data();
+
+    auto movePackages = [&s, results, dt](int begin, int end) {
+        PROFILE_SCOPE("Move packages");
+        const HeightField& ground = TerrainHeightField();
+        thread_local std::vector<float> sampleX, sampleZ, sampleH;
+        sampleX.clear();
+        sampleZ.clear();
+
+        for (int k = begin; k < end; k++) {
+            Package& pkg = s.packages[k];
+            PackageStep& r = results[k];
+            r.from = pkg.pos;
+            r.groundHit = 2.0f;
+            r.house = -1;
+            if (!pkg.active) continue;
+
+            glm::vec3 p1, v1;
+            IntegratePackage(pkg.pos, pkg.velocity, dt, p1, v1);
+            pkg.pos = p1;
+            pkg.velocity = v1;
+            pkg.lifeTime -= dt;
+
+            if (pkg.lifeTime <= 0) {
+                pkg.active = false;
+                continue;
+            }
+
+            int marchSteps = ground.MarchSteps(p1.x - r.from.x, p1.z - r.from.z);
+            for (int j = 1; j <= marchSteps; j++) {
+                float f = static_cast<float>(j) / static_cast<float>(marchSteps);
+                sampleX.push_back(r.from.x + (p1.x - r.from.x) * f);
+                sampleZ.push_back(r.from.z + (p1.z - r.from.z) * f);
+            }
+        }
+
+        sampleH.resize(sampleX.size());
+        ground.SampleBatch(sampleX.data(), sampleZ.data(), sampleH.data(), static_cast<int>(sampleX.size()));
+
+        size_t sample = 0;
+        for (int k = begin; k < end; k++) {
+            Package& pkg = s.packages[k];
+            PackageStep& r = results[k];
+            if (!pkg.active) continue;
+
+            int marchSteps = ground.MarchSteps(pkg.pos.x - r.from.x, pkg.pos.z - r.from.z);
+            for (int j = 1; j <= marchSteps && r.groundHit > 1.0f; j++) {
+                float f = static_cast<float>(j) / static_cast<float>(marchSteps);
+                float y = r.from.y + (pkg.pos.y - r.from.y) * f;
+                if (y - PACKAGE_RADIUS <= sampleH[sample + j - 1]) {
+                    float prev = static_cast<float>(j - 1) / static_cast<float>(marchSteps);
+                    r.groundHit = ground.RefineGroundHit(r.from, pkg.pos, PACKAGE_RADIUS, prev, f);
+                }
+            }
+            sample += marchSteps;
+
+            r.house = FirstHouseHit(s, r.from, pkg.pos, r.groundHit);
+        }
+    };
+
+    int packageCount = static_cast<int>(s.packages.size());
+    if (jobs) {
+        jobs->ParallelFor(0, packageCount, PACKAGE_PARALLEL_GRAIN, movePackages);
+    }
+    else {
+        movePackages(0, packageCount);
+    }
+
+    {
+        PROFILE_SCOPE("Resolve hits");
+        for (int k = 0; k < packageCount; k++) {
+            Package& pkg = s.packages[k];
+            if (!pkg.active) continue;
+
+            const PackageStep& r = steps[k];
+            int i = r.house;
+            if (i >= 0 && !s.houseNeedsDelivery[i]) {
+                i = FirstHouseHit(s, r.from, pkg.pos, r.groundHit);
+            }
+
+            if (i >= 0) {
+                s.houseNeedsDelivery[i] = false;
+                pkg.active = false;
+                s.score += 10;
+                s.deliveriesCompleted++;
+
+                if (SimEventLogging()) {
+                    LOG_INFO("Hit house " << i << "! Score: " << s.score
+                        << " Deliveries: " << s.deliveriesCompleted << "/" << s.HouseCount());
+                }
+            }
+            else if (r.groundHit <= 1.0f) {
+                pkg.pos = r.from + (pkg.pos - r.from) * r.groundHit;
+                pkg.active = false;
+            }
+        }
+    }
+
+    s.packages.erase(std::remove_if(s.packages.begin(), s.packages.end(),
+        [](const Package& p) { return !p.active; }), s.packages.end());
+
+    for (int i = 0; i < s.HouseCount(); i++) {
+        if (!s.houseNeedsDelivery[i]) {
+            s.houseDeliveryTimers[i] -= dt;
+            if (s.houseDeliveryTimers[i] <= 0) {
+                s.houseNeedsDelivery[i] = true;
+                s.houseDeliveryTimers[i] = static_cast<float>(s.rng.Range(10) + 8);
+                if (SimEventLogging()) {
+                    LOG_INFO("House " << i << " needs delivery again!");
+                }
+            }
+        }
+    }
+
+    float moveSpeed = AIRSHIP_SPEED * dt;
+    glm::vec3 camForward = input.cameraForward;
+    if (!input.aimMode) camForward = -camForward;
+
+    glm::vec3 flatForward = glm::normalize(glm::vec3(camForward.x, 0.0f, camForward.z));
+    glm::vec3 flatRight = glm::normalize(glm::cross(flatForward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    if (input.forward) s.airshipPos += flatForward * moveSpeed;
+    if (input.back) s.airshipPos -= flatForward * moveSpeed;
+    if (input.left) s.airshipPos -= flatRight * moveSpeed;
+    if (input.right) s.airshipPos += flatRight * moveSpeed;
+    if (input.up) s.airshipPos.y += moveSpeed;
+    if (input.down) s.airshipPos.y -= moveSpeed;
+
+    s.airshipPos.y = std::max(50.0f, std::min(1000.0f, s.airshipPos.y));
+}
+
+// Blends two consecutive ticks for rendering. Packages are matched by id;
+// both lists are kept in spawn order, so a single merge walk is enough.
+inline void InterpolateState(const GameState& prev, const GameState& curr, float alpha, GameState& out) {
+    out.tick = curr.tick;
+    out.gameTime = prev.gameTime + (curr.gameTime - prev.gameTime) * alpha;
+    out.airshipPos = prev.airshipPos + (curr.airshipPos - prev.airshipPos) * alpha;
+
+    out.housePositions = curr.housePositions;
+    out.houseColors = curr.houseColors;
+    out.houseNeedsDelivery = curr.houseNeedsDelivery;
+    out.houseDeliveryTimers = curr.houseDeliveryTimers;
+
+    out.sleds = curr.sleds;
+    for (int i = 0; i < curr.SledCount() && i < prev.SledCount(); i++) {
+        out.sleds[i].angle = prev.sleds[i].angle + (curr.sleds[i].angle - prev.sleds[i].angle) * alpha;
+        out.sleds[i].position = prev.sleds[i].position + (curr.sleds[i].position - prev.sleds[i].position) * alpha;
+    }
+
+    out.packages.clear();
+    size_t j = 0;
+    for (const auto& pkg : curr.packages) {
+        while (j < prev.packages.size() && prev.packages[j].id < pkg.id) j++;
+
+        Package p = pkg;
+        if (j < prev.packages.size() && prev.packages[j].id == pkg.id) {
+            p.pos = prev.packages[j].pos + (pkg.pos - prev.packages[j].pos) * alpha;
+        }
+        out.packages.push_back(p);
+    }
+
+    out.nextPackageId = curr.nextPackageId;
+    out.score = curr.score;
+    out.deliveriesCompleted = curr.deliveriesCompleted;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef SNOW_H
+#define SNOW_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "latency.h"
+#include "scenedepth.h"
+#include "shaders.h"
+
+// Half-size of the box of flakes kept around the camera. Anything outside
+// it is never simulated or drawn.
+const glm::vec3 SNOW_EXTENT(1500.0f, 700.0f, 1500.0f);
+
+const glm::vec2 SNOW_WIND(25.0f, 10.0f);
+const float SNOW_FLAKE_SIZE = 2.5f;
+
+// Flakes fade out towards this distance and within this depth of the
+// surface behind them.
+const float SNOW_FADE_DISTANCE = 1400.0f;
+const float SNOW_SOFTNESS = 40.0f;
+
+// Flakes nearer than this are not drawn.
+const float SNOW_MIN_DISTANCE = 25.0f;
+
+// Longest step one update takes, so a stall does not empty the sky.
+const float SNOW_MAX_DT = 0.1f;
+
+// Snowfall kept entirely on the GPU: two state buffers take turns as source
+// and transform feedback target, and one instanced draw renders every flake.
+// The CPU only writes the initial state and a few uniforms per frame.
+class SnowSystem {
+public:
+    bool Init(int particles, float nearPlane, float farPlane) {
+        count = particles;
+
+        updateProgram = CompileFeedbackProgram(snow_update_vs_source, "outState");
+        drawProgram = CompileProgram(snow_vs_source, snow_fs_source);
+        if (updateProgram == 0 || drawProgram == 0) return false;
+
+        timeLoc = glGetUniformLocation(updateProgram, "time");
+        dtLoc = glGetUniformLocation(updateProgram, "dt");
+        centerLoc = glGetUniformLocation(updateProgram, "center");
+        glUseProgram(updateProgram);
+        glUniform3f(glGetUniformLocation(updateProgram, "extent"), SNOW_EXTENT.x, SNOW_EXTENT.y, SNOW_EXTENT.z);
+        glUniform2f(glGetUniformLocation(updateProgram, "wind"), SNOW_WIND.x, SNOW_WIND.y);
+
+        glUseProgram(drawProgram);
+        unsigned int block = glGetUniformBlockIndex(drawProgram, "FrameUniforms");
+        if (block != GL_INVALID_INDEX) glUniformBlockBinding(drawProgram, block, FRAME_UNIFORM_BINDING);
+        glUniform1f(glGetUniformLocation(drawProgram, "size"), SNOW_FLAKE_SIZE);
+        glUniform1f(glGetUniformLocation(drawProgram, "minDistance"), SNOW_MIN_DISTANCE);
+        glUniform2f(glGetUniformLocation(drawProgram, "nearFar"), nearPlane, farPlane);
+        glUniform1f(glGetUniformLocation(drawProgram, "softness"), SNOW_SOFTNESS);
+        glUniform1f(glGetUniformLocation(drawProgram, "fadeDistance"), SNOW_FADE_DISTANCE);
+        glUniform1i(glGetUniformLocation(drawProgram, "sceneDepth"), 0);
+        softLoc = glGetUniformLocation(drawProgram, "soft");
+
+        // Flakes start spread through the box above the origin; the first
+        // updates wrap them around wherever the camera is.
+        std::vector<glm::vec4> initial(count);
+        std::mt19937 rng(0x5A0F1A4E);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (glm::vec4& flake : initial) {
+            flake = glm::vec4((unit(rng) * 2.0f - 1.0f) * SNOW_EXTENT.x, unit(rng) * 2.0f * SNOW_EXTENT.y,
+                (unit(rng) * 2.0f - 1.0f) * SNOW_EXTENT.z, unit(rng));
+        }
+
+        glGenBuffers(2, buffers);
+        glGenVertexArrays(2, updateVaos);
+        glGenVertexArrays(2, drawVaos);
+        for (int i = 0; i < 2; i++) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * count, initial.data(), GL_DYNAMIC_COPY);
+
+            glBindVertexArray(updateVaos[i]);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), nullptr);
+
+            glBindVertexArray(drawVaos[i]);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), nullptr);
+            glVertexAttribDivisor(0, 1);
+        }
+        glBindVertexArray(0);
+        return true;
+    }
+
+    bool Initialized() const { return drawProgram != 0; }
+    int Count() const { return count; }
+
+    // Advances every flake by the game time since the last call.
+    void Update(float time, const glm::vec3& cameraPos) {
+        float dt = lastTime < 0.0f ? 0.0f : std::max(0.0f, std::min(SNOW_MAX_DT, time - lastTime));
+        lastTime = time;
+
+        glUseProgram(updateProgram);
+        glUniform1f(timeLoc, time);
+        glUniform1f(dtLoc, dt);
+        glUniform3f(centerLoc, cameraPos.x, cameraPos.y, cameraPos.z);
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(updateVaos[current]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, count);
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        current = 1 - current;
+    }
+
+    // Draws the flakes into the bound scene target after the opaque scene,
+    // fading them against `sceneDepth` when it holds the scene. Leaves
+    // `sceneProgram` in use and the scene's blend and depth state restored.
+    void Draw(const SceneDepthCopy& sceneDepth, unsigned int sceneProgram) {
+        glUseProgram(drawProgram);
+        glUniform1i(softLoc, sceneDepth.Available() ? 1 : 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth.Texture());
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glBindVertexArray(drawVaos[current]);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        glEnable(GL_CULL_FACE);
+        glDepthMask(GL_TRUE);
+        glUseProgram(sceneProgram);
+    }
+
+private:
+    int count = 0;
+
+    unsigned int updateProgram = 0;
+    unsigned int drawProgram = 0;
+    int timeLoc = -1;
+    int dtLoc = -1;
+    int centerLoc = -1;
+    int softLoc = -1;
+
+    unsigned int buffers[2] = {};
+    unsigned int updateVaos[2] = {};
+    unsigned int drawVaos[2] = {};
+    int current = 0;
+    float lastTime = -1.0f;
+};
+
+#endif
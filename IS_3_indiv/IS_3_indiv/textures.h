@@ -0,0 +1,250 @@
+#ifndef TEXTURES_H
+#define TEXTURES_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "jobsystem.h"
+#include "profiler.h"
+#include "stb_image.h"
+
+// Entries in the scene shader's TextureTable block.
+const int MAX_TEXTURES = 16;
+const unsigned int TEXTURE_TABLE_BINDING = 1;
+const unsigned int TEXTURE_ARRAY_UNIT = 0;
+// Wrapped border around each atlas tile, in texels. Tiles stop at the mip
+// level where it shrinks to one texel, so neighbours never bleed in.
+const int TEXTURE_ATLAS_GUTTER = 16;
+// Mip limit of textures that fill their layer.
+const float TEXTURE_FULL_MIPS = 16.0f;
+
+// std140 layout of the TextureTable block.
+struct TextureTable {
+    // Tile of each texture in its layer: offset in xy, size in zw.
+    glm::vec4 rect[MAX_TEXTURES];
+    // Layer in x, highest mip level to sample in y.
+    glm::vec4 layer[MAX_TEXTURES];
+};
+
+// All scene textures in one GL_TEXTURE_2D_ARRAY, so draws pick theirs by
+// index instead of binding them. Layers are as large as the largest image.
+// Images that fill a layer get one to themselves; the rest are packed onto
+// shelves in shared layers, each with a wrapped border so repeating UVs
+// still tile. Images too large for a border get a layer of their own.
+class TextureArray {
+public:
+    // Queues an image and returns its index in the table, or -1 if the table
+    // is full. Adding a path twice returns the same index.
+    int Add(const std::string& path) {
+        for (size_t i = 0; i < images.size(); i++) {
+            if (images[i].path == path) return static_cast<int>(i);
+        }
+        if (static_cast<int>(images.size()) == MAX_TEXTURES) {
+            std::cerr << "Texture table full, skipping " << path << std::endl;
+            return -1;
+        }
+        Image image;
+        image.path = path;
+        images.push_back(image);
+        return static_cast<int>(images.size()) - 1;
+    }
+
+    // Decodes the queued images in parallel, packs them into layers and
+    // uploads them. Binds the TextureTable block of `sceneProgram`.
+    bool Build(JobSystem& jobs, unsigned int sceneProgram) {
+        PROFILE_SCOPE("Texture array");
+        if (images.empty()) return true;
+
+        stbi_set_flip_vertically_on_load(true);
+        jobs.ParallelFor(0, static_cast<int>(images.size()), 1, [this](int begin, int end) {
+            for (int i = begin; i < end; i++) Decode(images[i]);
+        });
+
+        layerSize = 1;
+        for (const auto& image : images) layerSize = std::max(layerSize, std::max(image.width, image.height));
+        GLint maxSize = 0, maxLayers = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        if (layerSize > maxSize) {
+            std::cerr << "Texture array: " << layerSize << " texel layers exceed the limit of " << maxSize << std::endl;
+            return false;
+        }
+
+        Pack();
+        if (layerCount > maxLayers) {
+            std::cerr << "Texture array: " << layerCount << " layers exceed the limit of " << maxLayers << std::endl;
+            return false;
+        }
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, layerCount, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        std::vector<unsigned char> staging(static_cast<size_t>(layerSize) * layerSize * 4);
+        for (int layer = 0; layer < layerCount; layer++) {
+            std::fill(staging.begin(), staging.end(), static_cast<unsigned char>(0));
+            for (const auto& image : images) {
+                if (image.layer == layer) Fill(jobs, image, staging);
+            }
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, layerSize, layerSize, 1,
+                GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        TextureTable table = {};
+        float scale = 1.0f / static_cast<float>(layerSize);
+        for (size_t i = 0; i < images.size(); i++) {
+            Image& image = images[i];
+            table.rect[i] = glm::vec4(image.x * scale, image.y * scale, image.width * scale, image.height * scale);
+            table.layer[i] = glm::vec4(static_cast<float>(image.layer), image.maxLod, 0.0f, 0.0f);
+            std::vector<unsigned char>().swap(image.pixels);
+        }
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(TextureTable), &table, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        unsigned int block = glGetUniformBlockIndex(sceneProgram, "TextureTable");
+        if (block == GL_INVALID_INDEX) std::cerr << "Warning: TextureTable block not found" << std::endl;
+        else glUniformBlockBinding(sceneProgram, block, TEXTURE_TABLE_BINDING);
+
+        std::cout << "Texture array: " << images.size() << " textures in " << layerCount << " layers of "
+            << layerSize << "x" << layerSize << std::endl;
+        return true;
+    }
+
+    bool Initialized() const { return texture != 0; }
+    int LayerCount() const { return layerCount; }
+
+    // Binds the array and its table; the draws then only set indices.
+    void Bind() const {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_ARRAY_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glBindBufferBase(GL_UNIFORM_BUFFER, TEXTURE_TABLE_BINDING, ubo);
+    }
+
+private:
+    struct Image {
+        std::string path;
+        int width = 0, height = 0;
+        std::vector<unsigned char> pixels;
+        // Placement: layer, tile origin in texels, border width.
+        int layer = 0, x = 0, y = 0, gutter = 0;
+        float maxLod = 0.0f;
+    };
+
+    // RGBA8, or one white texel if the file cannot be read, as load_texture.
+    static void Decode(Image& image) {
+        int w = 0, h = 0, ch = 0;
+        unsigned char* data = stbi_load(image.path.c_str(), &w, &h, &ch, 4);
+        if (data) {
+            image.width = w;
+            image.height = h;
+            image.pixels.assign(data, data + static_cast<size_t>(w) * h * 4);
+            stbi_image_free(data);
+        }
+        else {
+            std::cerr << "Failed to load texture: " << image.path << std::endl;
+            image.width = image.height = 1;
+            image.pixels.assign(4, 255);
+        }
+    }
+
+    struct Shelf {
+        int layer, y, height, x;
+    };
+
+    // Tallest first onto shelves: the first shelf with room, else a new
+    // shelf in the newest shared layer, else a new shared layer.
+    void Pack() {
+        std::vector<int> order;
+        for (size_t i = 0; i < images.size(); i++) order.push_back(static_cast<int>(i));
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return images[a].height > images[b].height; });
+
+        std::vector<Shelf> shelves;
+        int sharedLayer = -1;
+        int sharedTop = 0;
+        layerCount = 0;
+        for (int i : order) {
+            Image& image = images[i];
+            int w = image.width + 2 * TEXTURE_ATLAS_GUTTER;
+            int h = image.height + 2 * TEXTURE_ATLAS_GUTTER;
+            if (w > layerSize || h > layerSize) {
+                // Alone and centered, so the border wraps the same on every
+                // side and the layer's own repeat lands outside it. An axis
+                // the image spans repeats exactly and needs no border.
+                image.layer = layerCount++;
+                image.x = (layerSize - image.width) / 2;
+                image.y = (layerSize - image.height) / 2;
+                image.gutter = layerSize;
+                int margin = layerSize;
+                if (image.width < layerSize) margin = std::min(margin, image.x);
+                if (image.height < layerSize) margin = std::min(margin, image.y);
+                if (margin == layerSize) image.maxLod = TEXTURE_FULL_MIPS;
+                else image.maxLod = margin == 0 ? 0.0f : std::floor(std::log2(static_cast<float>(margin)));
+                continue;
+            }
+
+            Shelf* shelf = nullptr;
+            for (auto& s : shelves) {
+                if (s.height >= h && s.x + w <= layerSize) {
+                    shelf = &s;
+                    break;
+                }
+            }
+            if (!shelf) {
+                if (sharedLayer < 0 || sharedTop + h > layerSize) {
+                    sharedLayer = layerCount++;
+                    sharedTop = 0;
+                }
+                shelves.push_back({ sharedLayer, sharedTop, h, 0 });
+                sharedTop += h;
+                shelf = &shelves.back();
+            }
+            image.layer = shelf->layer;
+            image.x = shelf->x + TEXTURE_ATLAS_GUTTER;
+            image.y = shelf->y + TEXTURE_ATLAS_GUTTER;
+            image.gutter = TEXTURE_ATLAS_GUTTER;
+            image.maxLod = std::log2(static_cast<float>(TEXTURE_ATLAS_GUTTER));
+            shelf->x += w;
+        }
+    }
+
+    // Writes the tile and its border, wrapping the image around its edges.
+    void Fill(JobSystem& jobs, const Image& image, std::vector<unsigned char>& layer) const {
+        int x0 = std::max(0, image.x - image.gutter);
+        int x1 = std::min(layerSize, image.x + image.width + image.gutter);
+        int y0 = std::max(0, image.y - image.gutter);
+        int y1 = std::min(layerSize, image.y + image.height + image.gutter);
+        jobs.ParallelFor(y0, y1, 64, [&](int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                int sy = ((y - image.y) % image.height + image.height) % image.height;
+                const unsigned char* row = image.pixels.data() + static_cast<size_t>(sy) * image.width * 4;
+                unsigned char* out = layer.data() + (static_cast<size_t>(y) * layerSize) * 4;
+                for (int x = x0; x < x1; x++) {
+                    int sx = ((x - image.x) % image.width + image.width) % image.width;
+                    std::memcpy(out + static_cast<size_t>(x) * 4, row + static_cast<size_t>(sx) * 4, 4);
+                }
+            }
+        });
+    }
+
+    std::vector<Image> images;
+    int layerSize = 0;
+    int layerCount = 0;
+    unsigned int texture = 0;
+    unsigned int ubo = 0;
+};
+
+#endif
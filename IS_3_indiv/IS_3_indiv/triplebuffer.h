@@ -0,0 +1,38 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Single producer / single consumer triple buffer. The writer always has a
+// private slot to fill, the reader always has a private slot to read, and the
+// third slot is swapped between them with one atomic exchange. Neither side
+// ever waits for the other.
+template <typename T>
+class TripleBuffer {
+public:
+    T& WriteBuffer() { return buffers[writeIndex]; }
+
+    void Publish() {
+        writeIndex = middle.exchange(writeIndex | DIRTY_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Returns true if a newer slot was published since the last call.
+    bool Update() {
+        if ((middle.load(std::memory_order_relaxed) & DIRTY_BIT) == 0) return false;
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& ReadBuffer() const { return buffers[readIndex]; }
+
+private:
+    static const unsigned int INDEX_MASK = 3;
+    static const unsigned int DIRTY_BIT = 4;
+
+    T buffers[3];
+    std::atomic<unsigned int> middle{ 1 };
+    unsigned int writeIndex = 0;
+    unsigned int readIndex = 2;
+};
+
+#endif
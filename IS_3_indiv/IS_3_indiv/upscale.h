@@ -0,0 +1,263 @@
+#ifndef UPSCALE_H
+#define UPSCALE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "profiler.h"
+#include "shaders.h"
+
+// Render scale per axis. 0.5 shades a quarter of the output pixels.
+const float DYNRES_MIN_SCALE = 0.5f;
+const float DYNRES_MAX_SCALE = 1.0f;
+
+// Frame costs within this share of the target leave the scale alone.
+const double DYNRES_DEADBAND = 0.05;
+
+// Share of the way to the ideal scale moved per measured frame, and the step
+// scales are rounded to so the size does not wander by single pixels.
+const float DYNRES_GAIN = 0.3f;
+const float DYNRES_STEP = 1.0f / 32.0f;
+
+// Frames of scene timestamps in flight; older results are read without waiting.
+const int UPSCALE_TIMER_RING = 4;
+
+// Length of the sub-pixel jitter sequence.
+const int UPSCALE_JITTER_PHASES = 8;
+
+// Weight of the new frame in the accumulated history.
+const float UPSCALE_BLEND = 0.1f;
+
+inline float Halton(int index, int base) {
+    float result = 0.0f;
+    float f = 1.0f;
+    while (index > 0) {
+        f /= base;
+        result += f * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// Picks the render scale from the measured frame cost. Shading cost follows
+// the pixel count, so the ideal scale moves with the square root of
+// target / cost.
+class ResolutionController {
+public:
+    void Init(double target, float initialScale, bool enabled) {
+        targetMs = target;
+        scale = initialScale;
+        adaptive = enabled;
+    }
+
+    void Update(double costMs) {
+        if (!adaptive || costMs <= 0.0) return;
+        double ratio = targetMs / costMs;
+        if (std::fabs(1.0 - ratio) < DYNRES_DEADBAND) return;
+
+        float ideal = scale * static_cast<float>(std::sqrt(ratio));
+        float next = scale + (ideal - scale) * DYNRES_GAIN;
+        next = std::round(next / DYNRES_STEP) * DYNRES_STEP;
+        scale = std::max(DYNRES_MIN_SCALE, std::min(DYNRES_MAX_SCALE, next));
+    }
+
+    float Scale() const { return scale; }
+
+private:
+    double targetMs = 16.7;
+    float scale = 1.0f;
+    bool adaptive = false;
+};
+
+// Renders the scene at a reduced, jittered resolution into the top-left part
+// of a full-size target, then accumulates the frames into a full-resolution
+// history. The target is never reallocated when the scale changes; only the
+// viewport does.
+class TemporalUpscaler {
+public:
+    bool Init(int w, int h, float initialScale, bool adaptive, double targetMs) {
+        width = w;
+        height = h;
+        controller.Init(targetMs, initialScale, adaptive);
+
+        program = CompileProgram(overdraw_vs_source, upscale_fs_source);
+        if (program == 0) return false;
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "scene"), 0);
+        glUniform1i(glGetUniformLocation(program, "sceneDepth"), 1);
+        glUniform1i(glGetUniformLocation(program, "history"), 2);
+        glUniform1f(glGetUniformLocation(program, "blend"), UPSCALE_BLEND);
+        glUniform2f(glGetUniformLocation(program, "texel"), 1.0f / width, 1.0f / height);
+        renderScaleLoc = glGetUniformLocation(program, "renderScale");
+        jitterLoc = glGetUniformLocation(program, "jitter");
+        historyValidLoc = glGetUniformLocation(program, "historyValid");
+        reprojectLoc = glGetUniformLocation(program, "reproject");
+        glGenVertexArrays(1, &emptyVao);
+
+        color = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR);
+        depth = CreateTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_NEAREST);
+        glGenFramebuffers(1, &sceneFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        for (int i = 0; i < 2; i++) {
+            history[i] = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR);
+            glGenFramebuffers(1, &historyFbo[i]);
+            glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history[i], 0);
+            complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            std::cerr << "Upscale framebuffers are incomplete" << std::endl;
+            return false;
+        }
+
+        glGenQueries(UPSCALE_TIMER_RING * 2, queries);
+        return true;
+    }
+
+    bool Initialized() const { return sceneFbo != 0; }
+
+    // Drops the history, for camera cuts and after the upscaler was off.
+    void ResetHistory() { historyValid = false; }
+
+    // Call before the frame's clear. `cpuMs` is the CPU side of the last
+    // frame's rendering for drivers whose timestamps miss rasterization (a
+    // software renderer shades at the flush), 0 to go by GPU time alone.
+    void BeginScene(double cpuMs) {
+        int slot = frame % UPSCALE_TIMER_RING;
+        if (frame >= UPSCALE_TIMER_RING) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+                gpuMs = (end - begin) / 1.0e6;
+            }
+        }
+        controller.Update(std::max(gpuMs, cpuMs));
+
+        renderWidth = std::max(1, static_cast<int>(std::lround(width * controller.Scale())));
+        renderHeight = std::max(1, static_cast<int>(std::lround(height * controller.Scale())));
+        PROFILE_COUNTER("Render scale", controller.Scale());
+
+        // Halton(2, 3) offsets within a render pixel, centred on zero.
+        int phase = frame % UPSCALE_JITTER_PHASES + 1;
+        jitterX = Halton(phase, 2) - 0.5f;
+        jitterY = Halton(phase, 3) - 0.5f;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+        glViewport(0, 0, renderWidth, renderHeight);
+        glQueryCounter(queries[slot * 2], GL_TIMESTAMP);
+    }
+
+    // The projection shifted by this frame's jitter; the scene draws with it.
+    glm::mat4 Jitter(const glm::mat4& projection) const {
+        glm::mat4 jittered = projection;
+        jittered[2][0] -= jitterX * 2.0f / renderWidth;
+        jittered[2][1] -= jitterY * 2.0f / renderHeight;
+        return jittered;
+    }
+
+    // Accumulates the scene into the history and copies the result to
+    // `target` at full resolution. `view` and `projection` are the unjittered
+    // matrices the scene was drawn with. Leaves `target` bound and
+    // `sceneProgram` in use.
+    void Resolve(unsigned int target, const glm::mat4& view, const glm::mat4& projection, unsigned int sceneProgram) {
+        glQueryCounter(queries[(frame % UPSCALE_TIMER_RING) * 2 + 1], GL_TIMESTAMP);
+
+        glm::mat4 viewProj = projection * view;
+        int next = 1 - current;
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[next]);
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        glUseProgram(program);
+        glUniform2f(renderScaleLoc, static_cast<float>(renderWidth) / width, static_cast<float>(renderHeight) / height);
+        glUniform2f(jitterLoc, jitterX / renderWidth, jitterY / renderHeight);
+        glUniform1i(historyValidLoc, historyValid ? 1 : 0);
+        // Takes this frame's clip space straight to the last frame's.
+        glm::mat4 reproject = prevViewProj * glm::inverse(viewProj);
+        glUniformMatrix4fv(reprojectLoc, 1, GL_FALSE, glm::value_ptr(reproject));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, color);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, history[current]);
+        glBindVertexArray(emptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, historyFbo[next]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+        glUseProgram(sceneProgram);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+
+        prevViewProj = viewProj;
+        historyValid = true;
+        current = next;
+        frame++;
+    }
+
+    unsigned int SceneFramebuffer() const { return sceneFbo; }
+    float Scale() const { return controller.Scale(); }
+    int RenderWidth() const { return renderWidth; }
+    int RenderHeight() const { return renderHeight; }
+
+private:
+    unsigned int CreateTexture(GLenum internalFormat, GLenum format, GLenum type, GLint filter) {
+        unsigned int texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    int width = 0;
+    int height = 0;
+    int renderWidth = 0;
+    int renderHeight = 0;
+    ResolutionController controller;
+
+    unsigned int program = 0;
+    unsigned int emptyVao = 0;
+    int renderScaleLoc = -1;
+    int jitterLoc = -1;
+    int historyValidLoc = -1;
+    int reprojectLoc = -1;
+
+    unsigned int sceneFbo = 0;
+    unsigned int color = 0;
+    unsigned int depth = 0;
+    unsigned int historyFbo[2] = {};
+    unsigned int history[2] = {};
+    int current = 0;
+    bool historyValid = false;
+    glm::mat4 prevViewProj = glm::mat4(1.0f);
+
+    unsigned int queries[UPSCALE_TIMER_RING * 2] = {};
+    double gpuMs = 0.0;
+    int frame = 0;
+    float jitterX = 0.0f;
+    float jitterY = 0.0f;
+};
+
+#endif